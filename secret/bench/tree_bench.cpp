@@ -0,0 +1,584 @@
+// Tree benchmark: BinarySearchTree, AVLTree, RedBlackTree, SplayTree (full
+// and semi-splaying), BPlusTree (the in-tree stand-in for an
+// absl::btree_set style container), the write-buffered BEpsilonTree and
+// the AdaptiveRadixTree against std::set.
+//
+//   tree_bench [--min-exp E] [--max-exp E] [--seed S] [--threads T] [--csv]
+//
+// runs 10^min-exp .. 10^max-exp keys (default 3..6, 8 is the upper end the
+// key generator is sized for) under uniform, sequential and Zipf (theta
+// 0.99) key orders, and reports ops/sec, sampled latency percentiles and
+// live heap bytes per key for every phase.
+//
+// The concurrent trees (ConcurrentAVLTree, ConcurrentRedBlackTree, and a
+// std::set behind one mutex for reference) then run the mixed workload on
+// 1, 2, 4 ... T threads (default 8) sharing one tree; those rows report the
+// total ops/sec over all threads.
+
+#include "betree.hpp"
+#include "bplustree.hpp"
+#include "concurrent_rbtree.h"
+#include "concurrent_tree.hpp"
+#include "radix_tree.hpp"
+#include "rbtree.h"
+#include "splay_tree.hpp"
+#include "tree.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <random>
+#include <set>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+//                          Live Heap Byte Counting
+//-------------------------------------------------------------------------------
+
+// Every allocation carries a header with its size, so bytes per key is what
+// the containers asked for (allocator overhead not included). The counter is
+// atomic because the concurrent phases allocate from several threads.
+namespace {
+
+std::atomic<std::size_t> liveBytes{0};
+constexpr std::size_t HEADER = alignof(std::max_align_t);
+
+void *allocate(std::size_t size, std::size_t align) {
+  std::size_t header = align > HEADER ? align : HEADER;
+  void *raw = nullptr;
+  if (posix_memalign(&raw, header, size + header) != 0)
+    throw std::bad_alloc();
+  auto base = static_cast<unsigned char *>(raw);
+  std::memcpy(base + header - 2 * sizeof(std::size_t), &size, sizeof(size));
+  std::memcpy(base + header - sizeof(std::size_t), &header, sizeof(header));
+  liveBytes.fetch_add(size, std::memory_order_relaxed);
+  return base + header;
+}
+
+void release(void *p) {
+  if (p == nullptr)
+    return;
+  auto user = static_cast<unsigned char *>(p);
+  std::size_t size, header;
+  std::memcpy(&size, user - 2 * sizeof(std::size_t), sizeof(size));
+  std::memcpy(&header, user - sizeof(std::size_t), sizeof(header));
+  liveBytes.fetch_sub(size, std::memory_order_relaxed);
+  std::free(user - header);
+}
+
+} // namespace
+
+void *operator new(std::size_t size) { return allocate(size, HEADER); }
+void *operator new[](std::size_t size) { return allocate(size, HEADER); }
+void *operator new(std::size_t size, std::align_val_t align) {
+  return allocate(size, static_cast<std::size_t>(align));
+}
+void *operator new[](std::size_t size, std::align_val_t align) {
+  return allocate(size, static_cast<std::size_t>(align));
+}
+void operator delete(void *p) noexcept { release(p); }
+void operator delete[](void *p) noexcept { release(p); }
+void operator delete(void *p, std::size_t) noexcept { release(p); }
+void operator delete[](void *p, std::size_t) noexcept { release(p); }
+void operator delete(void *p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { release(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+  release(p);
+}
+
+namespace {
+
+//-------------------------------------------------------------------------------
+//                               Tree Adapters
+//-------------------------------------------------------------------------------
+
+// Keys are even, so key + 1 is always a miss.
+template <typename Tree> struct RepoTree {
+  using NodeT =
+      std::remove_pointer_t<decltype(std::declval<Tree &>().getRoot())>;
+  Tree tree;
+  std::vector<NodeT *> found;
+  void insert(int key) { tree.insert(key); }
+  bool contains(int key) { return tree.search(key) != nullptr; }
+  void remove(int key) { tree.remove(key); }
+  std::size_t containsBatch(std::span<const int> keys) {
+    found.resize(keys.size());
+    tree.searchBatch(keys, found);
+    return std::size_t(std::count_if(found.begin(), found.end(),
+                                     [](NodeT *node) { return node; }));
+  }
+  template <typename F> void scan(F &&visit) {
+    // explicit stack, the unbalanced tree may be deep
+    std::vector<NodeT *> stack;
+    NodeT *node = tree.getRoot();
+    while (node != nullptr || !stack.empty()) {
+      for (; node != nullptr; node = node->left)
+        stack.push_back(node);
+      node = stack.back();
+      stack.pop_back();
+      visit(node->key);
+      node = node->right;
+    }
+  }
+};
+
+struct SemiSplayTree : RepoTree<TREE::SplayTree<int>> {
+  SemiSplayTree() { tree.setSemiSplay(true); }
+};
+
+struct BTreeSet {
+  TREE::BPlusTree<int> tree;
+  void insert(int key) { tree.insert(key); }
+  bool contains(int key) { return tree.search(key) != nullptr; }
+  void remove(int key) { tree.remove(key); }
+  template <typename F> void scan(F &&visit) {
+    tree.scan(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(),
+              visit);
+  }
+};
+
+struct BufferedSet {
+  TREE::BEpsilonTree<int> tree;
+  void insert(int key) { tree.insert(key); }
+  bool contains(int key) { return tree.search(key).has_value(); }
+  void remove(int key) { tree.remove(key); }
+  template <typename F> void scan(F &&visit) {
+    tree.scan(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(),
+              visit);
+  }
+};
+
+struct RadixSet {
+  TREE::AdaptiveRadixTree<int> tree;
+  void insert(int key) { tree.insert(key); }
+  bool contains(int key) { return tree.search(key) != nullptr; }
+  void remove(int key) { tree.remove(key); }
+  template <typename F> void scan(F &&visit) { tree.forEach(visit); }
+};
+
+// Thread-safe sets for the concurrent phases.
+struct ConcurrentAVLSet {
+  TREE::ConcurrentAVLTree<int> tree;
+  void insert(int key) { tree.insert(key); }
+  bool contains(int key) { return tree.contains(key); }
+  void remove(int key) { tree.remove(key); }
+};
+
+struct ConcurrentRBSet {
+  RBTREE::ConcurrentRedBlackTree<int> tree;
+  void insert(int key) { tree.insert(key); }
+  bool contains(int key) { return tree.contains(key); }
+  void remove(int key) { tree.remove(key); }
+};
+
+struct MutexSet {
+  std::mutex lock;
+  std::set<int> tree;
+  void insert(int key) {
+    std::lock_guard<std::mutex> guard(lock);
+    tree.insert(key);
+  }
+  bool contains(int key) {
+    std::lock_guard<std::mutex> guard(lock);
+    return tree.find(key) != tree.end();
+  }
+  void remove(int key) {
+    std::lock_guard<std::mutex> guard(lock);
+    tree.erase(key);
+  }
+};
+
+struct StdSet {
+  std::set<int> tree;
+  void insert(int key) { tree.insert(key); }
+  bool contains(int key) { return tree.find(key) != tree.end(); }
+  void remove(int key) { tree.erase(key); }
+  template <typename F> void scan(F &&visit) {
+    for (int key : tree)
+      visit(key);
+  }
+};
+
+//-------------------------------------------------------------------------------
+//                              Key Generation
+//-------------------------------------------------------------------------------
+
+enum class Distribution { Uniform, Sequential, Zipf };
+
+const char *name(Distribution d) {
+  switch (d) {
+  case Distribution::Uniform:
+    return "uniform";
+  case Distribution::Sequential:
+    return "sequential";
+  default:
+    return "zipf";
+  }
+}
+
+// Gray et al., "Quickly generating billion-record synthetic databases":
+// rank 0 is the hottest; ranks are scattered over the key set by the caller.
+class Zipf {
+  double n, theta, alpha, zetan, eta;
+
+public:
+  Zipf(std::size_t items, double skew) : n(double(items)), theta(skew) {
+    zetan = 0;
+    for (std::size_t i = 1; i <= items; ++i)
+      zetan += 1.0 / std::pow(double(i), theta);
+    double zeta2 = 1.0 + 1.0 / std::pow(2.0, theta);
+    alpha = 1.0 / (1.0 - theta);
+    eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+  }
+
+  template <typename Rng> std::size_t operator()(Rng &rng) {
+    double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    double uz = u * zetan;
+    if (uz < 1.0)
+      return 0;
+    if (uz < 1.0 + std::pow(0.5, theta))
+      return 1;
+    auto rank = std::size_t(n * std::pow(eta * u - eta + 1.0, alpha));
+    return rank < std::size_t(n) ? rank : std::size_t(n) - 1;
+  }
+};
+
+struct Workload {
+  std::vector<int> insertOrder; // every key once
+  std::vector<int> lookups;     // hits; misses are lookups[i] + 1
+  std::vector<int> removeOrder; // every key once
+};
+
+Workload makeWorkload(Distribution d, std::size_t n, std::mt19937_64 &rng) {
+  Workload w;
+  std::vector<int> sorted(n);
+  for (std::size_t i = 0; i < n; ++i)
+    sorted[i] = int(2 * i);
+
+  if (d == Distribution::Sequential) {
+    w.insertOrder = sorted;
+    w.lookups = sorted;
+    w.removeOrder = sorted;
+    return w;
+  }
+
+  w.insertOrder = sorted;
+  std::shuffle(w.insertOrder.begin(), w.insertOrder.end(), rng);
+  w.removeOrder = sorted;
+  std::shuffle(w.removeOrder.begin(), w.removeOrder.end(), rng);
+  w.lookups.resize(n);
+  if (d == Distribution::Uniform) {
+    std::uniform_int_distribution<std::size_t> pick(0, n - 1);
+    for (int &key : w.lookups)
+      key = sorted[pick(rng)];
+  } else {
+    Zipf zipf(n, 0.99);
+    for (int &key : w.lookups)
+      key = sorted[zipf(rng) * 0x9E3779B97F4A7C15ull % n];
+  }
+  return w;
+}
+
+//-------------------------------------------------------------------------------
+//                                Measurement
+//-------------------------------------------------------------------------------
+
+using Clock = std::chrono::steady_clock;
+constexpr std::size_t SAMPLE_EVERY = 32; // ops timed one by one for tails
+
+struct PhaseResult {
+  double opsPerSecond;
+  double p50, p99, p999; // ns, from the sampled ops
+};
+
+struct Row {
+  std::string tree;
+  std::string phase;
+  PhaseResult result;
+  double bytesPerKey;
+};
+
+double percentile(std::vector<double> &samples, double p) {
+  if (samples.empty())
+    return 0;
+  std::size_t k = std::min(samples.size() - 1,
+                           std::size_t(p * double(samples.size())));
+  std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+  return samples[k];
+}
+
+template <typename Op> PhaseResult runPhase(std::size_t count, Op &&op) {
+  std::vector<double> samples;
+  samples.reserve(count / SAMPLE_EVERY + 1);
+  auto start = Clock::now();
+  for (std::size_t i = 0; i < count; ++i) {
+    if (i % SAMPLE_EVERY == 0) {
+      auto t0 = Clock::now();
+      op(i);
+      samples.push_back(
+          std::chrono::duration<double, std::nano>(Clock::now() - t0).count());
+    } else {
+      op(i);
+    }
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  PhaseResult r;
+  r.opsPerSecond = seconds > 0 ? double(count) / seconds : 0;
+  r.p50 = percentile(samples, 0.50);
+  r.p99 = percentile(samples, 0.99);
+  r.p999 = percentile(samples, 0.999);
+  return r;
+}
+
+std::size_t sink = 0; // keeps lookups and scans observable
+
+template <typename Adapter>
+void benchTree(const char *treeName, const Workload &w, std::mt19937_64 &rng,
+               std::vector<Row> &rows) {
+  std::size_t n = w.insertOrder.size();
+  std::size_t before = liveBytes;
+  auto *a = new Adapter;
+
+  PhaseResult insert =
+      runPhase(n, [&](std::size_t i) { a->insert(w.insertOrder[i]); });
+  double bytesPerKey = double(liveBytes - before) / double(n);
+  rows.push_back({treeName, "insert", insert, bytesPerKey});
+
+  rows.push_back({treeName, "search-hit",
+                  runPhase(n,
+                           [&](std::size_t i) {
+                             sink += a->contains(w.lookups[i]);
+                           }),
+                  bytesPerKey});
+  if constexpr (requires { a->containsBatch(std::span<const int>()); }) {
+    // the search-hit keys again, SEARCH_BATCH descents interleaved
+    constexpr std::size_t CHUNK = 256;
+    std::size_t chunks = (n + CHUNK - 1) / CHUNK;
+    std::span<const int> lookups(w.lookups);
+    PhaseResult batch = runPhase(chunks, [&](std::size_t i) {
+      std::size_t first = i * CHUNK;
+      sink +=
+          a->containsBatch(lookups.subspan(first, std::min(CHUNK, n - first)));
+    });
+    batch.opsPerSecond *= double(n) / double(chunks);
+    batch.p50 = batch.p99 = batch.p999 = 0;
+    rows.push_back({treeName, "batch-hit", batch, bytesPerKey});
+  }
+  rows.push_back({treeName, "search-miss",
+                  runPhase(n,
+                           [&](std::size_t i) {
+                             sink += a->contains(w.lookups[i] + 1);
+                           }),
+                  bytesPerKey});
+
+  // one full in-order pass; reported per key visited
+  PhaseResult scan = runPhase(1, [&](std::size_t) {
+    a->scan([&](int key) { sink += std::size_t(key); });
+  });
+  scan.opsPerSecond *= double(n);
+  scan.p50 = scan.p99 = scan.p999 = 0;
+  rows.push_back({treeName, "scan", scan, bytesPerKey});
+
+  // 90% lookups, 5% inserts of new (odd) keys, 5% removes of those
+  std::vector<int> added;
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::vector<int> dice(n);
+  for (int &d : dice)
+    d = percent(rng);
+  PhaseResult mixed = runPhase(n, [&](std::size_t i) {
+    int roll = dice[i];
+    if (roll < 90) {
+      sink += a->contains(w.lookups[i]);
+    } else if (roll < 95 || added.empty()) {
+      added.push_back(w.lookups[i] + 1);
+      a->insert(added.back());
+    } else {
+      a->remove(added.back());
+      added.pop_back();
+    }
+  });
+  rows.push_back({treeName, "mixed", mixed, bytesPerKey});
+  for (int key : added)
+    a->remove(key);
+
+  rows.push_back({treeName, "delete",
+                  runPhase(n,
+                           [&](std::size_t i) {
+                             a->remove(w.removeOrder[i]);
+                           }),
+                  bytesPerKey});
+  delete a;
+}
+
+// The mixed phase of benchTree on 1, 2, 4 ... maxThreads threads sharing one
+// prefilled tree. The n operations are split evenly; each thread inserts and
+// removes its own odd keys (lookups[i] + 1 for its share of i), so the tree
+// ends where it started. One row per thread count, total ops/sec only.
+template <typename Adapter>
+void benchConcurrent(const char *treeName, const Workload &w,
+                     std::mt19937_64 &rng, int maxThreads,
+                     std::vector<Row> &rows) {
+  std::size_t n = w.insertOrder.size();
+  std::size_t before = liveBytes;
+  auto *a = new Adapter;
+  for (int key : w.insertOrder)
+    a->insert(key);
+  double bytesPerKey = double(liveBytes - before) / double(n);
+
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::vector<int> dice(n);
+  for (int &d : dice)
+    d = percent(rng);
+
+  for (int threads = 1; threads <= maxThreads; threads *= 2) {
+    std::atomic<bool> go{false};
+    std::atomic<std::size_t> hits{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t] {
+        std::vector<int> added;
+        std::size_t found = 0;
+        while (!go.load(std::memory_order_acquire))
+          std::this_thread::yield();
+        for (std::size_t i = t; i < n; i += std::size_t(threads)) {
+          int roll = dice[i];
+          if (roll < 90) {
+            found += a->contains(w.lookups[i]);
+          } else if (roll < 95 || added.empty()) {
+            added.push_back(w.lookups[i] + 1);
+            a->insert(added.back());
+          } else {
+            a->remove(added.back());
+            added.pop_back();
+          }
+        }
+        for (int key : added)
+          a->remove(key);
+        hits.fetch_add(found, std::memory_order_relaxed);
+      });
+    }
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread &worker : workers)
+      worker.join();
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    sink += hits.load();
+
+    PhaseResult r{};
+    r.opsPerSecond = seconds > 0 ? double(n) / seconds : 0;
+    rows.push_back(
+        {treeName, "mixed-" + std::to_string(threads) + "t", r, bytesPerKey});
+  }
+  delete a;
+}
+
+void printRows(const std::vector<Row> &rows, std::size_t n, Distribution d,
+               bool csv) {
+  for (const Row &r : rows) {
+    if (csv) {
+      std::printf("%zu,%s,%s,%s,%.0f,%.0f,%.0f,%.0f,%.1f\n", n, name(d),
+                  r.tree.c_str(), r.phase.c_str(), r.result.opsPerSecond,
+                  r.result.p50, r.result.p99, r.result.p999, r.bytesPerKey);
+    } else {
+      std::printf("%10zu  %-10s  %-12s  %-11s  %12.0f  %8.0f  %8.0f  %8.0f  "
+                  "%8.1f\n",
+                  n, name(d), r.tree.c_str(), r.phase.c_str(),
+                  r.result.opsPerSecond, r.result.p50, r.result.p99,
+                  r.result.p999, r.bytesPerKey);
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int minExp = 3, maxExp = 6;
+  std::uint64_t seed = 42;
+  int maxThreads = 8;
+  bool csv = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--min-exp" && i + 1 < argc)
+      minExp = std::atoi(argv[++i]);
+    else if (arg == "--max-exp" && i + 1 < argc)
+      maxExp = std::atoi(argv[++i]);
+    else if (arg == "--seed" && i + 1 < argc)
+      seed = std::strtoull(argv[++i], nullptr, 10);
+    else if (arg == "--threads" && i + 1 < argc)
+      maxThreads = std::atoi(argv[++i]);
+    else if (arg == "--csv")
+      csv = true;
+    else {
+      std::fprintf(stderr,
+                   "usage: %s [--min-exp E] [--max-exp E] [--seed S] "
+                   "[--threads T] [--csv]\n",
+                   argv[0]);
+      return 1;
+    }
+  }
+  if (minExp < 1 || maxExp > 8 || minExp > maxExp) {
+    std::fprintf(stderr, "exponents must satisfy 1 <= min <= max <= 8\n");
+    return 1;
+  }
+  if (maxThreads < 1) {
+    std::fprintf(stderr, "--threads must be at least 1\n");
+    return 1;
+  }
+
+  if (csv)
+    std::printf("keys,distribution,tree,phase,ops_per_sec,p50_ns,p99_ns,"
+                "p999_ns,bytes_per_key\n");
+  else
+    std::printf("%10s  %-10s  %-12s  %-11s  %12s  %8s  %8s  %8s  %8s\n",
+                "keys", "dist", "tree", "phase", "ops/sec", "p50 ns",
+                "p99 ns", "p999 ns", "B/key");
+
+  std::mt19937_64 rng(seed);
+  for (int e = minExp; e <= maxExp; ++e) {
+    std::size_t n = 1;
+    for (int i = 0; i < e; ++i)
+      n *= 10;
+    for (Distribution d : {Distribution::Uniform, Distribution::Sequential,
+                           Distribution::Zipf}) {
+      Workload w = makeWorkload(d, n, rng);
+      std::vector<Row> rows;
+      // ascending keys turn the unbalanced tree into a list: O(n^2) and a
+      // recursion as deep as n, so it only runs on shuffled inputs
+      if (d != Distribution::Sequential)
+        benchTree<RepoTree<TREE::BinarySearchTree<int>>>("BST", w, rng, rows);
+      benchTree<RepoTree<TREE::AVLTree<int>>>("AVLTree", w, rng, rows);
+      benchTree<RepoTree<RBTREE::RedBlackTree<int>>>("RedBlackTree", w, rng,
+                                                     rows);
+      // Zipf lookups are where splaying should pay off
+      benchTree<RepoTree<TREE::SplayTree<int>>>("SplayTree", w, rng, rows);
+      benchTree<SemiSplayTree>("SemiSplay", w, rng, rows);
+      benchTree<BTreeSet>("BPlusTree", w, rng, rows);
+      benchTree<BufferedSet>("BEpsilonTree", w, rng, rows);
+      benchTree<RadixSet>("RadixTree", w, rng, rows);
+      benchTree<StdSet>("std::set", w, rng, rows);
+      benchConcurrent<ConcurrentAVLSet>("ConcAVLTree", w, rng, maxThreads,
+                                        rows);
+      benchConcurrent<ConcurrentRBSet>("ConcRBTree", w, rng, maxThreads, rows);
+      benchConcurrent<MutexSet>("MutexSet", w, rng, maxThreads, rows);
+      printRows(rows, n, d, csv);
+      std::fflush(stdout);
+    }
+  }
+  return sink == 0xdeadbeef; // never true, defeats dead-code elimination
+}
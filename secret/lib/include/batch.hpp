@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                          Batched Pointer Descents
+//-------------------------------------------------------------------------------
+
+// Lookups interleaved by searchBatch(); enough to cover a DRAM miss with
+// the work of the other descents, few enough to stay in registers and L1.
+inline constexpr std::size_t SEARCH_BATCH = 16;
+
+template <typename NodeT> void prefetchNode(const NodeT *node) {
+#if defined(__GNUC__)
+  __builtin_prefetch(node);
+#else
+  (void)node;
+#endif
+}
+
+// For every keys[i], result[i] = node holding it under root, or nullptr.
+// Keeps SEARCH_BATCH descents in flight and steps them round-robin, one
+// level each, prefetching the child a descent moves to; by the time that
+// descent comes round again its node has had the other steps' worth of time
+// to arrive. A finished slot takes the next key at once, so short and long
+// paths do not wait for each other. Plain state machine, no coroutines:
+// a slot is just the current node and the index of its key.
+template <typename NodeT>
+void searchBatch(NodeT *root, std::span<const int> keys,
+                 std::span<NodeT *> result) {
+  struct Lookup {
+    NodeT *node;
+    std::size_t index;
+  };
+  Lookup slots[SEARCH_BATCH];
+  std::size_t active = 0;
+  std::size_t next = 0;
+  for (; active < SEARCH_BATCH && next < keys.size(); ++active)
+    slots[active] = {root, next++};
+
+  while (active > 0) {
+    for (std::size_t j = 0; j < active;) {
+      Lookup &slot = slots[j];
+      NodeT *node = slot.node;
+      int key = keys[slot.index];
+      if (node == nullptr || node->key == key) {
+        result[slot.index] = node;
+        if (next < keys.size()) {
+          slot = {root, next++};
+          ++j;
+        } else {
+          slot = slots[--active]; // j now holds an unfinished lookup
+        }
+        continue;
+      }
+      slot.node = key < node->key ? node->left : node->right;
+      prefetchNode(slot.node);
+      ++j;
+    }
+  }
+}
+
+} // namespace TREE
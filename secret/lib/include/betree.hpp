@@ -0,0 +1,844 @@
+#pragma once
+
+#include "node.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <initializer_list>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                                Bε-Trees
+//-------------------------------------------------------------------------------
+
+// Write-optimised ordered set: a B-tree whose inner nodes carry a buffer of
+// pending insert/erase messages, sorted by key with one message per key.
+// insert() and remove() only put a message into a short sorted run in front
+// of the root, with no node writes below it and no rebalancing; a full run
+// is merged into the root buffer in one pass. When a buffer fills up it is
+// flushed to the children in a batch: inner children merge a slice into
+// their own buffer (flushing in turn if that overflows), leaves merge their
+// slice in one linear pass and split as often as the merge requires. A child
+// left below a quarter full is merged with a neighbour. A key therefore
+// costs O(log(n) / B^(1 - ε)) amortized node writes instead of one
+// rebalancing descent per key, with B the buffer size and the fanout about
+// sqrt(B) (ε = 1/2).
+//
+// Reads see the newest message for a key: search() binary-searches the
+// buffers on the way down, the ordered queries merge the buffers of the path
+// into the leaves they walk, in place. Removing an absent key is allowed;
+// each message looks its key up first (a read-only descent) so that size()
+// is a running count. An empty tree owns no nodes until the first message
+// arrives.
+template <KeyComparble Key, std::size_t BufferBytes = 4096> class BEpsilonTree {
+protected:
+  struct Message {
+    Key key;
+    bool erase; // tombstone, otherwise an insert
+  };
+
+  static constexpr int BUFFER_CAPACITY =
+      static_cast<int>(BufferBytes / sizeof(Message));
+  static constexpr int LEAF_CAPACITY =
+      static_cast<int>(BufferBytes / sizeof(Key));
+  static constexpr int FANOUT = std::max(
+      4, 1 << (std::bit_width(static_cast<unsigned>(BUFFER_CAPACITY)) / 2));
+  static constexpr int RECENT_CAPACITY = FANOUT; // messages ahead of the root
+  static_assert(BUFFER_CAPACITY >= 16, "BufferBytes too small for this key");
+
+  struct Node {
+    bool leaf;
+  };
+
+  struct Leaf : Node {
+    std::vector<Key> keys; // sorted
+  };
+
+  // children[i] holds the keys in [pivots[i - 1], pivots[i]); buffer is
+  // sorted by key and keeps only the newest message for a key
+  struct Inner : Node {
+    std::vector<Key> pivots;
+    std::vector<Node *> children;
+    std::vector<Message> buffer;
+  };
+
+  // a flushed child as its parent sees it: what replaces it, each piece
+  // with the smallest key it may hold (the first piece keeps the old bound)
+  struct Piece {
+    Key low;
+    Node *node;
+  };
+
+  // the messages of one buffer that fall into a key range
+  struct Span {
+    const Message *first;
+    const Message *last;
+  };
+
+  Inner *root{nullptr};
+  std::vector<Message> recent; // sorted, newer than root->buffer
+  int count{0};                // keys, buffered messages included
+  [[no_unique_address]] mutable StatsCollector counters; // see stats.hpp
+
+  static Leaf *newLeaf();
+  static Inner *newInner();
+  static Span narrow(Span span, int lo, int hi);
+  static void mergeMessages(std::vector<Message> &buffer,
+                            const Message *first, const Message *last);
+
+  void push(int key, bool erase);
+  void foldRecent();
+  void flush(Inner *inner, bool all);
+  void mergeUnderfull(Inner *inner);
+  std::vector<Piece> applyToLeaf(Leaf *leaf, const Message *first,
+                                 const Message *last);
+  std::vector<Piece> splitInner(Inner *inner);
+  void replaceChild(Inner *inner, int i, const std::vector<Piece> &pieces);
+  void settleRoot();
+
+  template <bool Reverse, typename F>
+  static bool mergeLeaf(const Key *first, const Key *last,
+                        std::vector<Span> &spans, F &visit);
+  template <bool Reverse, typename F>
+  bool walk(const Node *node, int lo, int hi, std::vector<Span> &spans,
+            F &visit) const;
+  template <bool Reverse, typename F>
+  void visitRange(int lo, int hi, F &visit) const;
+
+  std::optional<Key> find(int key, SearchPath<> &path) const;
+
+  static Node *cloneSubtree(const Node *node);
+  static void destroySubtree(Node *node);
+
+public:
+  BEpsilonTree() = default;
+  BEpsilonTree(std::initializer_list<int> list);
+  ~BEpsilonTree();
+
+  // Copies are iterative and take the pending messages along; moves are
+  // O(1) and leave the source empty.
+  BEpsilonTree(const BEpsilonTree &other);
+  BEpsilonTree(BEpsilonTree &&other) noexcept;
+  BEpsilonTree &operator=(const BEpsilonTree &other);
+  BEpsilonTree &operator=(BEpsilonTree &&other) noexcept;
+
+  BEpsilonTree &operator=(std::initializer_list<int> list);
+  void clear();
+
+  void insert(int key);
+  std::optional<Key> search(int key) const; // a copy, buffers move
+  void remove(int key);
+  std::optional<Key> minimum() const;
+  std::optional<Key> maximum() const;
+  std::optional<Key> successor(int key) const; // next key, if key is present
+
+  int size() const;
+  int height() const;
+
+  // Pushes every pending message down to the leaves.
+  void flush();
+
+  // Counters when built with TREE_STATS, plus the current shape. Insert and
+  // remove latencies include the flushes they set off; search paths and
+  // the depth histogram count nodes, and bytes include buffer capacity.
+  TreeStats stats() const;
+
+  // visit(key) for every key in [lo, hi], in order
+  template <typename Visitor> void scan(int lo, int hi, Visitor &&visit) const;
+};
+
+//-------------------------------------------------------------------------------
+//                         BEpsilonTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key, std::size_t BufferBytes>
+BEpsilonTree<Key, BufferBytes>::BEpsilonTree(std::initializer_list<int> list) {
+  for (int key : list)
+    insert(key);
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+BEpsilonTree<Key, BufferBytes>::~BEpsilonTree() {
+  destroySubtree(root);
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+BEpsilonTree<Key, BufferBytes>::BEpsilonTree(const BEpsilonTree &other)
+    : root(static_cast<Inner *>(cloneSubtree(other.root))),
+      recent(other.recent), count(other.count) {}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+BEpsilonTree<Key, BufferBytes>::BEpsilonTree(BEpsilonTree &&other) noexcept
+    : root(std::exchange(other.root, nullptr)),
+      recent(std::move(other.recent)), count(std::exchange(other.count, 0)) {
+  other.recent.clear();
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+BEpsilonTree<Key, BufferBytes> &
+BEpsilonTree<Key, BufferBytes>::operator=(const BEpsilonTree &other) {
+  if (this != &other) {
+    Inner *copy = static_cast<Inner *>(cloneSubtree(other.root));
+    destroySubtree(root);
+    root = copy;
+    recent = other.recent;
+    count = other.count;
+  }
+  return *this;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+BEpsilonTree<Key, BufferBytes> &
+BEpsilonTree<Key, BufferBytes>::operator=(BEpsilonTree &&other) noexcept {
+  if (this != &other) {
+    destroySubtree(root);
+    root = std::exchange(other.root, nullptr);
+    recent = std::move(other.recent);
+    other.recent.clear();
+    count = std::exchange(other.count, 0);
+  }
+  return *this;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+BEpsilonTree<Key, BufferBytes> &
+BEpsilonTree<Key, BufferBytes>::operator=(std::initializer_list<int> list) {
+  clear();
+  for (int key : list)
+    insert(key);
+  return *this;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+void BEpsilonTree<Key, BufferBytes>::clear() {
+  destroySubtree(root);
+  root = nullptr;
+  recent.clear();
+  count = 0;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+typename BEpsilonTree<Key, BufferBytes>::Leaf *
+BEpsilonTree<Key, BufferBytes>::newLeaf() {
+  Leaf *leaf = new Leaf;
+  leaf->leaf = true;
+  return leaf;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+typename BEpsilonTree<Key, BufferBytes>::Inner *
+BEpsilonTree<Key, BufferBytes>::newInner() {
+  Inner *inner = new Inner;
+  inner->leaf = false;
+  inner->buffer.reserve(BUFFER_CAPACITY);
+  return inner;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+typename BEpsilonTree<Key, BufferBytes>::Node *
+BEpsilonTree<Key, BufferBytes>::cloneSubtree(const Node *node) {
+  // the copy of an inner node starts with its source's child pointers,
+  // each of which is then overwritten by the copy of that child
+  Node *copy = nullptr;
+  std::vector<std::pair<const Node *, Node **>> stack;
+  if (node != nullptr)
+    stack.push_back({node, &copy});
+  while (!stack.empty()) {
+    auto [source, slot] = stack.back();
+    stack.pop_back();
+    if (source->leaf) {
+      *slot = new Leaf(*static_cast<const Leaf *>(source));
+      continue;
+    }
+    Inner *inner = new Inner(*static_cast<const Inner *>(source));
+    *slot = inner;
+    for (Node *&child : inner->children)
+      stack.push_back({child, &child});
+  }
+  return copy;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+void BEpsilonTree<Key, BufferBytes>::destroySubtree(Node *node) {
+  if (node == nullptr)
+    return;
+  if (!node->leaf) {
+    Inner *inner = static_cast<Inner *>(node);
+    for (Node *child : inner->children)
+      destroySubtree(child);
+    delete inner;
+  } else {
+    delete static_cast<Leaf *>(node);
+  }
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+typename BEpsilonTree<Key, BufferBytes>::Span
+BEpsilonTree<Key, BufferBytes>::narrow(Span span, int lo, int hi) {
+  const Message *first = std::lower_bound(
+      span.first, span.last, lo,
+      [](const Message &m, int k) { return m.key < k; });
+  const Message *last =
+      std::upper_bound(first, span.last, hi,
+                       [](int k, const Message &m) { return k < m.key; });
+  return {first, last};
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+void BEpsilonTree<Key, BufferBytes>::mergeMessages(
+    std::vector<Message> &buffer, const Message *first, const Message *last) {
+  // both runs sorted; on a tie the incoming message is the newer one
+  std::vector<Message> merged;
+  merged.reserve(buffer.size() + (last - first));
+  auto old = buffer.begin();
+  for (const Message *m = first; m != last; ++m) {
+    for (; old != buffer.end() && old->key < m->key; ++old)
+      merged.push_back(*old);
+    if (old != buffer.end() && old->key == m->key)
+      ++old;
+    merged.push_back(*m);
+  }
+  merged.insert(merged.end(), old, buffer.end());
+  buffer = std::move(merged);
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+void BEpsilonTree<Key, BufferBytes>::push(int key, bool erase) {
+  if (root == nullptr) {
+    root = newInner();
+    recent.reserve(RECENT_CAPACITY);
+  }
+  auto pos = std::lower_bound(
+      recent.begin(), recent.end(), key,
+      [](const Message &m, int k) { return m.key < k; });
+  if (pos != recent.end() && pos->key == key) {
+    count += int(!erase) - int(!pos->erase);
+    pos->erase = erase; // the older message for key is void
+    return;
+  }
+  SearchPath<> uncounted;
+  count += int(!erase) - int(find(key, uncounted).has_value());
+  recent.insert(pos, {Key(key), erase});
+  if (static_cast<int>(recent.size()) < RECENT_CAPACITY)
+    return;
+  foldRecent();
+  if (static_cast<int>(root->buffer.size()) >= BUFFER_CAPACITY) {
+    flush(root, false);
+    settleRoot();
+  }
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+void BEpsilonTree<Key, BufferBytes>::foldRecent() {
+  mergeMessages(root->buffer, recent.data(), recent.data() + recent.size());
+  recent.clear();
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+void BEpsilonTree<Key, BufferBytes>::flush(Inner *inner, bool all) {
+  if (inner->children.empty())
+    inner->children.push_back(newLeaf()); // the root of an empty tree
+
+  std::vector<Message> messages = std::move(inner->buffer);
+  inner->buffer.clear();
+  inner->buffer.reserve(BUFFER_CAPACITY);
+
+  // cut the sorted messages at the pivots before any child changes shape
+  int children = static_cast<int>(inner->children.size());
+  std::vector<std::size_t> cut(children + 1);
+  cut[children] = messages.size();
+  for (int i = 1; i < children; ++i) {
+    Key pivot = inner->pivots[i - 1];
+    cut[i] = std::lower_bound(messages.begin(), messages.end(), pivot,
+                              [](const Message &m, const Key &k) {
+                                return m.key < k;
+                              }) -
+             messages.begin();
+  }
+
+  // move down the biggest batches until half the buffer is free, the rest
+  // stays; a full flush moves everything
+  std::vector<int> order(children);
+  for (int i = 0; i < children; ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return cut[a + 1] - cut[a] > cut[b + 1] - cut[b];
+  });
+  std::vector<bool> chosen(children, all);
+  std::size_t staying = messages.size();
+  for (int j = 0; j < children && !all; ++j) {
+    if (staying <= static_cast<std::size_t>(BUFFER_CAPACITY / 2))
+      break;
+    chosen[order[j]] = true;
+    staying -= cut[order[j] + 1] - cut[order[j]];
+  }
+  for (int i = 0; i < children; ++i)
+    if (!chosen[i])
+      inner->buffer.insert(inner->buffer.end(), messages.begin() + cut[i],
+                           messages.begin() + cut[i + 1]);
+
+  // right to left, so replacing child i leaves the indices below it alone
+  for (int i = children - 1; i >= 0; --i) {
+    if (!chosen[i])
+      continue;
+    const Message *first = messages.data() + cut[i];
+    const Message *last = messages.data() + cut[i + 1];
+    Node *node = inner->children[i];
+    if (node->leaf) {
+      if (first != last)
+        replaceChild(inner, i, applyToLeaf(static_cast<Leaf *>(node), first,
+                                           last));
+      continue;
+    }
+
+    Inner *child = static_cast<Inner *>(node);
+    mergeMessages(child->buffer, first, last);
+    if (!all && static_cast<int>(child->buffer.size()) < BUFFER_CAPACITY)
+      continue;
+    flush(child, all);
+    if (child->children.empty()) {
+      delete child;
+      replaceChild(inner, i, {});
+    } else if (static_cast<int>(child->children.size()) > FANOUT) {
+      replaceChild(inner, i, splitInner(child));
+    }
+  }
+  mergeUnderfull(inner);
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+void BEpsilonTree<Key, BufferBytes>::mergeUnderfull(Inner *inner) {
+  // a child below a quarter of its capacity takes in its right neighbour
+  // (or joins its left one); a pair that comes out too big is split again
+  // in equal halves, which are at least half full, so this terminates
+  auto underfull = [](const Node *node) {
+    if (node->leaf)
+      return static_cast<const Leaf *>(node)->keys.size() * 4 <
+             static_cast<std::size_t>(LEAF_CAPACITY);
+    return static_cast<const Inner *>(node)->children.size() * 4 <
+           static_cast<std::size_t>(FANOUT);
+  };
+  std::size_t i = 0;
+  while (i < inner->children.size() && inner->children.size() > 1) {
+    if (!underfull(inner->children[i])) {
+      ++i;
+      continue;
+    }
+    std::size_t left = i + 1 < inner->children.size() ? i : i - 1;
+    Node *a = inner->children[left];
+    Node *b = inner->children[left + 1];
+    Key pivot = inner->pivots[left];
+    inner->children.erase(inner->children.begin() + left + 1);
+    inner->pivots.erase(inner->pivots.begin() + left);
+    countStat(counters, &TreeStats::merges);
+
+    std::vector<Piece> pieces;
+    if (a->leaf) {
+      Leaf *into = static_cast<Leaf *>(a);
+      Leaf *from = static_cast<Leaf *>(b);
+      into->keys.insert(into->keys.end(), from->keys.begin(),
+                        from->keys.end());
+      delete from;
+      pieces = applyToLeaf(into, nullptr, nullptr); // only splits
+    } else {
+      // b's range starts at pivot, so its buffer follows a's in key order
+      Inner *into = static_cast<Inner *>(a);
+      Inner *from = static_cast<Inner *>(b);
+      into->pivots.push_back(pivot);
+      into->pivots.insert(into->pivots.end(), from->pivots.begin(),
+                          from->pivots.end());
+      into->children.insert(into->children.end(), from->children.begin(),
+                            from->children.end());
+      into->buffer.insert(into->buffer.end(), from->buffer.begin(),
+                          from->buffer.end());
+      delete from;
+      if (static_cast<int>(into->children.size()) > FANOUT)
+        pieces = splitInner(into);
+      else
+        pieces.push_back({pivot, into});
+    }
+    replaceChild(inner, static_cast<int>(left), pieces);
+    i = left;
+    if (pieces.size() > 1)
+      i += pieces.size(); // both halves are full enough
+  }
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+std::vector<typename BEpsilonTree<Key, BufferBytes>::Piece>
+BEpsilonTree<Key, BufferBytes>::applyToLeaf(Leaf *leaf, const Message *first,
+                                            const Message *last) {
+  // one merge of two sorted runs; a message overrides the leaf's key
+  std::vector<Key> merged;
+  merged.reserve(leaf->keys.size() + (last - first));
+  auto key = leaf->keys.begin();
+  for (const Message *m = first; m != last; ++m) {
+    for (; key != leaf->keys.end() && *key < m->key; ++key)
+      merged.push_back(*key);
+    if (key != leaf->keys.end() && *key == m->key)
+      ++key;
+    if (!m->erase)
+      merged.push_back(m->key);
+  }
+  merged.insert(merged.end(), key, leaf->keys.end());
+
+  if (merged.empty()) {
+    delete leaf;
+    return {};
+  }
+
+  // equal pieces of at most LEAF_CAPACITY keys; the first reuses leaf
+  std::size_t n = merged.size();
+  std::size_t parts = (n + LEAF_CAPACITY - 1) / LEAF_CAPACITY;
+  std::vector<Piece> pieces;
+  for (std::size_t p = 0; p < parts; ++p) {
+    auto from = merged.begin() + p * n / parts;
+    auto to = merged.begin() + (p + 1) * n / parts;
+    Leaf *piece = p == 0 ? leaf : newLeaf();
+    if (p > 0)
+      countStat(counters, &TreeStats::splits);
+    piece->keys.assign(from, to);
+    pieces.push_back({*from, piece});
+  }
+  return pieces;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+std::vector<typename BEpsilonTree<Key, BufferBytes>::Piece>
+BEpsilonTree<Key, BufferBytes>::splitInner(Inner *inner) {
+  // the pivot between two pieces becomes the second piece's low, and the
+  // buffer follows the children, still sorted
+  std::vector<Node *> children = std::move(inner->children);
+  std::vector<Key> pivots = std::move(inner->pivots);
+  std::vector<Message> buffer = std::move(inner->buffer);
+  inner->buffer.clear();
+  std::size_t n = children.size();
+  std::size_t parts = (n + FANOUT - 1) / FANOUT;
+  std::vector<Piece> pieces;
+  for (std::size_t p = 0; p < parts; ++p) {
+    std::size_t from = p * n / parts;
+    std::size_t to = (p + 1) * n / parts;
+    Inner *piece = p == 0 ? inner : newInner();
+    if (p > 0)
+      countStat(counters, &TreeStats::splits);
+    piece->children.assign(children.begin() + from, children.begin() + to);
+    piece->pivots.assign(pivots.begin() + from, pivots.begin() + to - 1);
+    pieces.push_back({from > 0 ? pivots[from - 1] : Key{}, piece});
+  }
+  for (const Message &m : buffer) {
+    std::size_t p = parts - 1;
+    while (p > 0 && m.key < pieces[p].low)
+      --p;
+    static_cast<Inner *>(pieces[p].node)->buffer.push_back(m);
+  }
+  return pieces;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+void BEpsilonTree<Key, BufferBytes>::replaceChild(
+    Inner *inner, int i, const std::vector<Piece> &pieces) {
+  if (pieces.empty()) {
+    // the neighbour takes over the range, through the pivot that goes
+    inner->children.erase(inner->children.begin() + i);
+    if (!inner->pivots.empty())
+      inner->pivots.erase(inner->pivots.begin() + (i > 0 ? i - 1 : 0));
+    return;
+  }
+  inner->children[i] = pieces[0].node;
+  for (std::size_t p = 1; p < pieces.size(); ++p) {
+    inner->children.insert(inner->children.begin() + i + p, pieces[p].node);
+    inner->pivots.insert(inner->pivots.begin() + i + p - 1, pieces[p].low);
+  }
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+void BEpsilonTree<Key, BufferBytes>::settleRoot() {
+  // grow a level while the root is too wide, drop one while it is a mere
+  // pass-through with nothing buffered
+  while (static_cast<int>(root->children.size()) > FANOUT) {
+    Inner *top = newInner();
+    top->children.push_back(root);
+    replaceChild(top, 0, splitInner(root));
+    root = top;
+  }
+  while (root->buffer.empty() && root->children.size() == 1 &&
+         !root->children[0]->leaf) {
+    Inner *old = root;
+    root = static_cast<Inner *>(old->children[0]);
+    delete old;
+  }
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+void BEpsilonTree<Key, BufferBytes>::insert(int key) {
+  ScopedLatency<> timer(counters, &TreeStats::insertLatency);
+  push(key, false);
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+void BEpsilonTree<Key, BufferBytes>::remove(int key) {
+  ScopedLatency<> timer(counters, &TreeStats::removeLatency);
+  push(key, true);
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+std::optional<Key> BEpsilonTree<Key, BufferBytes>::search(int key) const {
+  ScopedLatency<> timer(counters, &TreeStats::searchLatency);
+  SearchPath<> path;
+  std::optional<Key> found = find(key, path);
+  recordSearch(counters, path.length());
+  return found;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+std::optional<Key>
+BEpsilonTree<Key, BufferBytes>::find(int key, SearchPath<> &path) const {
+  const Node *node = root;
+  if (node == nullptr)
+    return std::nullopt;
+  auto r = std::lower_bound(recent.begin(), recent.end(), key,
+                            [](const Message &m, int k) { return m.key < k; });
+  if (r != recent.end() && r->key == key)
+    return r->erase ? std::nullopt : std::optional<Key>(r->key);
+  while (!node->leaf) {
+    path.visit();
+    const Inner *inner = static_cast<const Inner *>(node);
+    // the buffers nearest the root are the newest: the first hit settles it
+    auto m = std::lower_bound(
+        inner->buffer.begin(), inner->buffer.end(), key,
+        [](const Message &m, int k) { return m.key < k; });
+    if (m != inner->buffer.end() && m->key == key)
+      return m->erase ? std::nullopt : std::optional<Key>(m->key);
+    if (inner->children.empty())
+      return std::nullopt;
+    auto pos = std::upper_bound(inner->pivots.begin(), inner->pivots.end(),
+                                key);
+    node = inner->children[pos - inner->pivots.begin()];
+  }
+  path.visit();
+  const Leaf *leaf = static_cast<const Leaf *>(node);
+  auto pos = std::lower_bound(leaf->keys.begin(), leaf->keys.end(), key);
+  if (pos == leaf->keys.end() || *pos != key)
+    return std::nullopt;
+  return *pos;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+template <bool Reverse, typename F>
+bool BEpsilonTree<Key, BufferBytes>::mergeLeaf(const Key *first,
+                                               const Key *last,
+                                               std::vector<Span> &spans,
+                                               F &visit) {
+  // a k-way merge of the leaf's keys with the messages above it, spans[0]
+  // the newest; the cursors move through the buffers without copying them.
+  // Returns false once visit() asks to stop.
+  for (;;) {
+    const Key *next = nullptr;
+    auto consider = [&](const Key &k) {
+      if (next == nullptr || (Reverse ? *next < k : k < *next))
+        next = &k;
+    };
+    if (first != last)
+      consider(Reverse ? last[-1] : *first);
+    for (const Span &span : spans)
+      if (span.first != span.last)
+        consider(Reverse ? span.last[-1].key : span.first->key);
+    if (next == nullptr)
+      return true;
+
+    // the newest message for the key decides, and every cursor on it moves
+    Key key = *next;
+    std::optional<bool> erase;
+    for (Span &span : spans) {
+      if (span.first == span.last)
+        continue;
+      const Message &m = Reverse ? span.last[-1] : *span.first;
+      if (m.key != key)
+        continue;
+      if (!erase)
+        erase = m.erase;
+      if constexpr (Reverse)
+        --span.last;
+      else
+        ++span.first;
+    }
+    if (first != last && (Reverse ? last[-1] : *first) == key) {
+      if constexpr (Reverse)
+        --last;
+      else
+        ++first;
+    }
+    if (!erase.value_or(false) && !visit(key))
+      return false;
+  }
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+template <bool Reverse, typename F>
+bool BEpsilonTree<Key, BufferBytes>::walk(const Node *node, int lo, int hi,
+                                          std::vector<Span> &spans,
+                                          F &visit) const {
+  // spans: the ancestors' messages for [lo, hi], newest first. Returns
+  // false once visit() asks to stop.
+  if (node->leaf) {
+    const std::vector<Key> &keys = static_cast<const Leaf *>(node)->keys;
+    const Key *first = std::lower_bound(keys.data(), keys.data() + keys.size(),
+                                        lo, [](const Key &k, int key) {
+                                          return k < key;
+                                        });
+    const Key *last = std::upper_bound(first, keys.data() + keys.size(), hi,
+                                       [](int key, const Key &k) {
+                                         return key < k;
+                                       });
+    return mergeLeaf<Reverse>(first, last, spans, visit);
+  }
+
+  const Inner *inner = static_cast<const Inner *>(node);
+  spans.push_back(narrow(
+      {inner->buffer.data(), inner->buffer.data() + inner->buffer.size()}, lo,
+      hi));
+  if (inner->children.empty()) {
+    bool more = mergeLeaf<Reverse>(nullptr, nullptr, spans, visit);
+    spans.pop_back();
+    return more;
+  }
+
+  // each child sees the spans cut down to its own range
+  std::vector<Span> outer = spans;
+  int children = static_cast<int>(inner->children.size());
+  for (int j = 0; j < children; ++j) {
+    int i = Reverse ? children - 1 - j : j;
+    int low = i > 0 ? std::max<int>(lo, inner->pivots[i - 1]) : lo;
+    int high = i + 1 < children ? std::min<int>(hi, inner->pivots[i] - 1) : hi;
+    if (high < low)
+      continue;
+    spans.resize(outer.size());
+    for (std::size_t k = 0; k < outer.size(); ++k)
+      spans[k] = narrow(outer[k], low, high);
+    if (!walk<Reverse>(inner->children[i], low, high, spans, visit))
+      return false;
+  }
+  spans.resize(outer.size() - 1);
+  return true;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+template <bool Reverse, typename F>
+void BEpsilonTree<Key, BufferBytes>::visitRange(int lo, int hi,
+                                                F &visit) const {
+  if (root == nullptr)
+    return; // an empty tree
+  std::vector<Span> spans{
+      narrow({recent.data(), recent.data() + recent.size()}, lo, hi)};
+  walk<Reverse>(root, lo, hi, spans, visit);
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+std::optional<Key> BEpsilonTree<Key, BufferBytes>::minimum() const {
+  std::optional<Key> found;
+  auto first = [&](const Key &k) {
+    found = k;
+    return false;
+  };
+  visitRange<false>(std::numeric_limits<int>::min(),
+                    std::numeric_limits<int>::max(), first);
+  return found;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+std::optional<Key> BEpsilonTree<Key, BufferBytes>::maximum() const {
+  std::optional<Key> found;
+  auto last = [&](const Key &k) {
+    found = k;
+    return false;
+  };
+  visitRange<true>(std::numeric_limits<int>::min(),
+                   std::numeric_limits<int>::max(), last);
+  return found;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+std::optional<Key> BEpsilonTree<Key, BufferBytes>::successor(int key) const {
+  SearchPath<> uncounted;
+  if (!find(key, uncounted) || key == std::numeric_limits<int>::max())
+    return std::nullopt; // like BinarySearchTree, only keys in the tree
+  std::optional<Key> found;
+  auto first = [&](const Key &k) {
+    found = k;
+    return false;
+  };
+  visitRange<false>(key + 1, std::numeric_limits<int>::max(), first);
+  return found;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+int BEpsilonTree<Key, BufferBytes>::size() const {
+  return count;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+int BEpsilonTree<Key, BufferBytes>::height() const {
+  if (root == nullptr)
+    return 0;
+  int levels = 1;
+  for (const Node *node = root;
+       node != nullptr && !node->leaf &&
+       !static_cast<const Inner *>(node)->children.empty();
+       node = static_cast<const Inner *>(node)->children[0])
+    ++levels;
+  return levels;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+void BEpsilonTree<Key, BufferBytes>::flush() {
+  if (root == nullptr)
+    return;
+  foldRecent();
+  flush(root, true);
+  settleRoot();
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+TreeStats BEpsilonTree<Key, BufferBytes>::stats() const {
+  TreeStats result = statsOf(counters);
+  result.bytes = sizeof(*this) + recent.capacity() * sizeof(Message);
+  std::vector<std::pair<const Node *, std::size_t>> stack;
+  if (root != nullptr)
+    stack.push_back({root, 0});
+  while (!stack.empty()) {
+    auto [node, depth] = stack.back();
+    stack.pop_back();
+    countNode(result, depth);
+    if (node->leaf) {
+      const Leaf *leaf = static_cast<const Leaf *>(node);
+      result.bytes += sizeof(Leaf) + leaf->keys.capacity() * sizeof(Key);
+      continue;
+    }
+    const Inner *inner = static_cast<const Inner *>(node);
+    result.bytes += sizeof(Inner) + inner->pivots.capacity() * sizeof(Key) +
+                    inner->children.capacity() * sizeof(Node *) +
+                    inner->buffer.capacity() * sizeof(Message);
+    for (const Node *child : inner->children)
+      stack.push_back({child, depth + 1});
+  }
+  return result;
+}
+
+template <KeyComparble Key, std::size_t BufferBytes>
+template <typename Visitor>
+void BEpsilonTree<Key, BufferBytes>::scan(int lo, int hi,
+                                          Visitor &&visit) const {
+  auto all = [&](const Key &k) {
+    visit(k);
+    return true;
+  };
+  visitRange<false>(lo, hi, all);
+}
+
+} // namespace TREE
@@ -0,0 +1,693 @@
+#pragma once
+
+#include "node.hpp"
+#include "stats.hpp"
+#include <bit>
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                                 B+ Trees
+//-------------------------------------------------------------------------------
+
+// Ordered set with the insert/search/remove/minimum/maximum/successor
+// interface of BinarySearchTree, stored as a B+tree whose nodes are
+// NodeBytes large (a multiple of the 64-byte cache line). A lookup touches
+// one node per level instead of one per key comparison, keys inside a node
+// are searched with SSE2 when Key is int, and the leaves are linked in both
+// directions so successor() and range scans walk them sequentially.
+//
+// search/minimum/maximum/successor return a pointer to the key inside its
+// leaf, or nullptr; it stays valid until the next insert or remove. An empty
+// tree owns no nodes, so construction and moves allocate nothing.
+template <KeyComparble Key, std::size_t NodeBytes = 256> class BPlusTree {
+  static_assert(NodeBytes % 64 == 0, "nodes are whole cache lines");
+
+protected:
+  struct Node {
+    bool leaf;
+    int count; // keys in use
+  };
+
+  static constexpr int LEAF_CAPACITY = static_cast<int>(
+      (NodeBytes - sizeof(Node) - 2 * sizeof(void *)) / sizeof(Key));
+  static constexpr int INNER_CAPACITY = static_cast<int>(
+      (NodeBytes - sizeof(Node) - sizeof(void *)) /
+      (sizeof(Key) + sizeof(void *)));
+  static_assert(LEAF_CAPACITY >= 4 && INNER_CAPACITY >= 4,
+                "NodeBytes too small for this key type");
+
+  struct alignas(64) Leaf : Node {
+    Leaf *prev;
+    Leaf *next;
+    Key keys[LEAF_CAPACITY];
+  };
+
+  // children[i] holds the keys in [keys[i - 1], keys[i])
+  struct alignas(64) Inner : Node {
+    Key keys[INNER_CAPACITY];
+    Node *children[INNER_CAPACITY + 1];
+  };
+
+  struct Split {
+    Key key{};            // smallest key of right
+    Node *right{nullptr}; // new sibling, nullptr when nothing split
+  };
+
+  Node *root{nullptr}; // nullptr when no leaf has been made yet
+  Leaf *head{nullptr}; // leftmost leaf
+  Leaf *tail{nullptr}; // rightmost leaf
+  int count{0};
+  [[no_unique_address]] mutable StatsCollector counters; // see stats.hpp
+
+  static Leaf *newLeaf();
+  static int lowerBound(const Key *keys, int n, int key);
+  static int upperBound(const Key *keys, int n, int key);
+  Leaf *findLeaf(int key, SearchPath<> &path) const;
+  Leaf *findLeaf(int key) const;
+
+  bool insertInto(Node *node, int key, Split &split);
+  Split splitLeaf(Leaf *leaf, int pos, int key);
+  Split splitInner(Inner *inner, int pos, const Split &child);
+
+  bool removeFrom(Node *node, int key);
+  void fixUnderflow(Inner *parent, int i);
+  void mergeChildren(Inner *parent, int i);
+
+  void cloneFrom(const BPlusTree &other);
+  void destroySubtree(Node *node);
+
+public:
+  BPlusTree() = default;
+  BPlusTree(std::initializer_list<int> list);
+  ~BPlusTree();
+
+  // Copies are iterative and rebuild the leaf chain; moves are O(1) and
+  // leave the source empty.
+  BPlusTree(const BPlusTree &other);
+  BPlusTree(BPlusTree &&other) noexcept;
+  BPlusTree &operator=(const BPlusTree &other);
+  BPlusTree &operator=(BPlusTree &&other) noexcept;
+
+  BPlusTree &operator=(std::initializer_list<int> list);
+  void clear();
+
+  void insert(int key);
+  const Key *search(int key) const;
+  void remove(int key);
+  const Key *minimum() const;
+  const Key *maximum() const;
+  const Key *successor(int key) const;
+
+  int size() const;
+  int height() const;
+
+  // Counters when built with TREE_STATS, plus the current shape. Search
+  // paths and the depth histogram count nodes, not keys.
+  TreeStats stats() const;
+
+  // visit(key) for every key in [lo, hi], in order, along the leaf chain
+  template <typename Visitor> void scan(int lo, int hi, Visitor &&visit) const;
+};
+
+//-------------------------------------------------------------------------------
+//                          BPlusTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key, std::size_t NodeBytes>
+BPlusTree<Key, NodeBytes>::BPlusTree(std::initializer_list<int> list) {
+  for (int key : list)
+    insert(key);
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+BPlusTree<Key, NodeBytes>::~BPlusTree() {
+  destroySubtree(root);
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+BPlusTree<Key, NodeBytes>::BPlusTree(const BPlusTree &other) {
+  cloneFrom(other);
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+BPlusTree<Key, NodeBytes>::BPlusTree(BPlusTree &&other) noexcept
+    : root(std::exchange(other.root, nullptr)),
+      head(std::exchange(other.head, nullptr)),
+      tail(std::exchange(other.tail, nullptr)),
+      count(std::exchange(other.count, 0)) {}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+BPlusTree<Key, NodeBytes> &
+BPlusTree<Key, NodeBytes>::operator=(const BPlusTree &other) {
+  if (this != &other) {
+    BPlusTree copy(other);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+BPlusTree<Key, NodeBytes> &
+BPlusTree<Key, NodeBytes>::operator=(BPlusTree &&other) noexcept {
+  if (this != &other) {
+    destroySubtree(root);
+    root = std::exchange(other.root, nullptr);
+    head = std::exchange(other.head, nullptr);
+    tail = std::exchange(other.tail, nullptr);
+    count = std::exchange(other.count, 0);
+  }
+  return *this;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+BPlusTree<Key, NodeBytes> &
+BPlusTree<Key, NodeBytes>::operator=(std::initializer_list<int> list) {
+  clear();
+  for (int key : list)
+    insert(key);
+  return *this;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+void BPlusTree<Key, NodeBytes>::clear() {
+  destroySubtree(root);
+  root = head = tail = nullptr;
+  count = 0;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+typename BPlusTree<Key, NodeBytes>::Leaf *
+BPlusTree<Key, NodeBytes>::newLeaf() {
+  Leaf *leaf = new Leaf;
+  leaf->leaf = true;
+  leaf->count = 0;
+  leaf->prev = leaf->next = nullptr;
+  return leaf;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+void BPlusTree<Key, NodeBytes>::cloneFrom(const BPlusTree &other) {
+  // preorder with the children pushed right to left, so the leaves come
+  // out in key order and are chained as they are made
+  struct Pending {
+    const Node *source;
+    Node **slot;
+  };
+  std::vector<Pending> stack;
+  if (other.root != nullptr)
+    stack.push_back({other.root, &root});
+  while (!stack.empty()) {
+    Pending next = stack.back();
+    stack.pop_back();
+    if (next.source->leaf) {
+      Leaf *leaf = new Leaf(*static_cast<const Leaf *>(next.source));
+      leaf->prev = tail;
+      leaf->next = nullptr;
+      if (tail != nullptr)
+        tail->next = leaf;
+      else
+        head = leaf;
+      tail = leaf;
+      *next.slot = leaf;
+    } else {
+      const Inner *source = static_cast<const Inner *>(next.source);
+      Inner *inner = new Inner(*source);
+      *next.slot = inner;
+      for (int i = inner->count; i >= 0; --i)
+        stack.push_back({source->children[i], &inner->children[i]});
+    }
+  }
+  count = other.count;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+void BPlusTree<Key, NodeBytes>::destroySubtree(Node *node) {
+  if (node == nullptr)
+    return;
+  if (!node->leaf) {
+    Inner *inner = static_cast<Inner *>(node);
+    for (int i = 0; i <= inner->count; ++i)
+      destroySubtree(inner->children[i]);
+    delete inner;
+  } else {
+    delete static_cast<Leaf *>(node);
+  }
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+int BPlusTree<Key, NodeBytes>::lowerBound(const Key *keys, int n, int key) {
+  // first i with keys[i] >= key, i.e. the number of keys below key
+#if defined(__SSE2__)
+  if constexpr (std::is_same_v<Key, int>) {
+    // count the smaller keys four at a time, no branches on the data
+    const __m128i needle = _mm_set1_epi32(key);
+    int less = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+      __m128i block =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+      __m128i lt = _mm_cmplt_epi32(block, needle);
+      less += std::popcount(
+          static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(lt))));
+    }
+    for (; i < n; ++i)
+      less += keys[i] < key;
+    return less;
+  }
+#endif
+  int lo = 0, hi = n;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (keys[mid] < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+int BPlusTree<Key, NodeBytes>::upperBound(const Key *keys, int n, int key) {
+  // first i with keys[i] > key
+#if defined(__SSE2__)
+  if constexpr (std::is_same_v<Key, int>) {
+    const __m128i needle = _mm_set1_epi32(key);
+    int notGreater = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+      __m128i block =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+      __m128i gt = _mm_cmpgt_epi32(block, needle);
+      notGreater += 4 - std::popcount(static_cast<unsigned>(
+                            _mm_movemask_ps(_mm_castsi128_ps(gt))));
+    }
+    for (; i < n; ++i)
+      notGreater += !(key < keys[i]);
+    return notGreater;
+  }
+#endif
+  int lo = 0, hi = n;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (key < keys[mid])
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+typename BPlusTree<Key, NodeBytes>::Leaf *
+BPlusTree<Key, NodeBytes>::findLeaf(int key, SearchPath<> &path) const {
+  Node *node = root;
+  if (node == nullptr)
+    return nullptr;
+  path.visit();
+  while (!node->leaf) {
+    Inner *inner = static_cast<Inner *>(node);
+    node = inner->children[upperBound(inner->keys, inner->count, key)];
+    path.visit();
+  }
+  return static_cast<Leaf *>(node);
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+typename BPlusTree<Key, NodeBytes>::Leaf *
+BPlusTree<Key, NodeBytes>::findLeaf(int key) const {
+  SearchPath<> uncounted;
+  return findLeaf(key, uncounted);
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+typename BPlusTree<Key, NodeBytes>::Split
+BPlusTree<Key, NodeBytes>::splitLeaf(Leaf *leaf, int pos, int key) {
+  // LEAF_CAPACITY + 1 keys: the lower half stays, the upper half moves
+  Key all[LEAF_CAPACITY + 1];
+  for (int i = 0, j = 0; i <= LEAF_CAPACITY; ++i)
+    all[i] = i == pos ? Key(key) : leaf->keys[j++];
+
+  countStat(counters, &TreeStats::splits);
+  Leaf *right = new Leaf;
+  right->leaf = true;
+  int half = (LEAF_CAPACITY + 1) / 2;
+  leaf->count = half;
+  right->count = LEAF_CAPACITY + 1 - half;
+  for (int i = 0; i < half; ++i)
+    leaf->keys[i] = all[i];
+  for (int i = 0; i < right->count; ++i)
+    right->keys[i] = all[half + i];
+
+  right->prev = leaf;
+  right->next = leaf->next;
+  if (leaf->next != nullptr)
+    leaf->next->prev = right;
+  else
+    tail = right;
+  leaf->next = right;
+
+  return {right->keys[0], right};
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+typename BPlusTree<Key, NodeBytes>::Split
+BPlusTree<Key, NodeBytes>::splitInner(Inner *inner, int pos,
+                                      const Split &child) {
+  // child split of children[pos]: its key goes to keys[pos], right after it
+  Key keys[INNER_CAPACITY + 1];
+  Node *children[INNER_CAPACITY + 2];
+  for (int i = 0, j = 0; i <= INNER_CAPACITY; ++i)
+    keys[i] = i == pos ? child.key : inner->keys[j++];
+  for (int i = 0, j = 0; i <= INNER_CAPACITY + 1; ++i)
+    children[i] = i == pos + 1 ? child.right : inner->children[j++];
+
+  // the middle key moves up, it is not kept in either half
+  int mid = (INNER_CAPACITY + 1) / 2;
+  countStat(counters, &TreeStats::splits);
+  Inner *right = new Inner;
+  right->leaf = false;
+  inner->count = mid;
+  right->count = INNER_CAPACITY - mid;
+  for (int i = 0; i < mid; ++i) {
+    inner->keys[i] = keys[i];
+    inner->children[i] = children[i];
+  }
+  inner->children[mid] = children[mid];
+  for (int i = 0; i < right->count; ++i) {
+    right->keys[i] = keys[mid + 1 + i];
+    right->children[i] = children[mid + 1 + i];
+  }
+  right->children[right->count] = children[INNER_CAPACITY + 1];
+
+  return {keys[mid], right};
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+bool BPlusTree<Key, NodeBytes>::insertInto(Node *node, int key,
+                                           Split &split) {
+  if (node->leaf) {
+    Leaf *leaf = static_cast<Leaf *>(node);
+    int pos = lowerBound(leaf->keys, leaf->count, key);
+    if (pos < leaf->count && leaf->keys[pos] == key)
+      return false; // Duplicate keys not allowed
+
+    if (leaf->count == LEAF_CAPACITY) {
+      split = splitLeaf(leaf, pos, key);
+      return true;
+    }
+    for (int i = leaf->count; i > pos; --i)
+      leaf->keys[i] = leaf->keys[i - 1];
+    leaf->keys[pos] = key;
+    leaf->count++;
+    return true;
+  }
+
+  Inner *inner = static_cast<Inner *>(node);
+  int pos = upperBound(inner->keys, inner->count, key);
+  Split child;
+  if (!insertInto(inner->children[pos], key, child))
+    return false;
+  if (child.right == nullptr)
+    return true;
+
+  if (inner->count == INNER_CAPACITY) {
+    split = splitInner(inner, pos, child);
+    return true;
+  }
+  for (int i = inner->count; i > pos; --i) {
+    inner->keys[i] = inner->keys[i - 1];
+    inner->children[i + 1] = inner->children[i];
+  }
+  inner->keys[pos] = child.key;
+  inner->children[pos + 1] = child.right;
+  inner->count++;
+  return true;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+void BPlusTree<Key, NodeBytes>::mergeChildren(Inner *parent, int i) {
+  // fold children[i + 1] into children[i] and drop the separator keys[i]
+  Node *left = parent->children[i];
+  Node *right = parent->children[i + 1];
+  countStat(counters, &TreeStats::merges);
+
+  if (left->leaf) {
+    Leaf *l = static_cast<Leaf *>(left);
+    Leaf *r = static_cast<Leaf *>(right);
+    for (int k = 0; k < r->count; ++k)
+      l->keys[l->count + k] = r->keys[k];
+    l->count += r->count;
+    l->next = r->next;
+    if (r->next != nullptr)
+      r->next->prev = l;
+    else
+      tail = l;
+    delete r;
+  } else {
+    Inner *l = static_cast<Inner *>(left);
+    Inner *r = static_cast<Inner *>(right);
+    l->keys[l->count] = parent->keys[i];
+    for (int k = 0; k < r->count; ++k)
+      l->keys[l->count + 1 + k] = r->keys[k];
+    for (int k = 0; k <= r->count; ++k)
+      l->children[l->count + 1 + k] = r->children[k];
+    l->count += r->count + 1;
+    delete r;
+  }
+
+  for (int k = i; k + 1 < parent->count; ++k) {
+    parent->keys[k] = parent->keys[k + 1];
+    parent->children[k + 1] = parent->children[k + 2];
+  }
+  parent->count--;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+void BPlusTree<Key, NodeBytes>::fixUnderflow(Inner *parent, int i) {
+  // children[i] dropped below half full: borrow from a sibling that can
+  // spare a key, otherwise merge with one
+  Node *node = parent->children[i];
+  Node *left = i > 0 ? parent->children[i - 1] : nullptr;
+  Node *right = i < parent->count ? parent->children[i + 1] : nullptr;
+  int minimum = (node->leaf ? LEAF_CAPACITY : INNER_CAPACITY) / 2;
+
+  if (left != nullptr && left->count > minimum) {
+    if (node->leaf) {
+      Leaf *n = static_cast<Leaf *>(node);
+      Leaf *l = static_cast<Leaf *>(left);
+      for (int k = n->count; k > 0; --k)
+        n->keys[k] = n->keys[k - 1];
+      n->keys[0] = l->keys[l->count - 1];
+      parent->keys[i - 1] = n->keys[0];
+    } else {
+      Inner *n = static_cast<Inner *>(node);
+      Inner *l = static_cast<Inner *>(left);
+      for (int k = n->count; k > 0; --k)
+        n->keys[k] = n->keys[k - 1];
+      for (int k = n->count + 1; k > 0; --k)
+        n->children[k] = n->children[k - 1];
+      n->keys[0] = parent->keys[i - 1];
+      n->children[0] = l->children[l->count];
+      parent->keys[i - 1] = l->keys[l->count - 1];
+    }
+    left->count--;
+    node->count++;
+    return;
+  }
+
+  if (right != nullptr && right->count > minimum) {
+    if (node->leaf) {
+      Leaf *n = static_cast<Leaf *>(node);
+      Leaf *r = static_cast<Leaf *>(right);
+      n->keys[n->count] = r->keys[0];
+      for (int k = 0; k + 1 < r->count; ++k)
+        r->keys[k] = r->keys[k + 1];
+      parent->keys[i] = r->keys[0];
+    } else {
+      Inner *n = static_cast<Inner *>(node);
+      Inner *r = static_cast<Inner *>(right);
+      n->keys[n->count] = parent->keys[i];
+      n->children[n->count + 1] = r->children[0];
+      parent->keys[i] = r->keys[0];
+      for (int k = 0; k + 1 < r->count; ++k)
+        r->keys[k] = r->keys[k + 1];
+      for (int k = 0; k < r->count; ++k)
+        r->children[k] = r->children[k + 1];
+    }
+    right->count--;
+    node->count++;
+    return;
+  }
+
+  if (left != nullptr)
+    mergeChildren(parent, i - 1);
+  else
+    mergeChildren(parent, i);
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+bool BPlusTree<Key, NodeBytes>::removeFrom(Node *node, int key) {
+  if (node->leaf) {
+    Leaf *leaf = static_cast<Leaf *>(node);
+    int pos = lowerBound(leaf->keys, leaf->count, key);
+    if (pos == leaf->count || leaf->keys[pos] != key)
+      return false;
+    for (int i = pos; i + 1 < leaf->count; ++i)
+      leaf->keys[i] = leaf->keys[i + 1];
+    leaf->count--;
+    return true;
+  }
+
+  // separators may keep a removed key; they still split the key space
+  Inner *inner = static_cast<Inner *>(node);
+  int pos = upperBound(inner->keys, inner->count, key);
+  if (!removeFrom(inner->children[pos], key))
+    return false;
+
+  Node *child = inner->children[pos];
+  int minimum = (child->leaf ? LEAF_CAPACITY : INNER_CAPACITY) / 2;
+  if (child->count < minimum)
+    fixUnderflow(inner, pos);
+  return true;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+void BPlusTree<Key, NodeBytes>::insert(int key) {
+  ScopedLatency<> timer(counters, &TreeStats::insertLatency);
+  if (root == nullptr)
+    root = head = tail = newLeaf();
+  Split split;
+  if (!insertInto(root, key, split))
+    return;
+  count++;
+
+  if (split.right != nullptr) {
+    Inner *top = new Inner;
+    top->leaf = false;
+    top->count = 1;
+    top->keys[0] = split.key;
+    top->children[0] = root;
+    top->children[1] = split.right;
+    root = top;
+  }
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+const Key *BPlusTree<Key, NodeBytes>::search(int key) const {
+  ScopedLatency<> timer(counters, &TreeStats::searchLatency);
+  SearchPath<> path;
+  Leaf *leaf = findLeaf(key, path);
+  recordSearch(counters, path.length());
+  if (leaf == nullptr)
+    return nullptr;
+  int pos = lowerBound(leaf->keys, leaf->count, key);
+  if (pos < leaf->count && leaf->keys[pos] == key)
+    return &leaf->keys[pos];
+  return nullptr;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+void BPlusTree<Key, NodeBytes>::remove(int key) {
+  ScopedLatency<> timer(counters, &TreeStats::removeLatency);
+  if (root == nullptr || !removeFrom(root, key))
+    return;
+  count--;
+
+  // the last key takes the last leaf with it, the root may shrink to a
+  // single child
+  if (count == 0) {
+    destroySubtree(root);
+    root = head = tail = nullptr;
+  } else if (!root->leaf && root->count == 0) {
+    Inner *old = static_cast<Inner *>(root);
+    root = old->children[0];
+    delete old;
+  }
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+const Key *BPlusTree<Key, NodeBytes>::minimum() const {
+  return count > 0 ? &head->keys[0] : nullptr;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+const Key *BPlusTree<Key, NodeBytes>::maximum() const {
+  return count > 0 ? &tail->keys[tail->count - 1] : nullptr;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+const Key *BPlusTree<Key, NodeBytes>::successor(int key) const {
+  Leaf *leaf = findLeaf(key);
+  if (leaf == nullptr)
+    return nullptr;
+  int pos = lowerBound(leaf->keys, leaf->count, key);
+  if (pos == leaf->count || leaf->keys[pos] != key)
+    return nullptr; // like BinarySearchTree, only keys in the tree
+  if (pos + 1 < leaf->count)
+    return &leaf->keys[pos + 1];
+  return leaf->next != nullptr ? &leaf->next->keys[0] : nullptr;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+int BPlusTree<Key, NodeBytes>::size() const {
+  return count;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+int BPlusTree<Key, NodeBytes>::height() const {
+  int levels = 0;
+  for (Node *node = root; node != nullptr;
+       node = node->leaf ? nullptr : static_cast<Inner *>(node)->children[0])
+    ++levels;
+  return levels;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+TreeStats BPlusTree<Key, NodeBytes>::stats() const {
+  TreeStats result = statsOf(counters);
+  result.bytes = sizeof(*this);
+  std::vector<std::pair<const Node *, std::size_t>> stack;
+  if (root != nullptr)
+    stack.push_back({root, 0});
+  while (!stack.empty()) {
+    auto [node, depth] = stack.back();
+    stack.pop_back();
+    countNode(result, depth);
+    if (node->leaf) {
+      result.bytes += sizeof(Leaf);
+      continue;
+    }
+    const Inner *inner = static_cast<const Inner *>(node);
+    result.bytes += sizeof(Inner);
+    for (int i = 0; i <= inner->count; ++i)
+      stack.push_back({inner->children[i], depth + 1});
+  }
+  return result;
+}
+
+template <KeyComparble Key, std::size_t NodeBytes>
+template <typename Visitor>
+void BPlusTree<Key, NodeBytes>::scan(int lo, int hi, Visitor &&visit) const {
+  Leaf *leaf = findLeaf(lo);
+  if (leaf == nullptr)
+    return;
+  int pos = lowerBound(leaf->keys, leaf->count, lo);
+  for (; leaf != nullptr; leaf = leaf->next, pos = 0) {
+    for (; pos < leaf->count; ++pos) {
+      if (hi < leaf->keys[pos])
+        return;
+      visit(leaf->keys[pos]);
+    }
+  }
+}
+
+} // namespace TREE
@@ -0,0 +1,861 @@
+#pragma once
+
+#include "node.hpp"
+#include "stats.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                              Compact Node Pool
+//-------------------------------------------------------------------------------
+
+// Contiguous storage for CompactAVLNode / CompactRBTNode. Links are indices
+// into the pool, which halves them against pointers and keeps every node of
+// a tree in one allocation. Slot 0 is reserved: it stands for "no node" (and
+// is the black NIL sentinel of the red-black tree). Released slots are
+// chained through left and reused before the pool grows. An index has to
+// fit in NodeT::INDEX_MASK, the bits above it hold the balance or colour, so
+// growing past 2^30 (AVL) or 2^31 (red-black) slots throws
+// std::length_error, like a vector that cannot grow any further.
+template <typename NodeT> class CompactPool {
+  std::vector<NodeT> nodes;
+  std::uint32_t freeList{0};
+
+public:
+  explicit CompactPool(const NodeT &sentinel) { nodes.push_back(sentinel); }
+
+  NodeT &operator[](std::uint32_t index) { return nodes[index]; }
+  const NodeT &operator[](std::uint32_t index) const { return nodes[index]; }
+
+  std::uint32_t allocate(const typename NodeT::key_type &key);
+  void release(std::uint32_t index);
+  std::size_t bytes() const { return nodes.capacity() * sizeof(NodeT); }
+};
+
+template <typename NodeT>
+std::uint32_t CompactPool<NodeT>::allocate(const typename NodeT::key_type &key) {
+  if (freeList != 0) {
+    std::uint32_t index = freeList;
+    freeList = nodes[index].left;
+    nodes[index] = NodeT(key);
+    return index;
+  }
+  if (nodes.size() > NodeT::INDEX_MASK)
+    throw std::length_error("CompactPool: node index out of range");
+  nodes.push_back(NodeT(key));
+  return static_cast<std::uint32_t>(nodes.size() - 1);
+}
+
+template <typename NodeT> void CompactPool<NodeT>::release(std::uint32_t index) {
+  nodes[index].left = freeList;
+  freeList = index;
+}
+
+//-------------------------------------------------------------------------------
+//                             Compact AVL Trees
+//-------------------------------------------------------------------------------
+
+// AVL tree over a CompactPool with 2-bit balance factors instead of heights.
+// Without parent links insert and remove are recursive and report upwards
+// whether the subtree grew or shrank, which is all a balance factor needs.
+// Pointers returned by search/minimum/maximum are invalidated by insert.
+template <KeyComparble Key> class CompactAVLTree {
+protected:
+  using NodeT = CompactAVLNode<Key>;
+
+  CompactPool<NodeT> pool{NodeT(Key{})};
+  std::uint32_t root{0};
+  int count{0};
+  [[no_unique_address]] mutable StatsCollector counters; // see stats.hpp
+
+  std::uint32_t left(std::uint32_t n) const;
+  std::uint32_t right(std::uint32_t n) const;
+  int balanceOf(std::uint32_t n) const; // height(right) - height(left)
+  void setLeft(std::uint32_t n, std::uint32_t child);
+  void setRight(std::uint32_t n, std::uint32_t child);
+  void setBalance(std::uint32_t n, int balance);
+
+  std::uint32_t rotateLeft(std::uint32_t n);
+  std::uint32_t rotateRight(std::uint32_t n);
+  std::uint32_t rotateLeftRight(std::uint32_t n);
+  std::uint32_t rotateRightLeft(std::uint32_t n);
+
+  std::uint32_t growLeft(std::uint32_t n, bool &grew);
+  std::uint32_t growRight(std::uint32_t n, bool &grew);
+  std::uint32_t shrinkLeft(std::uint32_t n, bool &shrank);
+  std::uint32_t shrinkRight(std::uint32_t n, bool &shrank);
+
+  std::uint32_t insertNode(std::uint32_t n, int key, bool &grew);
+  std::uint32_t removeNode(std::uint32_t n, int key, bool &shrank);
+  std::uint32_t removeMinimum(std::uint32_t n, std::uint32_t &minimum,
+                              bool &shrank);
+  int heightOf(std::uint32_t n) const;
+
+public:
+  CompactAVLTree() = default;
+  CompactAVLTree(std::initializer_list<int> list);
+
+  void insert(int key);
+  const Key *search(int key) const;
+  void remove(int key);
+  const Key *minimum() const;
+  const Key *maximum() const;
+
+  int size() const;
+  int height() const;
+  std::size_t memoryUsage() const; // bytes held by the node pool
+
+  // Counters when built with TREE_STATS, plus the current shape; bytes
+  // counts the whole pool, free slots included.
+  TreeStats stats() const;
+};
+
+//-------------------------------------------------------------------------------
+//                         CompactAVLTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key>
+CompactAVLTree<Key>::CompactAVLTree(std::initializer_list<int> list) {
+  for (int key : list)
+    insert(key);
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::left(std::uint32_t n) const {
+  return pool[n].left;
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::right(std::uint32_t n) const {
+  return pool[n].right & NodeT::INDEX_MASK;
+}
+
+template <KeyComparble Key>
+int CompactAVLTree<Key>::balanceOf(std::uint32_t n) const {
+  return static_cast<int>(pool[n].right >> 30) - 1;
+}
+
+template <KeyComparble Key>
+void CompactAVLTree<Key>::setLeft(std::uint32_t n, std::uint32_t child) {
+  pool[n].left = child;
+}
+
+template <KeyComparble Key>
+void CompactAVLTree<Key>::setRight(std::uint32_t n, std::uint32_t child) {
+  pool[n].right = (pool[n].right & ~NodeT::INDEX_MASK) | child;
+}
+
+template <KeyComparble Key>
+void CompactAVLTree<Key>::setBalance(std::uint32_t n, int balance) {
+  pool[n].right = right(n) | static_cast<std::uint32_t>(balance + 1) << 30;
+}
+
+// Plain rotations; the callers know the new balance factors.
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::rotateLeft(std::uint32_t n) {
+  std::uint32_t r = right(n);
+  countStat(counters, &TreeStats::rotations);
+  setRight(n, left(r));
+  setLeft(r, n);
+  return r;
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::rotateRight(std::uint32_t n) {
+  std::uint32_t l = left(n);
+  countStat(counters, &TreeStats::rotations);
+  setLeft(n, right(l));
+  setRight(l, n);
+  return l;
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::rotateLeftRight(std::uint32_t n) {
+  std::uint32_t l = left(n);
+  countStat(counters, &TreeStats::rotationsLR);
+  std::uint32_t lr = right(l);
+  int b = balanceOf(lr);
+  setLeft(n, rotateLeft(l));
+  rotateRight(n);
+  setBalance(n, b == -1 ? 1 : 0);
+  setBalance(l, b == 1 ? -1 : 0);
+  setBalance(lr, 0);
+  return lr;
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::rotateRightLeft(std::uint32_t n) {
+  std::uint32_t r = right(n);
+  countStat(counters, &TreeStats::rotationsRL);
+  std::uint32_t rl = left(r);
+  int b = balanceOf(rl);
+  setRight(n, rotateRight(r));
+  rotateLeft(n);
+  setBalance(n, b == 1 ? -1 : 0);
+  setBalance(r, b == -1 ? 1 : 0);
+  setBalance(rl, 0);
+  return rl;
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::growLeft(std::uint32_t n, bool &grew) {
+  switch (balanceOf(n)) {
+  case 1:
+    setBalance(n, 0);
+    grew = false;
+    return n;
+  case 0:
+    setBalance(n, -1);
+    return n;
+  default:
+    grew = false;
+    if (balanceOf(left(n)) == -1) {
+      countStat(counters, &TreeStats::rotationsLL);
+      std::uint32_t l = rotateRight(n);
+      setBalance(n, 0);
+      setBalance(l, 0);
+      return l;
+    }
+    return rotateLeftRight(n);
+  }
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::growRight(std::uint32_t n, bool &grew) {
+  switch (balanceOf(n)) {
+  case -1:
+    setBalance(n, 0);
+    grew = false;
+    return n;
+  case 0:
+    setBalance(n, 1);
+    return n;
+  default:
+    grew = false;
+    if (balanceOf(right(n)) == 1) {
+      countStat(counters, &TreeStats::rotationsRR);
+      std::uint32_t r = rotateLeft(n);
+      setBalance(n, 0);
+      setBalance(r, 0);
+      return r;
+    }
+    return rotateRightLeft(n);
+  }
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::shrinkLeft(std::uint32_t n, bool &shrank) {
+  switch (balanceOf(n)) {
+  case -1:
+    setBalance(n, 0);
+    return n;
+  case 0:
+    setBalance(n, 1);
+    shrank = false;
+    return n;
+  default: {
+    int rightBalance = balanceOf(right(n));
+    if (rightBalance == -1)
+      return rotateRightLeft(n);
+    countStat(counters, &TreeStats::rotationsRR);
+    std::uint32_t r = rotateLeft(n);
+    if (rightBalance == 0) {
+      // height unchanged, the subtree now leans left
+      setBalance(n, 1);
+      setBalance(r, -1);
+      shrank = false;
+    } else {
+      setBalance(n, 0);
+      setBalance(r, 0);
+    }
+    return r;
+  }
+  }
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::shrinkRight(std::uint32_t n, bool &shrank) {
+  switch (balanceOf(n)) {
+  case 1:
+    setBalance(n, 0);
+    return n;
+  case 0:
+    setBalance(n, -1);
+    shrank = false;
+    return n;
+  default: {
+    int leftBalance = balanceOf(left(n));
+    if (leftBalance == 1)
+      return rotateLeftRight(n);
+    countStat(counters, &TreeStats::rotationsLL);
+    std::uint32_t l = rotateRight(n);
+    if (leftBalance == 0) {
+      setBalance(n, -1);
+      setBalance(l, 1);
+      shrank = false;
+    } else {
+      setBalance(n, 0);
+      setBalance(l, 0);
+    }
+    return l;
+  }
+  }
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::insertNode(std::uint32_t n, int key,
+                                              bool &grew) {
+  if (n == 0) {
+    grew = true;
+    count++;
+    return pool.allocate(key); // may move the pool, hold no references
+  }
+
+  if (key < pool[n].key) {
+    std::uint32_t child = insertNode(left(n), key, grew);
+    setLeft(n, child);
+    return grew ? growLeft(n, grew) : n;
+  }
+  if (pool[n].key < key) {
+    std::uint32_t child = insertNode(right(n), key, grew);
+    setRight(n, child);
+    return grew ? growRight(n, grew) : n;
+  }
+  return n; // Duplicate keys not allowed
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::removeMinimum(std::uint32_t n,
+                                                 std::uint32_t &minimum,
+                                                 bool &shrank) {
+  if (left(n) == 0) {
+    minimum = n;
+    shrank = true;
+    return right(n);
+  }
+  setLeft(n, removeMinimum(left(n), minimum, shrank));
+  return shrank ? shrinkLeft(n, shrank) : n;
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactAVLTree<Key>::removeNode(std::uint32_t n, int key,
+                                              bool &shrank) {
+  if (n == 0)
+    return 0;
+
+  if (key < pool[n].key) {
+    setLeft(n, removeNode(left(n), key, shrank));
+    return shrank ? shrinkLeft(n, shrank) : n;
+  }
+  if (pool[n].key < key) {
+    setRight(n, removeNode(right(n), key, shrank));
+    return shrank ? shrinkRight(n, shrank) : n;
+  }
+
+  count--;
+  std::uint32_t l = left(n), r = right(n);
+  if (l == 0 || r == 0) {
+    pool.release(n);
+    shrank = true;
+    return l != 0 ? l : r;
+  }
+
+  // the successor node takes n's place and balance
+  std::uint32_t successor = 0;
+  r = removeMinimum(r, successor, shrank);
+  setLeft(successor, l);
+  setRight(successor, r);
+  setBalance(successor, balanceOf(n));
+  pool.release(n);
+  return shrank ? shrinkRight(successor, shrank) : successor;
+}
+
+template <KeyComparble Key>
+int CompactAVLTree<Key>::heightOf(std::uint32_t n) const {
+  // follow the taller side; balance factors make this O(log n)
+  int h = 0;
+  while (n != 0) {
+    ++h;
+    n = balanceOf(n) < 0 ? left(n) : right(n);
+  }
+  return h;
+}
+
+template <KeyComparble Key> void CompactAVLTree<Key>::insert(int key) {
+  ScopedLatency<> timer(counters, &TreeStats::insertLatency);
+  bool grew = false;
+  root = insertNode(root, key, grew);
+}
+
+template <KeyComparble Key>
+const Key *CompactAVLTree<Key>::search(int key) const {
+  ScopedLatency<> timer(counters, &TreeStats::searchLatency);
+  SearchPath<> path;
+  std::uint32_t n = root;
+  for (; n != 0; n = key < pool[n].key ? left(n) : right(n)) {
+    path.visit();
+    if (pool[n].key == key)
+      break;
+  }
+  recordSearch(counters, path.length());
+  return n != 0 ? &pool[n].key : nullptr;
+}
+
+template <KeyComparble Key> void CompactAVLTree<Key>::remove(int key) {
+  ScopedLatency<> timer(counters, &TreeStats::removeLatency);
+  bool shrank = false;
+  root = removeNode(root, key, shrank);
+}
+
+template <KeyComparble Key> const Key *CompactAVLTree<Key>::minimum() const {
+  if (root == 0)
+    return nullptr;
+  std::uint32_t n = root;
+  while (left(n) != 0)
+    n = left(n);
+  return &pool[n].key;
+}
+
+template <KeyComparble Key> const Key *CompactAVLTree<Key>::maximum() const {
+  if (root == 0)
+    return nullptr;
+  std::uint32_t n = root;
+  while (right(n) != 0)
+    n = right(n);
+  return &pool[n].key;
+}
+
+template <KeyComparble Key> int CompactAVLTree<Key>::size() const {
+  return count;
+}
+
+template <KeyComparble Key> int CompactAVLTree<Key>::height() const {
+  return heightOf(root);
+}
+
+template <KeyComparble Key>
+std::size_t CompactAVLTree<Key>::memoryUsage() const {
+  return pool.bytes();
+}
+
+template <KeyComparble Key> TreeStats CompactAVLTree<Key>::stats() const {
+  TreeStats result = statsOf(counters);
+  std::vector<std::pair<std::uint32_t, std::size_t>> stack;
+  if (root != 0)
+    stack.push_back({root, 0});
+  while (!stack.empty()) {
+    auto [n, depth] = stack.back();
+    stack.pop_back();
+    countNode(result, depth);
+    if (left(n) != 0)
+      stack.push_back({left(n), depth + 1});
+    if (right(n) != 0)
+      stack.push_back({right(n), depth + 1});
+  }
+  result.bytes = sizeof(*this) + pool.bytes();
+  return result;
+}
+
+} // namespace TREE
+
+namespace RBTREE {
+
+//-------------------------------------------------------------------------------
+//                          Compact Red-Black Trees
+//-------------------------------------------------------------------------------
+
+// Red-black tree over a CompactPool with the colour folded into the parent
+// link. Slot 0 doubles as the black NIL sentinel, so the fix-ups are the
+// textbook (CLRS) ones without null checks.
+template <KeyComparble Key> class CompactRedBlackTree {
+protected:
+  using NodeT = CompactRBTNode<Key>;
+  static constexpr std::uint32_t NIL = 0;
+
+  TREE::CompactPool<NodeT> pool{sentinel()};
+  std::uint32_t root{NIL};
+  int count{0};
+  [[no_unique_address]] mutable TREE::StatsCollector counters; // stats.hpp
+
+  static NodeT sentinel();
+
+  std::uint32_t left(std::uint32_t n) const { return pool[n].left; }
+  std::uint32_t right(std::uint32_t n) const { return pool[n].right; }
+  std::uint32_t parent(std::uint32_t n) const;
+  bool isRed(std::uint32_t n) const;
+  void setParent(std::uint32_t n, std::uint32_t p);
+  void setRed(std::uint32_t n, bool red);
+
+  void rotateLeft(std::uint32_t x);
+  void rotateRight(std::uint32_t x);
+  void transplant(std::uint32_t u, std::uint32_t v);
+  std::uint32_t minimumNode(std::uint32_t n) const;
+  std::uint32_t searchNode(int key, TREE::SearchPath<> &path) const;
+  void fixInsert(std::uint32_t z);
+  void fixDelete(std::uint32_t x);
+
+public:
+  CompactRedBlackTree() = default;
+  CompactRedBlackTree(std::initializer_list<int> list);
+
+  void insert(int key);
+  const Key *search(int key) const;
+  void remove(int key);
+  const Key *minimum() const;
+  const Key *maximum() const;
+
+  int size() const;
+  std::size_t memoryUsage() const; // bytes held by the node pool
+
+  // As CompactAVLTree::stats().
+  TREE::TreeStats stats() const;
+};
+
+//-------------------------------------------------------------------------------
+//                      CompactRedBlackTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key>
+CompactRBTNode<Key> CompactRedBlackTree<Key>::sentinel() {
+  NodeT nil(Key{});
+  nil.parent = NIL; // black
+  return nil;
+}
+
+template <KeyComparble Key>
+CompactRedBlackTree<Key>::CompactRedBlackTree(std::initializer_list<int> list) {
+  for (int key : list)
+    insert(key);
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactRedBlackTree<Key>::parent(std::uint32_t n) const {
+  return pool[n].parent & NodeT::INDEX_MASK;
+}
+
+template <KeyComparble Key>
+bool CompactRedBlackTree<Key>::isRed(std::uint32_t n) const {
+  return (pool[n].parent & NodeT::RED_BIT) != 0;
+}
+
+template <KeyComparble Key>
+void CompactRedBlackTree<Key>::setParent(std::uint32_t n, std::uint32_t p) {
+  pool[n].parent = (pool[n].parent & NodeT::RED_BIT) | p;
+}
+
+template <KeyComparble Key>
+void CompactRedBlackTree<Key>::setRed(std::uint32_t n, bool red) {
+  if (isRed(n) != red)
+    TREE::countStat(counters, &TREE::TreeStats::recolors);
+  pool[n].parent = parent(n) | (red ? NodeT::RED_BIT : 0);
+}
+
+template <KeyComparble Key>
+void CompactRedBlackTree<Key>::rotateLeft(std::uint32_t x) {
+  std::uint32_t y = right(x);
+  TREE::countStat(counters, &TREE::TreeStats::rotations);
+  pool[x].right = left(y);
+  if (left(y) != NIL)
+    setParent(left(y), x);
+  setParent(y, parent(x));
+  if (parent(x) == NIL)
+    root = y;
+  else if (x == left(parent(x)))
+    pool[parent(x)].left = y;
+  else
+    pool[parent(x)].right = y;
+  pool[y].left = x;
+  setParent(x, y);
+}
+
+template <KeyComparble Key>
+void CompactRedBlackTree<Key>::rotateRight(std::uint32_t x) {
+  std::uint32_t y = left(x);
+  TREE::countStat(counters, &TREE::TreeStats::rotations);
+  pool[x].left = right(y);
+  if (right(y) != NIL)
+    setParent(right(y), x);
+  setParent(y, parent(x));
+  if (parent(x) == NIL)
+    root = y;
+  else if (x == right(parent(x)))
+    pool[parent(x)].right = y;
+  else
+    pool[parent(x)].left = y;
+  pool[y].right = x;
+  setParent(x, y);
+}
+
+template <KeyComparble Key>
+void CompactRedBlackTree<Key>::transplant(std::uint32_t u, std::uint32_t v) {
+  if (parent(u) == NIL)
+    root = v;
+  else if (u == left(parent(u)))
+    pool[parent(u)].left = v;
+  else
+    pool[parent(u)].right = v;
+  setParent(v, parent(u)); // also on NIL, fixDelete starts from there
+}
+
+template <KeyComparble Key>
+std::uint32_t CompactRedBlackTree<Key>::minimumNode(std::uint32_t n) const {
+  while (left(n) != NIL)
+    n = left(n);
+  return n;
+}
+
+template <KeyComparble Key>
+std::uint32_t
+CompactRedBlackTree<Key>::searchNode(int key, TREE::SearchPath<> &path) const {
+  std::uint32_t n = root;
+  for (; n != NIL; n = key < pool[n].key ? left(n) : right(n)) {
+    path.visit();
+    if (pool[n].key == key)
+      break;
+  }
+  return n;
+}
+
+template <KeyComparble Key>
+void CompactRedBlackTree<Key>::fixInsert(std::uint32_t z) {
+  while (isRed(parent(z))) {
+    std::uint32_t p = parent(z);
+    std::uint32_t g = parent(p);
+    if (p == left(g)) {
+      std::uint32_t uncle = right(g);
+      if (isRed(uncle)) {
+        TREE::countFixup(counters, &TREE::TreeStats::insertFixups, 1);
+        setRed(p, false);
+        setRed(uncle, false);
+        setRed(g, true);
+        z = g;
+      } else {
+        if (z == right(p)) {
+          TREE::countFixup(counters, &TREE::TreeStats::insertFixups, 2);
+          TREE::countStat(counters, &TREE::TreeStats::rotationsLR);
+          z = p;
+          rotateLeft(z);
+        } else {
+          TREE::countStat(counters, &TREE::TreeStats::rotationsLL);
+        }
+        TREE::countFixup(counters, &TREE::TreeStats::insertFixups, 3);
+        setRed(parent(z), false);
+        setRed(parent(parent(z)), true);
+        rotateRight(parent(parent(z)));
+      }
+    } else {
+      std::uint32_t uncle = left(g);
+      if (isRed(uncle)) {
+        TREE::countFixup(counters, &TREE::TreeStats::insertFixups, 1);
+        setRed(p, false);
+        setRed(uncle, false);
+        setRed(g, true);
+        z = g;
+      } else {
+        if (z == left(p)) {
+          TREE::countFixup(counters, &TREE::TreeStats::insertFixups, 2);
+          TREE::countStat(counters, &TREE::TreeStats::rotationsRL);
+          z = p;
+          rotateRight(z);
+        } else {
+          TREE::countStat(counters, &TREE::TreeStats::rotationsRR);
+        }
+        TREE::countFixup(counters, &TREE::TreeStats::insertFixups, 3);
+        setRed(parent(z), false);
+        setRed(parent(parent(z)), true);
+        rotateLeft(parent(parent(z)));
+      }
+    }
+  }
+  setRed(root, false);
+}
+
+template <KeyComparble Key>
+void CompactRedBlackTree<Key>::fixDelete(std::uint32_t x) {
+  while (x != root && !isRed(x)) {
+    std::uint32_t p = parent(x);
+    if (x == left(p)) {
+      std::uint32_t w = right(p);
+      if (isRed(w)) {
+        TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 1);
+        setRed(w, false);
+        setRed(p, true);
+        rotateLeft(p);
+        w = right(p);
+      }
+      if (!isRed(left(w)) && !isRed(right(w))) {
+        TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 2);
+        setRed(w, true);
+        x = p;
+      } else {
+        if (!isRed(right(w))) {
+          TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 3);
+          setRed(left(w), false);
+          setRed(w, true);
+          rotateRight(w);
+          w = right(p);
+        }
+        TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 4);
+        setRed(w, isRed(p));
+        setRed(p, false);
+        setRed(right(w), false);
+        rotateLeft(p);
+        x = root;
+      }
+    } else {
+      std::uint32_t w = left(p);
+      if (isRed(w)) {
+        TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 1);
+        setRed(w, false);
+        setRed(p, true);
+        rotateRight(p);
+        w = left(p);
+      }
+      if (!isRed(left(w)) && !isRed(right(w))) {
+        TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 2);
+        setRed(w, true);
+        x = p;
+      } else {
+        if (!isRed(left(w))) {
+          TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 3);
+          setRed(right(w), false);
+          setRed(w, true);
+          rotateLeft(w);
+          w = left(p);
+        }
+        TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 4);
+        setRed(w, isRed(p));
+        setRed(p, false);
+        setRed(left(w), false);
+        rotateRight(p);
+        x = root;
+      }
+    }
+  }
+  setRed(x, false);
+}
+
+template <KeyComparble Key> void CompactRedBlackTree<Key>::insert(int key) {
+  TREE::ScopedLatency<> timer(counters, &TREE::TreeStats::insertLatency);
+  std::uint32_t y = NIL;
+  std::uint32_t x = root;
+  while (x != NIL) {
+    y = x;
+    if (key < pool[x].key)
+      x = left(x);
+    else if (pool[x].key < key)
+      x = right(x);
+    else
+      return; // Duplicate keys not allowed
+  }
+
+  std::uint32_t z = pool.allocate(key); // red, no children
+  setParent(z, y);
+  if (y == NIL)
+    root = z;
+  else if (key < pool[y].key)
+    pool[y].left = z;
+  else
+    pool[y].right = z;
+  count++;
+  fixInsert(z);
+}
+
+template <KeyComparble Key>
+const Key *CompactRedBlackTree<Key>::search(int key) const {
+  TREE::ScopedLatency<> timer(counters, &TREE::TreeStats::searchLatency);
+  TREE::SearchPath<> path;
+  std::uint32_t n = searchNode(key, path);
+  TREE::recordSearch(counters, path.length());
+  return n != NIL ? &pool[n].key : nullptr;
+}
+
+template <KeyComparble Key> void CompactRedBlackTree<Key>::remove(int key) {
+  TREE::ScopedLatency<> timer(counters, &TREE::TreeStats::removeLatency);
+  TREE::SearchPath<> uncounted;
+  std::uint32_t z = searchNode(key, uncounted);
+  if (z == NIL)
+    return;
+
+  std::uint32_t y = z;
+  bool removedBlack = !isRed(y);
+  std::uint32_t x;
+  if (left(z) == NIL) {
+    x = right(z);
+    transplant(z, right(z));
+  } else if (right(z) == NIL) {
+    x = left(z);
+    transplant(z, left(z));
+  } else {
+    y = minimumNode(right(z));
+    removedBlack = !isRed(y);
+    x = right(y);
+    if (parent(y) == z) {
+      setParent(x, y);
+    } else {
+      transplant(y, right(y));
+      pool[y].right = right(z);
+      setParent(right(y), y);
+    }
+    transplant(z, y);
+    pool[y].left = left(z);
+    setParent(left(y), y);
+    setRed(y, isRed(z));
+  }
+
+  pool.release(z);
+  count--;
+  if (removedBlack)
+    fixDelete(x);
+}
+
+template <KeyComparble Key>
+const Key *CompactRedBlackTree<Key>::minimum() const {
+  return root != NIL ? &pool[minimumNode(root)].key : nullptr;
+}
+
+template <KeyComparble Key>
+const Key *CompactRedBlackTree<Key>::maximum() const {
+  if (root == NIL)
+    return nullptr;
+  std::uint32_t n = root;
+  while (right(n) != NIL)
+    n = right(n);
+  return &pool[n].key;
+}
+
+template <KeyComparble Key> int CompactRedBlackTree<Key>::size() const {
+  return count;
+}
+
+template <KeyComparble Key>
+std::size_t CompactRedBlackTree<Key>::memoryUsage() const {
+  return pool.bytes();
+}
+
+template <KeyComparble Key>
+TREE::TreeStats CompactRedBlackTree<Key>::stats() const {
+  TREE::TreeStats result = TREE::statsOf(counters);
+  std::vector<std::pair<std::uint32_t, std::size_t>> stack;
+  if (root != NIL)
+    stack.push_back({root, 0});
+  while (!stack.empty()) {
+    auto [n, depth] = stack.back();
+    stack.pop_back();
+    TREE::countNode(result, depth);
+    if (left(n) != NIL)
+      stack.push_back({left(n), depth + 1});
+    if (right(n) != NIL)
+      stack.push_back({right(n), depth + 1});
+  }
+  result.bytes = sizeof(*this) + pool.bytes();
+  return result;
+}
+
+} // namespace RBTREE
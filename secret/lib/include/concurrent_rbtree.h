@@ -0,0 +1,214 @@
+#pragma once
+
+#include "epoch.hpp"
+#include "rbtree.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace RBTREE {
+
+//-------------------------------------------------------------------------------
+//                        Concurrent Red-Black Trees
+//-------------------------------------------------------------------------------
+
+// RBTNode for trees that readers walk without a lock: RedBlackTree writes
+// its links with release stores (a plain store on x86, stlr on AArch64),
+// which the readers pair with acquire loads. Ordinary trees keep RBTNode
+// and plain stores.
+template <KeyComparble Key> struct PublishedRBTNode {
+  using key_type = Key;
+  static constexpr bool PUBLISH_LINKS = true;
+
+  enum Color { RED, BLACK };
+
+  key_type key;
+  Color color{RED};
+  PublishedRBTNode *left{nullptr};
+  PublishedRBTNode *right{nullptr};
+  PublishedRBTNode *parent{nullptr};
+
+  explicit PublishedRBTNode(const key_type &k) noexcept : key(k) {}
+
+  PublishedRBTNode(const PublishedRBTNode &) = delete;
+  PublishedRBTNode &operator=(const PublishedRBTNode &) = delete;
+};
+
+// One writer at a time (serialised by a mutex) updates the tree in place with
+// the ordinary RedBlackTree algorithms; any number of readers search it
+// concurrently.
+//
+// Reads are a seqlock, not RCU: a reader reads an even sequence number,
+// descends through the release-published links without a lock, and retries
+// if the sequence moved while it was looking (a rotation may have hidden its
+// key for a moment). While writes do not overlap it a reader takes no lock
+// and writes no shared memory. Each retry backs off a little longer, and a
+// reader that fails OPTIMISTIC_READS times takes the writer mutex for one
+// locked walk, so back-to-back writes make readers wait their turn instead of
+// starving them; readers are therefore not lock-free. Every read runs inside
+// a PARALLEL::EpochGuard and removed nodes are retired rather than deleted,
+// so a reader never touches freed memory, even on a path that is about to
+// fail validation.
+template <KeyComparble Key>
+class ConcurrentRedBlackTree
+    : protected RedBlackTree<Key, PublishedRBTNode<Key>> {
+protected:
+  using Base = RedBlackTree<Key, PublishedRBTNode<Key>>;
+  using NodeT = PublishedRBTNode<Key>;
+
+  // a torn read can loop through a half-done rotation; no valid red-black
+  // tree with fewer than 2^64 nodes is deeper than this
+  static constexpr int MAX_DEPTH = 128;
+  // optimistic attempts before a reader falls back to the writer mutex
+  static constexpr int OPTIMISTIC_READS = 8;
+
+  mutable std::atomic<std::uint64_t> sequence{0};
+  mutable std::mutex writer;
+
+  static NodeT *loadLink(NodeT *const &link);
+  static void backOff(int attempt);
+  void beginWrite();
+  void endWrite();
+
+  // walk(complete) under the read protocol above; walk clears complete when
+  // it gave up on a path too deep to be real
+  template <typename Walk> auto read(Walk walk) const;
+
+public:
+  ConcurrentRedBlackTree() = default;
+
+  ConcurrentRedBlackTree(const ConcurrentRedBlackTree &) = delete;
+  ConcurrentRedBlackTree &operator=(const ConcurrentRedBlackTree &) = delete;
+
+  // Writers, serialised
+  void insert(int key);
+  void remove(int key);
+
+  // Readers, optimistic with a locked fallback
+  bool contains(int key) const;
+  std::optional<int> lowerBound(int key) const; // smallest key >= key
+};
+
+//-------------------------------------------------------------------------------
+//                    ConcurrentRedBlackTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key>
+PublishedRBTNode<Key> *
+ConcurrentRedBlackTree<Key>::loadLink(NodeT *const &link) {
+  return std::atomic_ref<NodeT *>(const_cast<NodeT *&>(link))
+      .load(std::memory_order_acquire);
+}
+
+template <KeyComparble Key>
+void ConcurrentRedBlackTree<Key>::backOff(int attempt) {
+  for (int spin = 0; spin < 1 << attempt; ++spin) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+  }
+}
+
+template <KeyComparble Key>
+template <typename Walk>
+auto ConcurrentRedBlackTree<Key>::read(Walk walk) const {
+  PARALLEL::EpochGuard guard;
+  for (int attempt = 0; attempt < OPTIMISTIC_READS; ++attempt) {
+    if (attempt > 0)
+      backOff(attempt);
+    std::uint64_t seq = sequence.load(std::memory_order_acquire);
+    if (seq & 1)
+      continue; // writer inside
+
+    bool complete = true;
+    auto result = walk(complete);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (complete && sequence.load(std::memory_order_relaxed) == seq)
+      return result;
+  }
+
+  // writes kept overlapping this reader: queue behind them instead
+  std::lock_guard<std::mutex> lock(writer);
+  bool complete = true;
+  return walk(complete);
+}
+
+template <KeyComparble Key> void ConcurrentRedBlackTree<Key>::beginWrite() {
+  // odd sequence: readers that started before will fail validation
+  sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+template <KeyComparble Key> void ConcurrentRedBlackTree<Key>::endWrite() {
+  sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+}
+
+template <KeyComparble Key>
+void ConcurrentRedBlackTree<Key>::insert(int key) {
+  std::lock_guard<std::mutex> lock(writer);
+  if (this->searchNode(this->root, key))
+    return; // nothing changes, do not disturb readers
+
+  beginWrite();
+  Base::insert(key);
+  endWrite();
+}
+
+template <KeyComparble Key>
+void ConcurrentRedBlackTree<Key>::remove(int key) {
+  std::lock_guard<std::mutex> lock(writer);
+  NodeT *node = this->searchNode(this->root, key);
+  if (node == nullptr)
+    return;
+
+  beginWrite();
+  this->unlinkNode(node);
+  endWrite();
+
+  // readers that saw the old links may still be standing on it
+  PARALLEL::retire(node);
+}
+
+template <KeyComparble Key>
+bool ConcurrentRedBlackTree<Key>::contains(int key) const {
+  return read([&](bool &complete) {
+    int depth = 0;
+    NodeT *node = loadLink(this->root);
+    while (node != nullptr && depth++ < MAX_DEPTH) {
+      if (node->key == key)
+        return true;
+      node = loadLink(key < node->key ? node->left : node->right);
+    }
+    complete = depth <= MAX_DEPTH;
+    return false;
+  });
+}
+
+template <KeyComparble Key>
+std::optional<int> ConcurrentRedBlackTree<Key>::lowerBound(int key) const {
+  return read([&](bool &complete) {
+    std::optional<int> best;
+    int depth = 0;
+    NodeT *node = loadLink(this->root);
+    while (node != nullptr && depth++ < MAX_DEPTH) {
+      if (node->key < key) {
+        node = loadLink(node->right);
+      } else {
+        best = node->key;
+        if (node->key == key)
+          break;
+        node = loadLink(node->left);
+      }
+    }
+    complete = depth <= MAX_DEPTH;
+    return best;
+  });
+}
+
+} // namespace RBTREE
@@ -0,0 +1,758 @@
+#pragma once
+
+#include "epoch.hpp"
+#include "node.hpp"
+#include "stats.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                           Concurrent AVL Trees
+//-------------------------------------------------------------------------------
+
+// A concurrent AVL tree after Bronson, Casper, Chafi and Olukotun, "A Practical
+// Concurrent Binary Search Tree" (PPoPP 2010). Any number of threads may
+// insert, remove and search at once:
+//  - every node has its own lock and a version number; a rotation marks the
+//    node it moves down as shrinking and bumps its version when done;
+//  - lookups take no locks. They descend hand over hand, re-reading the
+//    parent's version after loading each child, and retry one level up if
+//    the parent shrank in between;
+//  - updates search the same way and lock only the node(s) they change;
+//  - balance is relaxed: heights are repaired and rotations performed
+//    bottom-up after the change is visible, one locked step at a time, so
+//    the tree may be briefly out of AVL shape under contention but is a
+//    valid AVL tree again once the writers quiesce;
+//  - removing a key with two children only clears its present flag; the
+//    routing node is unlinked later, once it is down to one child.
+// Unlinked nodes are retired through PARALLEL::retire and every operation
+// runs inside a PARALLEL::EpochGuard.
+//
+// Lock order: a thread only ever locks a node while holding the lock of that
+// node's current parent (or nothing), and every change to a node's links or
+// to its parent pointer happens under the parent's lock, re-checked after
+// locking. Two threads can therefore only wait on each other along a
+// parent-to-child chain of the tree as it is at that moment, which has no
+// cycles. Only four functions take a second lock: attemptNodeUpdate and
+// fixHeightAndRebalance (parent, then node) and rebalanceToRight /
+// rebalanceToLeft (node's child, then grandchild, under parent and node).
+// ThreadSanitizer's deadlock detector orders mutexes by history instead:
+// once a rotation has turned a parent into its child's child, the next
+// parent-then-child locking of the pair looks like an inversion to it.
+// tsan.supp at the top of the repository suppresses deadlock reports from
+// exactly those four functions; anything else that nests locks is still
+// reported, and so are data races.
+template <KeyComparble Key> class ConcurrentAVLTree {
+protected:
+  using NodeT = ConcurrentAVLNode<Key>;
+
+  // NodeT::version: low bits are flags, the rest counts completed changes
+  static constexpr std::uint64_t UNLINKED = 1;
+  static constexpr std::uint64_t SHRINKING = 2;
+  static constexpr int SPIN_COUNT = 100;
+
+  // nodeCondition() returns one of these, or the height the node should have
+  static constexpr int UNLINK_REQUIRED = -1;
+  static constexpr int REBALANCE_REQUIRED = -2;
+  static constexpr int NOTHING_REQUIRED = -3;
+
+  // outcome of an optimistic attempt; PRESENT/ABSENT describe the key before
+  // the operation took effect
+  enum Result { ABSENT, PRESENT, RETRY };
+
+  // sentinel above the tree, the root is holder.right; never rotated
+  NodeT holder{Key{}, nullptr};
+  // shared by every thread, so only the *Shared hooks of stats.hpp touch it
+  [[no_unique_address]] StatsCollector counters;
+
+  static NodeT *child(NodeT *node, int dir);
+  static void setChild(NodeT *node, int dir, NodeT *c);
+  static int getHeight(NodeT *node);
+  static std::uint64_t beginChange(std::uint64_t version);
+  static std::uint64_t endChange(std::uint64_t version);
+  static bool isShrinkingOrUnlinked(std::uint64_t version);
+  static void waitUntilNotChanging(NodeT *node);
+
+  Result attemptGet(int key, NodeT *node, int dir, std::uint64_t nodeVersion,
+                    SearchPath<> &path);
+  Result update(int key, bool insert);
+  Result attemptUpdate(int key, bool insert, NodeT *parent, NodeT *node,
+                       std::uint64_t nodeVersion);
+  Result attemptNodeUpdate(bool insert, NodeT *parent, NodeT *node);
+  bool attemptUnlink(NodeT *parent, NodeT *node);
+
+  // Relaxed rebalancing. Apart from fixHeightAndRebalance, these expect the
+  // caller to hold the locks they document and return the next node that
+  // needs repair, or nullptr.
+  int nodeCondition(NodeT *node);
+  NodeT *fixHeight(NodeT *node);
+  void fixHeightAndRebalance(NodeT *node);
+  NodeT *balance(NodeT *parent, NodeT *node);
+  NodeT *rebalanceToRight(NodeT *parent, NodeT *node, NodeT *left,
+                          int rightHeight);
+  NodeT *rebalanceToLeft(NodeT *parent, NodeT *node, NodeT *right,
+                         int leftHeight);
+  NodeT *rotateRight(NodeT *parent, NodeT *node, NodeT *left, int rightHeight,
+                     int leftLeftHeight, NodeT *leftRight,
+                     int leftRightHeight);
+  NodeT *rotateLeft(NodeT *parent, NodeT *node, int leftHeight, NodeT *right,
+                    NodeT *rightLeft, int rightLeftHeight,
+                    int rightRightHeight);
+  NodeT *rotateRightOverLeft(NodeT *parent, NodeT *node, NodeT *left,
+                             int rightHeight, int leftLeftHeight,
+                             NodeT *leftRight, int leftRightLeftHeight);
+  NodeT *rotateLeftOverRight(NodeT *parent, NodeT *node, int leftHeight,
+                             NodeT *right, NodeT *rightLeft,
+                             int rightRightHeight, int rightLeftRightHeight);
+
+public:
+  ConcurrentAVLTree() = default;
+  ~ConcurrentAVLTree();
+
+  ConcurrentAVLTree(const ConcurrentAVLTree &) = delete;
+  ConcurrentAVLTree &operator=(const ConcurrentAVLTree &) = delete;
+
+  bool insert(int key);   // true if key was added
+  bool remove(int key);   // true if key was removed
+  bool contains(int key);
+  bool empty();
+  int height(); // exact once no update is in flight
+
+  // Counters when built with TREE_STATS, plus the shape, routing nodes
+  // included. The counters are exact, but every thread increments the same
+  // ones, so expect a collecting build to scale worse. Call it only while
+  // no other thread is using the tree.
+  TreeStats stats();
+};
+
+//-------------------------------------------------------------------------------
+//                       ConcurrentAVLTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key> ConcurrentAVLTree<Key>::~ConcurrentAVLTree() {
+  // no other thread may use the tree any more, free what is still linked;
+  // relaxed balance puts no useful bound on the depth, so the stack grows
+  std::vector<NodeT *> stack;
+  if (NodeT *root = holder.right.load(std::memory_order_relaxed))
+    stack.push_back(root);
+  while (!stack.empty()) {
+    NodeT *node = stack.back();
+    stack.pop_back();
+    if (NodeT *l = node->left.load(std::memory_order_relaxed))
+      stack.push_back(l);
+    if (NodeT *r = node->right.load(std::memory_order_relaxed))
+      stack.push_back(r);
+    delete node;
+  }
+}
+
+template <KeyComparble Key>
+ConcurrentAVLNode<Key> *ConcurrentAVLTree<Key>::child(NodeT *node, int dir) {
+  return (dir < 0 ? node->left : node->right).load(std::memory_order_acquire);
+}
+
+template <KeyComparble Key>
+void ConcurrentAVLTree<Key>::setChild(NodeT *node, int dir, NodeT *c) {
+  (dir < 0 ? node->left : node->right).store(c, std::memory_order_release);
+}
+
+template <KeyComparble Key>
+int ConcurrentAVLTree<Key>::getHeight(NodeT *node) {
+  return node ? node->height.load(std::memory_order_relaxed) : 0;
+}
+
+template <KeyComparble Key>
+std::uint64_t ConcurrentAVLTree<Key>::beginChange(std::uint64_t version) {
+  return version | SHRINKING;
+}
+
+template <KeyComparble Key>
+std::uint64_t ConcurrentAVLTree<Key>::endChange(std::uint64_t version) {
+  // clear the flags and count one more change
+  return (version | SHRINKING | UNLINKED) + 1;
+}
+
+template <KeyComparble Key>
+bool ConcurrentAVLTree<Key>::isShrinkingOrUnlinked(std::uint64_t version) {
+  return (version & (SHRINKING | UNLINKED)) != 0;
+}
+
+template <KeyComparble Key>
+void ConcurrentAVLTree<Key>::waitUntilNotChanging(NodeT *node) {
+  std::uint64_t version = node->version.load(std::memory_order_acquire);
+  if ((version & SHRINKING) == 0)
+    return;
+  for (int i = 0; i < SPIN_COUNT; ++i) {
+    if (node->version.load(std::memory_order_acquire) != version)
+      return;
+    std::this_thread::yield();
+  }
+  // the rotating thread holds the node's lock until the change is done
+  std::lock_guard<std::mutex> lock(node->lock);
+}
+
+template <KeyComparble Key>
+typename ConcurrentAVLTree<Key>::Result
+ConcurrentAVLTree<Key>::attemptGet(int key, NodeT *node, int dir,
+                                   std::uint64_t nodeVersion,
+                                   SearchPath<> &path) {
+  while (true) {
+    NodeT *c = child(node, dir);
+    if (node->version.load(std::memory_order_acquire) != nodeVersion)
+      return RETRY;
+    if (c == nullptr)
+      return ABSENT;
+    path.visit(); // retries count again
+    if (key == c->key)
+      return c->present.load(std::memory_order_acquire) ? PRESENT : ABSENT;
+
+    int nextDir = key < c->key ? -1 : 1;
+    std::uint64_t childVersion = c->version.load(std::memory_order_acquire);
+    if (childVersion & SHRINKING) {
+      waitUntilNotChanging(c);
+    } else if (childVersion != UNLINKED && c == child(node, dir)) {
+      // c was node's child while node had not shrunk, so the key is below c
+      if (node->version.load(std::memory_order_acquire) != nodeVersion)
+        return RETRY;
+      Result result = attemptGet(key, c, nextDir, childVersion, path);
+      if (result != RETRY)
+        return result;
+    }
+  }
+}
+
+template <KeyComparble Key>
+typename ConcurrentAVLTree<Key>::Result
+ConcurrentAVLTree<Key>::update(int key, bool insert) {
+  PARALLEL::EpochGuard guard;
+  while (true) {
+    NodeT *root = holder.right.load(std::memory_order_acquire);
+    if (root == nullptr) {
+      if (!insert)
+        return ABSENT;
+      std::lock_guard<std::mutex> lock(holder.lock);
+      if (holder.right.load(std::memory_order_relaxed) == nullptr) {
+        holder.right.store(new NodeT(key, &holder), std::memory_order_release);
+        return ABSENT;
+      }
+    } else {
+      std::uint64_t version = root->version.load(std::memory_order_acquire);
+      if (isShrinkingOrUnlinked(version)) {
+        waitUntilNotChanging(root);
+      } else if (root == holder.right.load(std::memory_order_acquire)) {
+        Result result = attemptUpdate(key, insert, &holder, root, version);
+        if (result != RETRY)
+          return result;
+      }
+    }
+  }
+}
+
+template <KeyComparble Key>
+typename ConcurrentAVLTree<Key>::Result
+ConcurrentAVLTree<Key>::attemptUpdate(int key, bool insert, NodeT *parent,
+                                      NodeT *node, std::uint64_t nodeVersion) {
+  if (key == node->key)
+    return attemptNodeUpdate(insert, parent, node);
+
+  int dir = key < node->key ? -1 : 1;
+  while (true) {
+    NodeT *c = child(node, dir);
+    if (node->version.load(std::memory_order_acquire) != nodeVersion)
+      return RETRY;
+
+    if (c == nullptr) {
+      if (!insert)
+        return ABSENT;
+      NodeT *damaged;
+      {
+        std::lock_guard<std::mutex> lock(node->lock);
+        if (node->version.load(std::memory_order_relaxed) != nodeVersion)
+          return RETRY;
+        if (child(node, dir) != nullptr)
+          continue; // lost the race for this slot, look again
+        setChild(node, dir, new NodeT(key, node));
+        damaged = fixHeight(node);
+      }
+      fixHeightAndRebalance(damaged);
+      return ABSENT;
+    }
+
+    std::uint64_t childVersion = c->version.load(std::memory_order_acquire);
+    if (isShrinkingOrUnlinked(childVersion)) {
+      waitUntilNotChanging(c);
+    } else if (c == child(node, dir)) {
+      if (node->version.load(std::memory_order_acquire) != nodeVersion)
+        return RETRY;
+      Result result = attemptUpdate(key, insert, node, c, childVersion);
+      if (result != RETRY)
+        return result;
+    }
+  }
+}
+
+template <KeyComparble Key>
+typename ConcurrentAVLTree<Key>::Result
+ConcurrentAVLTree<Key>::attemptNodeUpdate(bool insert, NodeT *parent,
+                                          NodeT *node) {
+  if (!insert) {
+    if (!node->present.load(std::memory_order_acquire))
+      return ABSENT;
+    if (child(node, -1) == nullptr || child(node, 1) == nullptr) {
+      // at most one child, the node itself can go
+      NodeT *damaged;
+      {
+        std::lock_guard<std::mutex> parentLock(parent->lock);
+        if ((parent->version.load(std::memory_order_relaxed) & UNLINKED) ||
+            node->parent.load(std::memory_order_relaxed) != parent)
+          return RETRY;
+        {
+          std::lock_guard<std::mutex> nodeLock(node->lock);
+          if (!node->present.load(std::memory_order_relaxed))
+            return ABSENT;
+          if (!attemptUnlink(parent, node))
+            return RETRY;
+        }
+        damaged = fixHeight(parent);
+      }
+      fixHeightAndRebalance(damaged);
+      return PRESENT;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(node->lock);
+  if (node->version.load(std::memory_order_relaxed) & UNLINKED)
+    return RETRY;
+  bool wasPresent = node->present.load(std::memory_order_relaxed);
+  if (!insert && wasPresent &&
+      (child(node, -1) == nullptr || child(node, 1) == nullptr))
+    return RETRY; // lost a child meanwhile, unlink it instead
+  node->present.store(insert, std::memory_order_release);
+  return wasPresent ? PRESENT : ABSENT;
+}
+
+template <KeyComparble Key>
+bool ConcurrentAVLTree<Key>::attemptUnlink(NodeT *parent, NodeT *node) {
+  // caller holds the locks of parent and node
+  NodeT *parentLeft = child(parent, -1);
+  NodeT *parentRight = child(parent, 1);
+  if (parentLeft != node && parentRight != node)
+    return false;
+
+  NodeT *left = child(node, -1);
+  NodeT *right = child(node, 1);
+  if (left != nullptr && right != nullptr)
+    return false;
+
+  NodeT *splice = left != nullptr ? left : right;
+  setChild(parent, parentLeft == node ? -1 : 1, splice);
+  if (splice != nullptr)
+    splice->parent.store(parent, std::memory_order_release);
+
+  node->version.store(UNLINKED, std::memory_order_release);
+  node->present.store(false, std::memory_order_release);
+  PARALLEL::retire(node);
+  return true;
+}
+
+template <KeyComparble Key>
+int ConcurrentAVLTree<Key>::nodeCondition(NodeT *node) {
+  NodeT *left = child(node, -1);
+  NodeT *right = child(node, 1);
+  if ((left == nullptr || right == nullptr) &&
+      !node->present.load(std::memory_order_acquire))
+    return UNLINK_REQUIRED;
+
+  int leftHeight = getHeight(left);
+  int rightHeight = getHeight(right);
+  if (AVLRules::unbalanced(leftHeight, rightHeight))
+    return REBALANCE_REQUIRED;
+
+  int repaired = AVLRules::height(leftHeight, rightHeight);
+  return getHeight(node) != repaired ? repaired : NOTHING_REQUIRED;
+}
+
+template <KeyComparble Key>
+ConcurrentAVLNode<Key> *ConcurrentAVLTree<Key>::fixHeight(NodeT *node) {
+  // caller holds node's lock
+  int condition = nodeCondition(node);
+  switch (condition) {
+  case REBALANCE_REQUIRED:
+  case UNLINK_REQUIRED:
+    return node;
+  case NOTHING_REQUIRED:
+    return nullptr;
+  default:
+    node->height.store(condition, std::memory_order_relaxed);
+    return node->parent.load(std::memory_order_acquire);
+  }
+}
+
+template <KeyComparble Key>
+void ConcurrentAVLTree<Key>::fixHeightAndRebalance(NodeT *node) {
+  // A rotation may report a node below it that still needs work; its parent
+  // is remembered here and revisited once that repair is done, because the
+  // rotation may have changed the parent's height too. Nothing is dropped:
+  // a parent left out here could keep a stale height for good.
+  std::vector<NodeT *> pending;
+
+  while (true) {
+    int condition = NOTHING_REQUIRED;
+    // the holder (no parent) stops the walk
+    if (node != nullptr &&
+        node->parent.load(std::memory_order_acquire) != nullptr &&
+        !(node->version.load(std::memory_order_acquire) & UNLINKED))
+      condition = nodeCondition(node);
+
+    if (condition == NOTHING_REQUIRED) {
+      if (pending.empty())
+        return;
+      node = pending.back();
+      pending.pop_back();
+    } else if (condition != UNLINK_REQUIRED &&
+               condition != REBALANCE_REQUIRED) {
+      std::lock_guard<std::mutex> lock(node->lock);
+      node = fixHeight(node);
+    } else {
+      NodeT *parent = node->parent.load(std::memory_order_acquire);
+      std::lock_guard<std::mutex> parentLock(parent->lock);
+      if (!(parent->version.load(std::memory_order_relaxed) & UNLINKED) &&
+          node->parent.load(std::memory_order_relaxed) == parent) {
+        std::lock_guard<std::mutex> nodeLock(node->lock);
+        NodeT *next = balance(parent, node);
+        if (next != nullptr && next != parent &&
+            next != parent->parent.load(std::memory_order_relaxed) &&
+            (pending.empty() || pending.back() != parent))
+          pending.push_back(parent);
+        node = next;
+      }
+    }
+  }
+}
+
+template <KeyComparble Key>
+ConcurrentAVLNode<Key> *ConcurrentAVLTree<Key>::balance(NodeT *parent,
+                                                        NodeT *node) {
+  // caller holds the locks of parent and node
+  NodeT *left = child(node, -1);
+  NodeT *right = child(node, 1);
+  if ((left == nullptr || right == nullptr) &&
+      !node->present.load(std::memory_order_relaxed)) {
+    if (attemptUnlink(parent, node))
+      return fixHeight(parent);
+    return node;
+  }
+
+  int leftHeight = getHeight(left);
+  int rightHeight = getHeight(right);
+  if (AVLRules::unbalanced(leftHeight, rightHeight)) {
+    if (leftHeight > rightHeight)
+      return rebalanceToRight(parent, node, left, rightHeight);
+    return rebalanceToLeft(parent, node, right, leftHeight);
+  }
+
+  int repaired = AVLRules::height(leftHeight, rightHeight);
+  if (repaired != getHeight(node)) {
+    node->height.store(repaired, std::memory_order_relaxed);
+    return fixHeight(parent);
+  }
+  return nullptr;
+}
+
+template <KeyComparble Key>
+ConcurrentAVLNode<Key> *
+ConcurrentAVLTree<Key>::rebalanceToRight(NodeT *parent, NodeT *node,
+                                         NodeT *left, int rightHeight) {
+  std::lock_guard<std::mutex> leftLock(left->lock);
+  if (getHeight(left) - rightHeight <= 1)
+    return node; // changed meanwhile, let the caller look again
+
+  NodeT *leftRight = child(left, 1);
+  int leftLeftHeight = getHeight(child(left, -1));
+  int leftRightHeight = getHeight(leftRight);
+  if (AVLRules::singleRotation(leftLeftHeight, leftRightHeight))
+    return rotateRight(parent, node, left, rightHeight, leftLeftHeight,
+                       leftRight, leftRightHeight);
+
+  {
+    std::lock_guard<std::mutex> leftRightLock(leftRight->lock);
+    leftRightHeight = getHeight(leftRight);
+    if (AVLRules::singleRotation(leftLeftHeight, leftRightHeight))
+      return rotateRight(parent, node, left, rightHeight, leftLeftHeight,
+                         leftRight, leftRightHeight);
+
+    int leftRightLeftHeight = getHeight(child(leftRight, -1));
+    if (!AVLRules::unbalanced(leftLeftHeight, leftRightLeftHeight))
+      return rotateRightOverLeft(parent, node, left, rightHeight,
+                                 leftLeftHeight, leftRight,
+                                 leftRightLeftHeight);
+  }
+  // the double rotation would leave left unbalanced, fix left first
+  return rebalanceToLeft(node, left, leftRight, leftLeftHeight);
+}
+
+template <KeyComparble Key>
+ConcurrentAVLNode<Key> *
+ConcurrentAVLTree<Key>::rebalanceToLeft(NodeT *parent, NodeT *node,
+                                        NodeT *right, int leftHeight) {
+  std::lock_guard<std::mutex> rightLock(right->lock);
+  if (leftHeight - getHeight(right) >= -1)
+    return node;
+
+  NodeT *rightLeft = child(right, -1);
+  int rightLeftHeight = getHeight(rightLeft);
+  int rightRightHeight = getHeight(child(right, 1));
+  if (AVLRules::singleRotation(rightRightHeight, rightLeftHeight))
+    return rotateLeft(parent, node, leftHeight, right, rightLeft,
+                      rightLeftHeight, rightRightHeight);
+
+  {
+    std::lock_guard<std::mutex> rightLeftLock(rightLeft->lock);
+    rightLeftHeight = getHeight(rightLeft);
+    if (AVLRules::singleRotation(rightRightHeight, rightLeftHeight))
+      return rotateLeft(parent, node, leftHeight, right, rightLeft,
+                        rightLeftHeight, rightRightHeight);
+
+    int rightLeftRightHeight = getHeight(child(rightLeft, 1));
+    if (!AVLRules::unbalanced(rightRightHeight, rightLeftRightHeight))
+      return rotateLeftOverRight(parent, node, leftHeight, right, rightLeft,
+                                 rightRightHeight, rightLeftRightHeight);
+  }
+  return rebalanceToRight(node, right, rightLeft, rightRightHeight);
+}
+
+template <KeyComparble Key>
+ConcurrentAVLNode<Key> *ConcurrentAVLTree<Key>::rotateRight(
+    NodeT *parent, NodeT *node, NodeT *left, int rightHeight,
+    int leftLeftHeight, NodeT *leftRight, int leftRightHeight) {
+  countStatShared(counters, &TreeStats::rotationsLL);
+  countStatShared(counters, &TreeStats::rotations);
+  std::uint64_t nodeVersion = node->version.load(std::memory_order_relaxed);
+  NodeT *parentLeft = child(parent, -1);
+
+  // node moves down: readers standing on it must wait or retry
+  node->version.store(beginChange(nodeVersion), std::memory_order_release);
+
+  setChild(node, -1, leftRight);
+  if (leftRight != nullptr)
+    leftRight->parent.store(node, std::memory_order_release);
+  setChild(left, 1, node);
+  node->parent.store(left, std::memory_order_release);
+  setChild(parent, parentLeft == node ? -1 : 1, left);
+  left->parent.store(parent, std::memory_order_release);
+
+  int nodeHeight = AVLRules::height(leftRightHeight, rightHeight);
+  node->height.store(nodeHeight, std::memory_order_relaxed);
+  left->height.store(AVLRules::height(leftLeftHeight, nodeHeight),
+                     std::memory_order_relaxed);
+
+  node->version.store(endChange(nodeVersion), std::memory_order_release);
+
+  // report whichever node still needs work, else continue with the parent
+  if (AVLRules::unbalanced(leftRightHeight, rightHeight))
+    return node;
+  if ((leftRight == nullptr || rightHeight == 0) &&
+      !node->present.load(std::memory_order_relaxed))
+    return node;
+  if (AVLRules::unbalanced(leftLeftHeight, nodeHeight))
+    return left;
+  if (leftLeftHeight == 0 && !left->present.load(std::memory_order_relaxed))
+    return left;
+  return fixHeight(parent);
+}
+
+template <KeyComparble Key>
+ConcurrentAVLNode<Key> *ConcurrentAVLTree<Key>::rotateLeft(
+    NodeT *parent, NodeT *node, int leftHeight, NodeT *right,
+    NodeT *rightLeft, int rightLeftHeight, int rightRightHeight) {
+  countStatShared(counters, &TreeStats::rotationsRR);
+  countStatShared(counters, &TreeStats::rotations);
+  std::uint64_t nodeVersion = node->version.load(std::memory_order_relaxed);
+  NodeT *parentLeft = child(parent, -1);
+
+  node->version.store(beginChange(nodeVersion), std::memory_order_release);
+
+  setChild(node, 1, rightLeft);
+  if (rightLeft != nullptr)
+    rightLeft->parent.store(node, std::memory_order_release);
+  setChild(right, -1, node);
+  node->parent.store(right, std::memory_order_release);
+  setChild(parent, parentLeft == node ? -1 : 1, right);
+  right->parent.store(parent, std::memory_order_release);
+
+  int nodeHeight = AVLRules::height(leftHeight, rightLeftHeight);
+  node->height.store(nodeHeight, std::memory_order_relaxed);
+  right->height.store(AVLRules::height(nodeHeight, rightRightHeight),
+                      std::memory_order_relaxed);
+
+  node->version.store(endChange(nodeVersion), std::memory_order_release);
+
+  if (AVLRules::unbalanced(leftHeight, rightLeftHeight))
+    return node;
+  if ((rightLeft == nullptr || leftHeight == 0) &&
+      !node->present.load(std::memory_order_relaxed))
+    return node;
+  if (AVLRules::unbalanced(nodeHeight, rightRightHeight))
+    return right;
+  if (rightRightHeight == 0 && !right->present.load(std::memory_order_relaxed))
+    return right;
+  return fixHeight(parent);
+}
+
+template <KeyComparble Key>
+ConcurrentAVLNode<Key> *ConcurrentAVLTree<Key>::rotateRightOverLeft(
+    NodeT *parent, NodeT *node, NodeT *left, int rightHeight,
+    int leftLeftHeight, NodeT *leftRight, int leftRightLeftHeight) {
+  countStatShared(counters, &TreeStats::rotationsLR);
+  countStatShared(counters, &TreeStats::rotations); // two rotations in one
+  countStatShared(counters, &TreeStats::rotations);
+  std::uint64_t nodeVersion = node->version.load(std::memory_order_relaxed);
+  std::uint64_t leftVersion = left->version.load(std::memory_order_relaxed);
+  NodeT *parentLeft = child(parent, -1);
+  NodeT *leftRightLeft = child(leftRight, -1);
+  NodeT *leftRightRight = child(leftRight, 1);
+  int leftRightRightHeight = getHeight(leftRightRight);
+
+  // node and left both move down, leftRight only gains height
+  node->version.store(beginChange(nodeVersion), std::memory_order_release);
+  left->version.store(beginChange(leftVersion), std::memory_order_release);
+
+  setChild(node, -1, leftRightRight);
+  if (leftRightRight != nullptr)
+    leftRightRight->parent.store(node, std::memory_order_release);
+  setChild(left, 1, leftRightLeft);
+  if (leftRightLeft != nullptr)
+    leftRightLeft->parent.store(left, std::memory_order_release);
+  setChild(leftRight, -1, left);
+  left->parent.store(leftRight, std::memory_order_release);
+  setChild(leftRight, 1, node);
+  node->parent.store(leftRight, std::memory_order_release);
+  setChild(parent, parentLeft == node ? -1 : 1, leftRight);
+  leftRight->parent.store(parent, std::memory_order_release);
+
+  int nodeHeight = AVLRules::height(leftRightRightHeight, rightHeight);
+  node->height.store(nodeHeight, std::memory_order_relaxed);
+  int leftHeight = AVLRules::height(leftLeftHeight, leftRightLeftHeight);
+  left->height.store(leftHeight, std::memory_order_relaxed);
+  leftRight->height.store(AVLRules::height(leftHeight, nodeHeight),
+                          std::memory_order_relaxed);
+
+  node->version.store(endChange(nodeVersion), std::memory_order_release);
+  left->version.store(endChange(leftVersion), std::memory_order_release);
+
+  if (AVLRules::unbalanced(leftRightRightHeight, rightHeight))
+    return node;
+  if ((leftRightRight == nullptr || rightHeight == 0) &&
+      !node->present.load(std::memory_order_relaxed))
+    return node;
+  if ((leftLeftHeight == 0 || leftRightLeft == nullptr) &&
+      !left->present.load(std::memory_order_relaxed))
+    return left; // routing node left with one child
+  if (AVLRules::unbalanced(leftHeight, nodeHeight))
+    return leftRight;
+  return fixHeight(parent);
+}
+
+template <KeyComparble Key>
+ConcurrentAVLNode<Key> *ConcurrentAVLTree<Key>::rotateLeftOverRight(
+    NodeT *parent, NodeT *node, int leftHeight, NodeT *right,
+    NodeT *rightLeft, int rightRightHeight, int rightLeftRightHeight) {
+  countStatShared(counters, &TreeStats::rotationsRL);
+  countStatShared(counters, &TreeStats::rotations); // two rotations in one
+  countStatShared(counters, &TreeStats::rotations);
+  std::uint64_t nodeVersion = node->version.load(std::memory_order_relaxed);
+  std::uint64_t rightVersion = right->version.load(std::memory_order_relaxed);
+  NodeT *parentLeft = child(parent, -1);
+  NodeT *rightLeftLeft = child(rightLeft, -1);
+  NodeT *rightLeftRight = child(rightLeft, 1);
+  int rightLeftLeftHeight = getHeight(rightLeftLeft);
+
+  node->version.store(beginChange(nodeVersion), std::memory_order_release);
+  right->version.store(beginChange(rightVersion), std::memory_order_release);
+
+  setChild(node, 1, rightLeftLeft);
+  if (rightLeftLeft != nullptr)
+    rightLeftLeft->parent.store(node, std::memory_order_release);
+  setChild(right, -1, rightLeftRight);
+  if (rightLeftRight != nullptr)
+    rightLeftRight->parent.store(right, std::memory_order_release);
+  setChild(rightLeft, 1, right);
+  right->parent.store(rightLeft, std::memory_order_release);
+  setChild(rightLeft, -1, node);
+  node->parent.store(rightLeft, std::memory_order_release);
+  setChild(parent, parentLeft == node ? -1 : 1, rightLeft);
+  rightLeft->parent.store(parent, std::memory_order_release);
+
+  int nodeHeight = AVLRules::height(leftHeight, rightLeftLeftHeight);
+  node->height.store(nodeHeight, std::memory_order_relaxed);
+  int rightHeight = AVLRules::height(rightLeftRightHeight, rightRightHeight);
+  right->height.store(rightHeight, std::memory_order_relaxed);
+  rightLeft->height.store(AVLRules::height(nodeHeight, rightHeight),
+                          std::memory_order_relaxed);
+
+  node->version.store(endChange(nodeVersion), std::memory_order_release);
+  right->version.store(endChange(rightVersion), std::memory_order_release);
+
+  if (AVLRules::unbalanced(leftHeight, rightLeftLeftHeight))
+    return node;
+  if ((rightLeftLeft == nullptr || leftHeight == 0) &&
+      !node->present.load(std::memory_order_relaxed))
+    return node;
+  if ((rightRightHeight == 0 || rightLeftRight == nullptr) &&
+      !right->present.load(std::memory_order_relaxed))
+    return right;
+  if (AVLRules::unbalanced(nodeHeight, rightHeight))
+    return rightLeft;
+  return fixHeight(parent);
+}
+
+template <KeyComparble Key> bool ConcurrentAVLTree<Key>::insert(int key) {
+  ScopedLatency<STATS_ENABLED, true> timer(counters,
+                                           &TreeStats::insertLatency);
+  return update(key, true) == ABSENT;
+}
+
+template <KeyComparble Key> bool ConcurrentAVLTree<Key>::remove(int key) {
+  ScopedLatency<STATS_ENABLED, true> timer(counters,
+                                           &TreeStats::removeLatency);
+  return update(key, false) == PRESENT;
+}
+
+template <KeyComparble Key> bool ConcurrentAVLTree<Key>::contains(int key) {
+  ScopedLatency<STATS_ENABLED, true> timer(counters,
+                                           &TreeStats::searchLatency);
+  PARALLEL::EpochGuard guard;
+  SearchPath<> path;
+  while (true) {
+    // the holder never shrinks, so version 0 is always valid for it
+    Result result = attemptGet(key, &holder, 1, 0, path);
+    if (result != RETRY) {
+      recordSearchShared(counters, path.length());
+      return result == PRESENT;
+    }
+  }
+}
+
+template <KeyComparble Key> bool ConcurrentAVLTree<Key>::empty() {
+  PARALLEL::EpochGuard guard;
+  return holder.right.load(std::memory_order_acquire) == nullptr;
+}
+
+template <KeyComparble Key> int ConcurrentAVLTree<Key>::height() {
+  PARALLEL::EpochGuard guard;
+  return getHeight(holder.right.load(std::memory_order_acquire));
+}
+
+template <KeyComparble Key> TreeStats ConcurrentAVLTree<Key>::stats() {
+  TreeStats result = statsOf(counters);
+  collectShape(holder.right.load(std::memory_order_acquire), sizeof(*this),
+               result);
+  return result;
+}
+
+} // namespace TREE
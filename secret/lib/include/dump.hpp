@@ -0,0 +1,261 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                                Tree Dumps
+//-------------------------------------------------------------------------------
+
+// Buffered sink for tree dumps: either a POSIX file descriptor (written
+// with write(2), never closed here) or a std::ostream. Output collects in
+// one buffer of capacity bytes and goes out when it fills, on flush() and
+// on destruction, so a dump of n nodes costs O(n / capacity) system calls
+// instead of one flush per line.
+class TreeWriter {
+  std::vector<char> buffer;
+  std::size_t used{0};
+  int fd{-1};
+  std::ostream *stream{nullptr};
+  bool failed{false};
+
+  void drain();
+
+public:
+  static constexpr std::size_t DEFAULT_CAPACITY = 1 << 16;
+
+  explicit TreeWriter(int fd, std::size_t capacity = DEFAULT_CAPACITY);
+  explicit TreeWriter(std::ostream &stream,
+                      std::size_t capacity = DEFAULT_CAPACITY);
+  ~TreeWriter();
+
+  TreeWriter(const TreeWriter &) = delete;
+  TreeWriter &operator=(const TreeWriter &) = delete;
+
+  void put(char c) {
+    if (used == buffer.size())
+      drain();
+    buffer[used++] = c;
+  }
+  void write(std::string_view text);
+  void quoted(std::string_view text); // "text", JSON / DOT escaped
+
+  // Integers go through std::to_chars, anything else through operator<<.
+  template <typename T> void value(const T &v);
+
+  bool flush(); // false if any write so far has failed
+  bool good() const { return !failed; }
+};
+
+// The layout printTree has always used: one key per line, "T-" before a
+// left child and "L-" before a right child (or the root), each level
+// indented by four columns. Iterative, and the indentation lives in one
+// string that grows and shrinks with the depth, so a degenerate tree of a
+// million nodes neither overflows the stack nor copies its prefix per line.
+template <typename NodeT>
+void renderTree(TreeWriter &out, const NodeT *root,
+                std::string_view prefix = {}, bool isLeft = false);
+
+// Graphviz digraph, nodes numbered in preorder. Children keep their side:
+// edges leave a node left first under ordering=out, and a lone child gets
+// an invisible sibling. Nodes with a colour are filled red or black.
+template <typename NodeT> void writeDot(TreeWriter &out, const NodeT *root);
+
+// Nested objects {"key": k, "color": "red"|"black", "left": ..., "right": ...}
+// with null for a missing child; colour only for nodes that have one.
+// Arithmetic keys are written as numbers, any other key as a string.
+template <typename NodeT> void writeJson(TreeWriter &out, const NodeT *root);
+
+//-------------------------------------------------------------------------------
+//                            Tree Dump Implementation
+//-------------------------------------------------------------------------------
+
+template <typename T> void TreeWriter::value(const T &v) {
+  if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+                !std::is_same_v<T, char>) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), v);
+    write(std::string_view(digits, result.ptr - digits));
+  } else {
+    std::ostringstream text;
+    text << v;
+    write(text.view());
+  }
+}
+
+namespace dump_detail {
+
+template <typename NodeT> constexpr bool hasColor() {
+  return requires(const NodeT &node) { node.color == NodeT::RED; };
+}
+
+template <typename NodeT> const char *colorName(const NodeT &node) {
+  return node.color == NodeT::RED ? "red" : "black";
+}
+
+template <typename Key> void jsonKey(TreeWriter &out, const Key &key) {
+  if constexpr (std::is_floating_point_v<Key>) {
+    if (!std::isfinite(key)) { // JSON has no literal for these
+      std::ostringstream text;
+      text << key;
+      out.quoted(text.view());
+      return;
+    }
+  }
+  if constexpr (std::is_arithmetic_v<Key> && !std::is_same_v<Key, bool> &&
+                !std::is_same_v<Key, char>) {
+    out.value(key);
+  } else {
+    std::ostringstream text;
+    text << key;
+    out.quoted(text.view());
+  }
+}
+
+} // namespace dump_detail
+
+template <typename NodeT>
+void renderTree(TreeWriter &out, const NodeT *root, std::string_view prefix,
+                bool isLeft) {
+  struct Pending {
+    const NodeT *node;
+    std::size_t indent; // length of the node's prefix
+    bool isLeft;
+  };
+  std::string indent(prefix);
+  std::vector<Pending> stack;
+  if (root != nullptr)
+    stack.push_back({root, indent.size(), isLeft});
+  while (!stack.empty()) {
+    Pending next = stack.back();
+    stack.pop_back();
+    // preorder: the columns before next.indent still belong to its parent
+    indent.resize(next.indent);
+    out.write(indent);
+    out.write(next.isLeft ? "T-" : "L-");
+    out.value(next.node->key);
+    out.put('\n');
+
+    indent.append(next.isLeft ? "|   " : "    ");
+    if (next.node->right != nullptr)
+      stack.push_back({next.node->right, indent.size(), false});
+    if (next.node->left != nullptr)
+      stack.push_back({next.node->left, indent.size(), true});
+  }
+}
+
+template <typename NodeT> void writeDot(TreeWriter &out, const NodeT *root) {
+  struct Pending {
+    const NodeT *node;
+    std::size_t id;
+  };
+  auto name = [&](std::size_t id) {
+    out.put('n');
+    out.value(id);
+  };
+
+  out.write("digraph tree {\n  graph [ordering=out];\n"
+            "  node [shape=circle];\n");
+  std::size_t ids = 0;
+  std::vector<Pending> stack;
+  if (root != nullptr)
+    stack.push_back({root, ids++});
+  while (!stack.empty()) {
+    Pending next = stack.back();
+    stack.pop_back();
+
+    out.write("  ");
+    name(next.id);
+    out.write(" [label=");
+    std::ostringstream label;
+    label << next.node->key;
+    out.quoted(label.view());
+    if constexpr (dump_detail::hasColor<NodeT>()) {
+      out.write(", style=filled, fontcolor=white, fillcolor=");
+      out.write(dump_detail::colorName(*next.node));
+    }
+    out.write("];\n");
+
+    // edges are written here, left first, so their order is the child order
+    const NodeT *children[2] = {next.node->left, next.node->right};
+    if (children[0] == nullptr && children[1] == nullptr)
+      continue;
+    std::size_t childIds[2];
+    for (int side = 0; side < 2; ++side) {
+      childIds[side] = ids++;
+      out.write("  ");
+      name(childIds[side]);
+      if (children[side] == nullptr) {
+        out.write(" [shape=point, style=invis];\n  ");
+        name(next.id);
+        out.write(" -> ");
+        name(childIds[side]);
+        out.write(" [style=invis];\n");
+      } else {
+        out.write(";\n  ");
+        name(next.id);
+        out.write(" -> ");
+        name(childIds[side]);
+        out.write(";\n");
+      }
+    }
+    if (children[1] != nullptr)
+      stack.push_back({children[1], childIds[1]});
+    if (children[0] != nullptr)
+      stack.push_back({children[0], childIds[0]});
+  }
+  out.write("}\n");
+}
+
+template <typename NodeT> void writeJson(TreeWriter &out, const NodeT *root) {
+  struct Open {
+    const NodeT *node;
+    int written; // children written so far
+  };
+  std::vector<Open> stack;
+  auto open = [&](const NodeT *node) {
+    if (node == nullptr) {
+      out.write("null");
+      return;
+    }
+    out.write("{\"key\":");
+    dump_detail::jsonKey(out, node->key);
+    if constexpr (dump_detail::hasColor<NodeT>()) {
+      out.write(",\"color\":\"");
+      out.write(dump_detail::colorName(*node));
+      out.put('"');
+    }
+    stack.push_back({node, 0});
+  };
+
+  open(root);
+  while (!stack.empty()) {
+    Open &top = stack.back();
+    const NodeT *node = top.node;
+    switch (top.written++) {
+    case 0:
+      out.write(",\"left\":");
+      open(node->left); // may reallocate the stack, top is dead after this
+      break;
+    case 1:
+      out.write(",\"right\":");
+      open(node->right);
+      break;
+    default:
+      out.put('}');
+      stack.pop_back();
+    }
+  }
+  out.put('\n');
+}
+
+} // namespace TREE
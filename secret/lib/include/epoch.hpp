@@ -0,0 +1,32 @@
+#pragma once
+
+namespace PARALLEL {
+
+//-------------------------------------------------------------------------------
+//                         Epoch-Based Reclamation
+//-------------------------------------------------------------------------------
+
+// Readers wrap every lock-free traversal in an EpochGuard. Writers unlink an
+// object first and then retire() it; it is deleted only once every thread
+// that could still hold a pointer to it has left its guard. Guards nest and
+// cost one store plus a fence; there is a single process-wide domain.
+class EpochGuard {
+public:
+  EpochGuard();
+  ~EpochGuard();
+
+  EpochGuard(const EpochGuard &) = delete;
+  EpochGuard &operator=(const EpochGuard &) = delete;
+};
+
+void retire(void *object, void (*deleter)(void *));
+
+template <typename T> void retire(T *object) {
+  retire(object, [](void *p) { delete static_cast<T *>(p); });
+}
+
+// Advance the epoch if possible and free whatever became unreachable.
+// retire() calls this periodically; call it directly to flush eagerly.
+void reclaim();
+
+} // namespace PARALLEL
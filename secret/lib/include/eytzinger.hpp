@@ -0,0 +1,181 @@
+#pragma once
+
+#include "batch.hpp"
+#include "node.hpp"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                          Eytzinger Search Index
+//-------------------------------------------------------------------------------
+
+// Immutable sorted set in Eytzinger (BFS) order: the children of slot k are
+// 2k and 2k + 1, so the first levels of every search share a few cache lines
+// and the descent needs no pointers. Each step is a branch-free
+// k = 2k + (key at k < x), and the line holding the descendants four levels
+// down is prefetched while the current level is compared. Build one with
+// AVLTree::freeze() or RedBlackTree::freeze(); later changes to the tree are
+// not reflected.
+template <KeyComparble Key> class EytzingerIndex {
+  // keys per 64-byte line; slot k * PREFETCH_STRIDE starts the line with
+  // k's descendants log2(PREFETCH_STRIDE) levels down
+  static constexpr std::size_t PREFETCH_STRIDE =
+      sizeof(Key) < 64 ? 64 / sizeof(Key) : 1;
+  // lookups interleaved by the batch calls, the same as searchBatch()
+  static constexpr std::size_t BATCH = SEARCH_BATCH;
+
+  std::vector<Key> storage;
+  std::size_t offset{0}; // slot 0 of the 1-based layout, line aligned
+  int count{0};
+
+  const Key *slots() const { return storage.data() + offset; }
+  template <std::forward_iterator It> void fill(It &it, int k);
+  static void prefetch(const Key *address);
+  std::size_t descend(int key) const;
+
+public:
+  EytzingerIndex() = default;
+
+  // [first, last) must be sorted without duplicates
+  template <std::forward_iterator It> EytzingerIndex(It first, It last);
+
+  int size() const;
+  bool empty() const;
+
+  bool contains(int key) const;
+  const Key *lowerBound(int key) const; // smallest key >= key, or nullptr
+
+  // Same answers as contains/lowerBound for every element of keys, with up
+  // to BATCH descents in flight at once so their cache misses overlap.
+  void containsBatch(std::span<const int> keys, std::span<bool> found) const;
+  void lowerBoundBatch(std::span<const int> keys,
+                       std::span<const Key *> result) const;
+};
+
+//-------------------------------------------------------------------------------
+//                        EytzingerIndex Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key>
+template <std::forward_iterator It>
+EytzingerIndex<Key>::EytzingerIndex(It first, It last)
+    : count(static_cast<int>(std::distance(first, last))) {
+  // one spare line so slot 0 can start on a 64-byte boundary
+  storage.resize(count + 1 + PREFETCH_STRIDE);
+  auto address = reinterpret_cast<std::uintptr_t>(storage.data());
+  if (64 % sizeof(Key) == 0)
+    offset = (64 - address % 64) % 64 / sizeof(Key);
+  fill(first, 1);
+}
+
+template <KeyComparble Key>
+template <std::forward_iterator It>
+void EytzingerIndex<Key>::fill(It &it, int k) {
+  // in-order walk of the implicit tree hands out the sorted keys; depth is
+  // log2(count), so the recursion stays shallow
+  if (k <= count) {
+    fill(it, 2 * k);
+    storage[offset + k] = *it++;
+    fill(it, 2 * k + 1);
+  }
+}
+
+template <KeyComparble Key>
+void EytzingerIndex<Key>::prefetch(const Key *address) {
+#if defined(__GNUC__)
+  __builtin_prefetch(address);
+#else
+  (void)address;
+#endif
+}
+
+template <KeyComparble Key>
+std::size_t EytzingerIndex<Key>::descend(int key) const {
+  const Key *b = slots();
+  std::size_t n = count;
+  std::size_t k = 1;
+  while (k <= n) {
+    // the descendants' line exists only while it is inside the index; past
+    // that even forming the address would be undefined
+    if (k * PREFETCH_STRIDE <= n)
+      prefetch(b + k * PREFETCH_STRIDE);
+    k = 2 * k + (b[k] < key);
+  }
+  // drop the trailing right turns and the left turn before them; what is
+  // left is the last node where we went left, i.e. the lower bound
+  return k >> (std::countr_one(k) + 1);
+}
+
+template <KeyComparble Key> int EytzingerIndex<Key>::size() const {
+  return count;
+}
+
+template <KeyComparble Key> bool EytzingerIndex<Key>::empty() const {
+  return count == 0;
+}
+
+template <KeyComparble Key>
+bool EytzingerIndex<Key>::contains(int key) const {
+  std::size_t k = descend(key);
+  return k != 0 && slots()[k] == key;
+}
+
+template <KeyComparble Key>
+const Key *EytzingerIndex<Key>::lowerBound(int key) const {
+  std::size_t k = descend(key);
+  return k != 0 ? slots() + k : nullptr;
+}
+
+template <KeyComparble Key>
+void EytzingerIndex<Key>::lowerBoundBatch(std::span<const int> keys,
+                                          std::span<const Key *> result) const {
+  const Key *b = slots();
+  std::size_t n = count;
+  int levels = std::bit_width(n); // enough steps for the deepest leaf
+
+  for (std::size_t base = 0; base < keys.size(); base += BATCH) {
+    std::size_t group =
+        keys.size() - base < BATCH ? keys.size() - base : BATCH;
+    std::size_t k[BATCH];
+    for (std::size_t j = 0; j < group; ++j)
+      k[j] = 1;
+
+    // one level of every lookup before the next level of any, so up to
+    // BATCH misses are outstanding together
+    for (int level = 0; level < levels; ++level) {
+      for (std::size_t j = 0; j < group; ++j) {
+        if (k[j] <= n) {
+          if (k[j] * PREFETCH_STRIDE <= n)
+            prefetch(b + k[j] * PREFETCH_STRIDE);
+          k[j] = 2 * k[j] + (b[k[j]] < keys[base + j]);
+        }
+      }
+    }
+
+    for (std::size_t j = 0; j < group; ++j) {
+      std::size_t found = k[j] >> (std::countr_one(k[j]) + 1);
+      result[base + j] = found != 0 ? b + found : nullptr;
+    }
+  }
+}
+
+template <KeyComparble Key>
+void EytzingerIndex<Key>::containsBatch(std::span<const int> keys,
+                                        std::span<bool> found) const {
+  const Key *bounds[BATCH];
+  for (std::size_t base = 0; base < keys.size(); base += BATCH) {
+    std::size_t group =
+        keys.size() - base < BATCH ? keys.size() - base : BATCH;
+    lowerBoundBatch(keys.subspan(base, group), std::span(bounds, group));
+    for (std::size_t j = 0; j < group; ++j)
+      found[base + j] = bounds[j] != nullptr && *bounds[j] == keys[base + j];
+  }
+}
+
+} // namespace TREE
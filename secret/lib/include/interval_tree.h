@@ -0,0 +1,171 @@
+#pragma once
+
+#include "node.hpp"
+#include "rbtree.h"
+#include <initializer_list>
+#include <utility>
+
+namespace RBTREE {
+
+//-------------------------------------------------------------------------------
+//                              Interval Trees
+//-------------------------------------------------------------------------------
+
+// Closed intervals [low, high] in a red-black tree, one interval per node,
+// ordered by (low, high). Each node also keeps the largest high end of its
+// subtree (IntervalNode), which RedBlackTree refreshes on the insert path, in
+// rotations and in the fix-up after a removal. The same interval may be
+// stored more than once; every copy gets its own node.
+//
+// Queries stream their results to a visitor, visit(low, high), in order of
+// low end; nothing is allocated. A subtree is entered only if its maxHigh
+// reaches the query, so a query costs O(log n) plus the paths down to the
+// k reported intervals: O(log n + k) when they are clustered, O(k log n) at
+// worst.
+template <KeyComparble Key>
+class IntervalTree : protected RedBlackTree<Key, IntervalNode<Key>> {
+protected:
+  using Base = RedBlackTree<Key, IntervalNode<Key>>;
+  using NodeT = IntervalNode<Key>;
+
+  int count{0};
+
+  NodeT *find(int low, int high) const;
+
+  template <typename F>
+  static void visitOverlaps(const NodeT *node, int lo, int hi, F &visit);
+
+public:
+  IntervalTree() = default;
+  IntervalTree(std::initializer_list<std::pair<int, int>> list);
+
+  // Intervals with high < low are ignored.
+  void insert(int low, int high);
+  bool remove(int low, int high); // one copy; false if not stored
+  bool contains(int low, int high) const;
+
+  // Every stored interval meeting [lo, hi] / containing point.
+  template <typename F> void overlapping(int lo, int hi, F visit) const;
+  template <typename F> void stabbing(int point, F visit) const;
+  bool overlapsAny(int lo, int hi) const; // O(log n)
+
+  int size() const;
+  bool empty() const;
+  void clear() override;
+};
+
+//-------------------------------------------------------------------------------
+//                         IntervalTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key>
+IntervalTree<Key>::IntervalTree(
+    std::initializer_list<std::pair<int, int>> list) {
+  for (const auto &[low, high] : list)
+    insert(low, high);
+}
+
+template <KeyComparble Key>
+void IntervalTree<Key>::insert(int low, int high) {
+  if (high < low)
+    return;
+
+  // one descent; a copy of a stored interval goes to its right
+  NodeT *parent = nullptr;
+  bool asLeft = false;
+  for (NodeT *node = this->root; node != nullptr;) {
+    parent = node;
+    asLeft = low < node->key || (low == node->key && high < node->high);
+    node = asLeft ? node->left : node->right;
+  }
+  this->attachNode(parent, asLeft, new NodeT(low, high));
+  ++count;
+}
+
+template <KeyComparble Key>
+IntervalNode<Key> *IntervalTree<Key>::find(int low, int high) const {
+  NodeT *node = this->root;
+  while (node != nullptr && (node->key != low || node->high != high)) {
+    if (low < node->key || (low == node->key && high < node->high))
+      node = node->left;
+    else
+      node = node->right;
+  }
+  return node;
+}
+
+template <KeyComparble Key>
+bool IntervalTree<Key>::remove(int low, int high) {
+  NodeT *node = find(low, high);
+  if (node == nullptr)
+    return false;
+
+  this->deleteNode(this->root, node);
+  --count;
+  return true;
+}
+
+template <KeyComparble Key>
+bool IntervalTree<Key>::contains(int low, int high) const {
+  return find(low, high) != nullptr;
+}
+
+template <KeyComparble Key>
+template <typename F>
+void IntervalTree<Key>::visitOverlaps(const NodeT *node, int lo, int hi,
+                                      F &visit) {
+  // in-order, so results come out sorted by low end
+  while (node != nullptr && !(node->maxHigh < lo)) {
+    visitOverlaps(node->left, lo, hi, visit);
+    if (hi < node->key)
+      return; // this node and everything to its right start too late
+    if (!(node->high < lo))
+      visit(node->key, node->high);
+    node = node->right;
+  }
+}
+
+template <KeyComparble Key>
+template <typename F>
+void IntervalTree<Key>::overlapping(int lo, int hi, F visit) const {
+  if (hi < lo)
+    return;
+  visitOverlaps(this->root, lo, hi, visit);
+}
+
+template <KeyComparble Key>
+template <typename F>
+void IntervalTree<Key>::stabbing(int point, F visit) const {
+  visitOverlaps(this->root, point, point, visit);
+}
+
+template <KeyComparble Key>
+bool IntervalTree<Key>::overlapsAny(int lo, int hi) const {
+  // CLRS interval search: if the left subtree reaches lo at all, either it
+  // holds an overlap or nothing to the right can start before hi
+  const NodeT *node = this->root;
+  while (node != nullptr && !(hi < lo)) {
+    if (!(hi < node->key) && !(node->high < lo))
+      return true;
+    if (node->left != nullptr && !(node->left->maxHigh < lo))
+      node = node->left;
+    else
+      node = node->right;
+  }
+  return false;
+}
+
+template <KeyComparble Key> int IntervalTree<Key>::size() const {
+  return count;
+}
+
+template <KeyComparble Key> bool IntervalTree<Key>::empty() const {
+  return count == 0;
+}
+
+template <KeyComparble Key> void IntervalTree<Key>::clear() {
+  Base::clear();
+  count = 0;
+}
+
+} // namespace RBTREE
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <limits>
+#include <type_traits>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                              Key Monoids
+//-------------------------------------------------------------------------------
+
+// A monoid summarising a run of keys: of(key) for a single key, combine()
+// associative with identity() as its neutral element. combine() need not be
+// commutative; summaries are always combined in key order.
+template <typename M, typename Key>
+concept KeyMonoid = requires(const Key &key, const typename M::value_type &a,
+                             const typename M::value_type &b) {
+  { M::identity() } -> std::convertible_to<typename M::value_type>;
+  { M::of(key) } -> std::convertible_to<typename M::value_type>;
+  { M::combine(a, b) } -> std::convertible_to<typename M::value_type>;
+};
+
+// Nodes of a monoid-augmented tree, see AggregateBSTNode/AggregateRBTNode.
+template <typename NodeT>
+concept AggregateNode = requires(const NodeT &node) {
+  typename NodeT::monoid_type;
+  node.summary;
+};
+
+// Sum of the keys; integral keys add up in a 64-bit integer.
+template <typename Key> struct SumMonoid {
+  using value_type =
+      std::conditional_t<std::is_integral_v<Key>, long long, Key>;
+  static value_type identity() { return value_type{}; }
+  static value_type of(const Key &key) { return value_type(key); }
+  static value_type combine(const value_type &a, const value_type &b) {
+    return a + b;
+  }
+};
+
+// Smallest / largest key; an empty range gives the numeric limit.
+template <typename Key> struct MinMonoid {
+  using value_type = Key;
+  static value_type identity() { return std::numeric_limits<Key>::max(); }
+  static value_type of(const Key &key) { return key; }
+  static value_type combine(const value_type &a, const value_type &b) {
+    return std::min(a, b);
+  }
+};
+
+template <typename Key> struct MaxMonoid {
+  using value_type = Key;
+  static value_type identity() { return std::numeric_limits<Key>::lowest(); }
+  static value_type of(const Key &key) { return key; }
+  static value_type combine(const value_type &a, const value_type &b) {
+    return std::max(a, b);
+  }
+};
+
+// Summary of the keys in [lo, hi] under node, O(height). Whole subtrees
+// hanging off the two boundary paths contribute their stored summary.
+template <typename NodeT>
+typename NodeT::monoid_type::value_type aggregateRange(const NodeT *node,
+                                                       int lo, int hi) {
+  using M = typename NodeT::monoid_type;
+  auto summaryOf = [](const NodeT *n) {
+    return n ? n->summary : M::identity();
+  };
+
+  // the highest node inside the range splits it in two
+  while (node != nullptr && (node->key < lo || hi < node->key))
+    node = node->key < lo ? node->right : node->left;
+  if (node == nullptr || hi < lo)
+    return M::identity();
+
+  // keys >= lo on the left; deeper nodes hold smaller keys, so prepend
+  auto left = M::identity();
+  for (const NodeT *n = node->left; n != nullptr;) {
+    if (n->key < lo) {
+      n = n->right;
+    } else {
+      left = M::combine(M::combine(M::of(n->key), summaryOf(n->right)), left);
+      n = n->left;
+    }
+  }
+
+  // keys <= hi on the right, appended
+  auto right = M::identity();
+  for (const NodeT *n = node->right; n != nullptr;) {
+    if (hi < n->key) {
+      n = n->left;
+    } else {
+      right = M::combine(right, M::combine(summaryOf(n->left), M::of(n->key)));
+      n = n->right;
+    }
+  }
+
+  return M::combine(M::combine(left, M::of(node->key)), right);
+}
+
+} // namespace TREE
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "node.hpp"
+#include "stats.hpp"
+#include "tree.hpp"
+#include <initializer_list>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                                 Multisets
+//-------------------------------------------------------------------------------
+
+// Ordered multiset on an AVL tree with one node per distinct key. Inserting
+// a key that is already present bumps the node's count instead of adding a
+// node, so n copies of a key cost one node; a node goes away with its last
+// copy. Every operation is one O(log n) descent plus the usual AVL
+// rebalancing when a node is added or removed; a new key is linked at the
+// leaf where its search ended.
+template <KeyComparble Key>
+class Multiset : protected AVLTree<Key, CountedBSTNode<Key>> {
+protected:
+  using NodeT = CountedBSTNode<Key>;
+
+  int total{0}; // copies
+  int nodes{0}; // distinct keys
+
+  const NodeT *find(int key) const;
+
+public:
+  Multiset() = default;
+  Multiset(std::initializer_list<int> list);
+
+  void insert(int key, int copies = 1);
+  int count(int key) const;
+  bool contains(int key) const;
+  bool eraseOne(int key); // false if key is absent
+  int eraseAll(int key);  // copies removed
+
+  int size() const;     // copies
+  int distinct() const; // nodes
+  bool empty() const;
+  void clear() override;
+
+  // In-order visit(key, count) of every distinct key.
+  template <typename F> void forEach(F visit) const;
+
+  // The underlying AVL tree's counters and shape, one node per distinct
+  // key; count() and contains() are the searches. See stats.hpp.
+  using AVLTree<Key, NodeT>::stats;
+};
+
+//-------------------------------------------------------------------------------
+//                           Multiset Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key>
+Multiset<Key>::Multiset(std::initializer_list<int> list) {
+  for (int key : list)
+    insert(key);
+}
+
+template <KeyComparble Key>
+const CountedBSTNode<Key> *Multiset<Key>::find(int key) const {
+  ScopedLatency<> timer(this->counters, &TreeStats::searchLatency);
+  return searchCounted(this->counters, this->root, key);
+}
+
+template <KeyComparble Key> void Multiset<Key>::insert(int key, int copies) {
+  if (copies <= 0)
+    return;
+  ScopedLatency<> timer(this->counters, &TreeStats::insertLatency);
+
+  // the descent ends at key's node, or below the leaf a new one hangs from
+  NodeT *parent = nullptr;
+  NodeT *node = this->root;
+  while (node != nullptr && node->key != key) {
+    parent = node;
+    node = key < node->key ? node->left : node->right;
+  }
+  if (node == nullptr) {
+    node = new NodeT(key);
+    node->count = 0;
+    node->parent = parent;
+    if (parent == nullptr)
+      this->root = node;
+    else if (key < parent->key)
+      parent->left = node;
+    else
+      parent->right = node;
+    this->trackInserted(node);
+    this->retrace(parent);
+    ++nodes;
+  }
+  node->count += copies;
+  total += copies;
+}
+
+template <KeyComparble Key> int Multiset<Key>::count(int key) const {
+  const NodeT *node = find(key);
+  return node ? node->count : 0;
+}
+
+template <KeyComparble Key> bool Multiset<Key>::contains(int key) const {
+  return find(key) != nullptr;
+}
+
+template <KeyComparble Key> bool Multiset<Key>::eraseOne(int key) {
+  ScopedLatency<> timer(this->counters, &TreeStats::removeLatency);
+  NodeT *node = this->searchNode(this->root, key);
+  if (node == nullptr)
+    return false;
+  --total;
+  if (--node->count == 0) {
+    this->deleteNode(this->root, node);
+    --nodes;
+  }
+  return true;
+}
+
+template <KeyComparble Key> int Multiset<Key>::eraseAll(int key) {
+  ScopedLatency<> timer(this->counters, &TreeStats::removeLatency);
+  NodeT *node = this->searchNode(this->root, key);
+  if (node == nullptr)
+    return 0;
+  int removed = node->count;
+  total -= removed;
+  --nodes;
+  this->deleteNode(this->root, node);
+  return removed;
+}
+
+template <KeyComparble Key> int Multiset<Key>::size() const { return total; }
+
+template <KeyComparble Key> int Multiset<Key>::distinct() const {
+  return nodes;
+}
+
+template <KeyComparble Key> bool Multiset<Key>::empty() const {
+  return total == 0;
+}
+
+template <KeyComparble Key> void Multiset<Key>::clear() {
+  AVLTree<Key, NodeT>::clear();
+  total = nodes = 0;
+}
+
+template <KeyComparble Key>
+template <typename F>
+void Multiset<Key>::forEach(F visit) const {
+  std::vector<const NodeT *> stack;
+  const NodeT *node = this->root;
+  while (node != nullptr || !stack.empty()) {
+    for (; node != nullptr; node = node->left)
+      stack.push_back(node);
+    node = stack.back();
+    stack.pop_back();
+    visit(node->key, node->count);
+    node = node->right;
+  }
+}
+
+} // namespace TREE
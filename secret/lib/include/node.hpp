@@ -1,17 +1,75 @@
 #pragma once
+#include <atomic>
 #include <concepts>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 
 template <typename Key>
 concept KeyComparble = std::totally_ordered<Key>;
 
+// Nodes that carry a summary of their subtree (for example the largest
+// interval end below them) recompute it from their children here.
+template <typename NodeT>
+concept SummarizedNode = requires(NodeT &node) { node.updateSummary(); };
+
+// Nodes that keep their subtree size, the field behind order statistics
+// (select, rank, countRange). Other nodes stay a word smaller.
+template <typename NodeT>
+concept SizedNode = requires(NodeT &node) { node.size = 1; };
+
+// AVL rules on subtree heights, shared by AVLTree, AVLBalance and
+// ConcurrentAVLTree so that every AVL variant repairs and rotates alike.
+struct AVLRules {
+  // the height of a node whose subtrees have these heights
+  static constexpr int height(int leftHeight, int rightHeight) {
+    return 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+  }
+  // subtrees whose heights differ by more than one need a rotation
+  static constexpr bool unbalanced(int leftHeight, int rightHeight) {
+    return leftHeight - rightHeight > 1 || rightHeight - leftHeight > 1;
+  }
+  // For the taller child of an unbalanced node: a single rotation is enough
+  // unless the child's inner subtree (the one nearer the node's other side)
+  // is the taller one, which takes a double rotation.
+  static constexpr bool singleRotation(int outerHeight, int innerHeight) {
+    return outerHeight >= innerHeight;
+  }
+};
+
+// Unlinked copy of node: its key and whatever bookkeeping the node type
+// keeps (height or colour, subtree size, multiplicity, interval end,
+// summary). Whole-tree copies go through this; the node copy constructors
+// stay deleted so that links are never copied by accident.
+template <typename NodeT> NodeT *cloneNode(const NodeT &node) {
+  NodeT *copy = new NodeT(node.key);
+  if constexpr (SizedNode<NodeT>)
+    copy->size = node.size;
+  if constexpr (requires { copy->height; })
+    copy->height = node.height;
+  if constexpr (requires { copy->color; })
+    copy->color = node.color;
+  if constexpr (requires { copy->count; })
+    copy->count = node.count;
+  if constexpr (requires { copy->high; })
+    copy->high = node.high;
+  if constexpr (requires { copy->maxHigh; })
+    copy->maxHigh = node.maxHigh;
+  if constexpr (requires { copy->summary; })
+    copy->summary = node.summary;
+  return copy;
+}
+
+// The small bookkeeping field sits next to the key so that, for an int key,
+// it fills the padding before the links: 32 bytes per node.
 template <KeyComparble Key> struct BSTNode {
   using key_type = Key;
 
   key_type key;
+  int height{1};
   BSTNode *left{nullptr};
   BSTNode *right{nullptr};
   BSTNode *parent{nullptr};
-  int height{1};
 
   explicit BSTNode(const key_type &k) noexcept : key(k) {}
 
@@ -29,10 +87,10 @@ template <KeyComparble Key> struct RBTNode {
   enum Color { RED, BLACK };
 
   key_type key;
+  Color color{RED}; // New node default red
   RBTNode *left{nullptr};
   RBTNode *right{nullptr};
   RBTNode *parent{nullptr};
-  Color color{RED}; // New node default red
 
   explicit RBTNode(const key_type &k) noexcept : key(k) {}
 
@@ -43,3 +101,226 @@ template <KeyComparble Key> struct RBTNode {
 
   ~RBTNode() = default;
 };
+
+// BSTNode / RBTNode plus the subtree size, for order-statistic trees (see
+// OrderStatisticAVLTree and OrderStatisticRedBlackTree).
+template <KeyComparble Key> struct SizedBSTNode {
+  using key_type = Key;
+
+  key_type key;
+  int height{1};
+  int size{1};
+  SizedBSTNode *left{nullptr};
+  SizedBSTNode *right{nullptr};
+  SizedBSTNode *parent{nullptr};
+
+  explicit SizedBSTNode(const key_type &k) noexcept : key(k) {}
+
+  SizedBSTNode(const SizedBSTNode &) = delete;
+  SizedBSTNode &operator=(const SizedBSTNode &) = delete;
+};
+
+template <KeyComparble Key> struct SizedRBTNode {
+  using key_type = Key;
+
+  enum Color { RED, BLACK };
+
+  key_type key;
+  Color color{RED};
+  int size{1};
+  SizedRBTNode *left{nullptr};
+  SizedRBTNode *right{nullptr};
+  SizedRBTNode *parent{nullptr};
+
+  explicit SizedRBTNode(const key_type &k) noexcept : key(k) {}
+
+  SizedRBTNode(const SizedRBTNode &) = delete;
+  SizedRBTNode &operator=(const SizedRBTNode &) = delete;
+};
+
+// BSTNode holding every copy of its key: count is the multiplicity.
+template <KeyComparble Key> struct CountedBSTNode {
+  using key_type = Key;
+
+  key_type key;
+  CountedBSTNode *left{nullptr};
+  CountedBSTNode *right{nullptr};
+  CountedBSTNode *parent{nullptr};
+  int height{1};
+  int count{1};
+
+  explicit CountedBSTNode(const key_type &k) noexcept : key(k) {}
+
+  CountedBSTNode(const CountedBSTNode &) = delete;
+  CountedBSTNode &operator=(const CountedBSTNode &) = delete;
+};
+
+// Red-black node of an interval tree holding one interval [key, high];
+// nodes are ordered by (key, high). maxHigh is the largest high end anywhere
+// in the subtree.
+template <KeyComparble Key> struct IntervalNode {
+  using key_type = Key;
+
+  enum Color { RED, BLACK };
+
+  key_type key;
+  key_type high;
+  key_type maxHigh;
+  Color color{RED};
+  IntervalNode *left{nullptr};
+  IntervalNode *right{nullptr};
+  IntervalNode *parent{nullptr};
+
+  IntervalNode(const key_type &low, const key_type &high)
+      : key(low), high(high), maxHigh(high) {}
+  explicit IntervalNode(const key_type &point) : IntervalNode(point, point) {}
+
+  IntervalNode(const IntervalNode &) = delete;
+  IntervalNode &operator=(const IntervalNode &) = delete;
+
+  void updateSummary() {
+    maxHigh = high;
+    if (left && maxHigh < left->maxHigh)
+      maxHigh = left->maxHigh;
+    if (right && maxHigh < right->maxHigh)
+      maxHigh = right->maxHigh;
+  }
+};
+
+// BSTNode / RBTNode plus the Monoid summary of every key in the subtree,
+// for range aggregates (see monoid.hpp).
+template <KeyComparble Key, typename Monoid> struct AggregateBSTNode {
+  using key_type = Key;
+  using monoid_type = Monoid;
+
+  key_type key;
+  AggregateBSTNode *left{nullptr};
+  AggregateBSTNode *right{nullptr};
+  AggregateBSTNode *parent{nullptr};
+  int height{1};
+  typename Monoid::value_type summary;
+
+  explicit AggregateBSTNode(const key_type &k)
+      : key(k), summary(Monoid::of(k)) {}
+
+  AggregateBSTNode(const AggregateBSTNode &) = delete;
+  AggregateBSTNode &operator=(const AggregateBSTNode &) = delete;
+
+  void updateSummary() {
+    summary = Monoid::of(key);
+    if (left)
+      summary = Monoid::combine(left->summary, summary);
+    if (right)
+      summary = Monoid::combine(summary, right->summary);
+  }
+};
+
+template <KeyComparble Key, typename Monoid> struct AggregateRBTNode {
+  using key_type = Key;
+  using monoid_type = Monoid;
+
+  enum Color { RED, BLACK };
+
+  key_type key;
+  AggregateRBTNode *left{nullptr};
+  AggregateRBTNode *right{nullptr};
+  AggregateRBTNode *parent{nullptr};
+  Color color{RED};
+  typename Monoid::value_type summary;
+
+  explicit AggregateRBTNode(const key_type &k)
+      : key(k), summary(Monoid::of(k)) {}
+
+  AggregateRBTNode(const AggregateRBTNode &) = delete;
+  AggregateRBTNode &operator=(const AggregateRBTNode &) = delete;
+
+  void updateSummary() {
+    summary = Monoid::of(key);
+    if (left)
+      summary = Monoid::combine(left->summary, summary);
+    if (right)
+      summary = Monoid::combine(summary, right->summary);
+  }
+};
+
+// Immutable node of a persistent (path-copying) AVL tree. Children are shared
+// between versions and freed by reference counting once no version uses them.
+template <KeyComparble Key> struct PersistentNode {
+  using key_type = Key;
+  using Ptr = std::shared_ptr<const PersistentNode>;
+
+  key_type key;
+  Ptr left;
+  Ptr right;
+  int height{1};
+  int size{1};
+
+  PersistentNode(const key_type &k, Ptr l, Ptr r) noexcept
+      : key(k), left(std::move(l)), right(std::move(r)) {
+    int lh = left ? left->height : 0;
+    int rh = right ? right->height : 0;
+    height = (lh > rh ? lh : rh) + 1;
+    size = (left ? left->size : 0) + (right ? right->size : 0) + 1;
+  }
+
+  PersistentNode(const PersistentNode &) = delete;
+  PersistentNode &operator=(const PersistentNode &) = delete;
+
+  ~PersistentNode() = default;
+};
+
+// Node of a concurrent AVL tree. Links, height and presence are atomics
+// because optimistic readers load them without holding the node's lock;
+// version tells those readers whether the node moved under them. A node
+// whose key was removed while it still had two children stays in the tree
+// as a routing node with present == false.
+template <KeyComparble Key> struct ConcurrentAVLNode {
+  using key_type = Key;
+
+  const key_type key;
+  std::atomic<ConcurrentAVLNode *> left{nullptr};
+  std::atomic<ConcurrentAVLNode *> right{nullptr};
+  std::atomic<ConcurrentAVLNode *> parent{nullptr};
+  std::atomic<int> height{1};
+  std::atomic<std::uint64_t> version{0};
+  std::atomic<bool> present{true};
+  std::mutex lock;
+
+  ConcurrentAVLNode(const key_type &k, ConcurrentAVLNode *p) noexcept
+      : key(k), parent(p) {}
+
+  ConcurrentAVLNode(const ConcurrentAVLNode &) = delete;
+  ConcurrentAVLNode &operator=(const ConcurrentAVLNode &) = delete;
+
+  ~ConcurrentAVLNode() = default;
+};
+
+// Compact nodes live in a CompactPool and link by 32-bit index, 0 meaning
+// "no node". The AVL node keeps its balance factor (-1, 0, +1, stored + 1)
+// in the top two bits of right; the red-black node keeps its colour in the
+// top bit of parent. Both drop the height/colour fields, 12 and 16 bytes for
+// an int key against 32 for BSTNode/RBTNode.
+template <KeyComparble Key> struct CompactAVLNode {
+  using key_type = Key;
+  static constexpr std::uint32_t INDEX_MASK = (1u << 30) - 1;
+
+  key_type key;
+  std::uint32_t left{0};
+  std::uint32_t right{0}; // index | (balance + 1) << 30
+
+  explicit CompactAVLNode(const key_type &k) noexcept
+      : key(k), right(1u << 30) {}
+};
+
+template <KeyComparble Key> struct CompactRBTNode {
+  using key_type = Key;
+  static constexpr std::uint32_t INDEX_MASK = (1u << 31) - 1;
+  static constexpr std::uint32_t RED_BIT = 1u << 31;
+
+  key_type key;
+  std::uint32_t left{0};
+  std::uint32_t right{0};
+  std::uint32_t parent{RED_BIT}; // index | RED_BIT when red, new nodes red
+
+  explicit CompactRBTNode(const key_type &k) noexcept : key(k) {}
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace PARALLEL {
+
+//-------------------------------------------------------------------------------
+//                                 Thread Pool
+//-------------------------------------------------------------------------------
+
+class ThreadPool {
+public:
+  explicit ThreadPool(unsigned threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // process-wide pool with one worker per hardware thread
+  static ThreadPool &shared();
+
+  unsigned size() const;
+  std::future<void> submit(std::function<void()> task);
+  bool runPending(); // run one queued task on the calling thread, if any
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> workers;
+  std::deque<std::packaged_task<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable ready;
+  bool stopping{false};
+};
+
+// Number of fork-join levels needed to give every worker of the shared pool
+// some work; recursive algorithms stop forking below this depth.
+int forkDepth();
+
+// Runs left on the shared pool and right on the calling thread, then waits
+// for both. The caller keeps draining the queue while it waits, so nested
+// forkJoin calls cannot deadlock the pool.
+template <typename Left, typename Right>
+void forkJoin(Left &&left, Right &&right) {
+  ThreadPool &pool = ThreadPool::shared();
+  std::future<void> pending = pool.submit(std::forward<Left>(left));
+
+  auto wait = [&] {
+    while (pending.wait_for(std::chrono::seconds(0)) !=
+           std::future_status::ready) {
+      if (!pool.runPending())
+        std::this_thread::yield();
+    }
+  };
+
+  try {
+    right();
+  } catch (...) {
+    wait(); // left still references the caller's frame
+    throw;
+  }
+  wait();
+  pending.get();
+}
+
+} // namespace PARALLEL
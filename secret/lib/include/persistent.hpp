@@ -0,0 +1,316 @@
+#pragma once
+
+#include "epoch.hpp"
+#include "node.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                           Persistent AVL Trees
+//-------------------------------------------------------------------------------
+
+// An immutable AVL tree. insert/remove path-copy the O(log n) nodes on the
+// search path and return a new version; everything else is shared with the
+// old version. Copying a tree is O(1) and a version stays valid for as long
+// as someone holds it.
+template <KeyComparble Key> class PersistentAVLTree {
+public:
+  using NodeT = PersistentNode<Key>;
+  using NodePtr = typename NodeT::Ptr;
+
+private:
+  NodePtr root;
+
+  explicit PersistentAVLTree(NodePtr node) : root(std::move(node)) {}
+  template <KeyComparble> friend class VersionedAVLTree;
+
+  static int getHeight(const NodePtr &node);
+  static NodePtr makeNode(int key, NodePtr left, NodePtr right);
+  static NodePtr rotateLeft(int key, const NodePtr &left,
+                            const NodePtr &right);
+  static NodePtr rotateRight(int key, const NodePtr &left,
+                             const NodePtr &right);
+  static NodePtr balance(int key, NodePtr left, NodePtr right);
+  static NodePtr insertNode(const NodePtr &node, int key, bool &changed);
+  static NodePtr removeNode(const NodePtr &node, int key, bool &changed);
+  static NodePtr removeMinimum(const NodePtr &node, int &minKey);
+
+public:
+  PersistentAVLTree() = default;
+
+  PersistentAVLTree insert(int key) const;
+  PersistentAVLTree remove(int key) const;
+
+  const NodeT *getRoot() const;
+  const NodeT *search(int key) const;
+  const NodeT *minimum() const;
+  const NodeT *maximum() const;
+  int size() const;
+  bool empty() const;
+
+  // in-order walk, visit(key) for every key
+  template <typename Visitor> void forEach(Visitor &&visit) const;
+};
+
+//-------------------------------------------------------------------------------
+//                           Versioned AVL Trees
+//-------------------------------------------------------------------------------
+
+// A mutable handle on a sequence of PersistentAVLTree versions. Writers are
+// serialised by a mutex and publish each new version with one atomic store.
+// snapshot() pins an epoch, loads the current version and copies its root,
+// so it never waits for a writer; afterwards readers walk an immutable tree
+// without any synchronisation. Replaced versions are retired through
+// PARALLEL::retire, and their nodes are freed by reference counting once the
+// last snapshot sharing them goes away.
+template <KeyComparble Key> class VersionedAVLTree {
+public:
+  using Snapshot = PersistentAVLTree<Key>;
+
+private:
+  struct Version {
+    typename Snapshot::NodePtr root;
+  };
+
+  std::atomic<const Version *> current;
+  std::mutex writer;
+
+  void publish(typename Snapshot::NodePtr root);
+
+public:
+  VersionedAVLTree();
+  ~VersionedAVLTree();
+
+  VersionedAVLTree(const VersionedAVLTree &) = delete;
+  VersionedAVLTree &operator=(const VersionedAVLTree &) = delete;
+
+  Snapshot snapshot() const;
+  void insert(int key);
+  void remove(int key);
+};
+
+//-------------------------------------------------------------------------------
+//                        PersistentAVLTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key>
+int PersistentAVLTree<Key>::getHeight(const NodePtr &node) {
+  return node ? node->height : 0;
+}
+
+template <KeyComparble Key>
+typename PersistentAVLTree<Key>::NodePtr
+PersistentAVLTree<Key>::makeNode(int key, NodePtr left, NodePtr right) {
+  return std::make_shared<const NodeT>(key, std::move(left),
+                                       std::move(right));
+}
+
+template <KeyComparble Key>
+typename PersistentAVLTree<Key>::NodePtr
+PersistentAVLTree<Key>::rotateLeft(int key, const NodePtr &left,
+                                   const NodePtr &right) {
+  // (left, key, (b, y, c)) -> ((left, key, b), y, c)
+  return makeNode(right->key, makeNode(key, left, right->left), right->right);
+}
+
+template <KeyComparble Key>
+typename PersistentAVLTree<Key>::NodePtr
+PersistentAVLTree<Key>::rotateRight(int key, const NodePtr &left,
+                                    const NodePtr &right) {
+  // ((a, y, b), key, right) -> (a, y, (b, key, right))
+  return makeNode(left->key, left->left, makeNode(key, left->right, right));
+}
+
+template <KeyComparble Key>
+typename PersistentAVLTree<Key>::NodePtr
+PersistentAVLTree<Key>::balance(int key, NodePtr left, NodePtr right) {
+  int diff = getHeight(left) - getHeight(right);
+
+  if (diff > 1) {
+    if (getHeight(left->left) < getHeight(left->right))
+      left = rotateLeft(left->key, left->left, left->right);
+    return rotateRight(key, left, right);
+  }
+
+  if (diff < -1) {
+    if (getHeight(right->right) < getHeight(right->left))
+      right = rotateRight(right->key, right->left, right->right);
+    return rotateLeft(key, left, right);
+  }
+
+  return makeNode(key, std::move(left), std::move(right));
+}
+
+template <KeyComparble Key>
+typename PersistentAVLTree<Key>::NodePtr
+PersistentAVLTree<Key>::insertNode(const NodePtr &node, int key,
+                                   bool &changed) {
+  if (node == nullptr) {
+    changed = true;
+    return makeNode(key, nullptr, nullptr);
+  }
+
+  if (key < node->key) {
+    NodePtr left = insertNode(node->left, key, changed);
+    return changed ? balance(node->key, std::move(left), node->right) : node;
+  }
+  if (key > node->key) {
+    NodePtr right = insertNode(node->right, key, changed);
+    return changed ? balance(node->key, node->left, std::move(right)) : node;
+  }
+  return node; // Duplicate keys not allowed, share the whole version
+}
+
+template <KeyComparble Key>
+typename PersistentAVLTree<Key>::NodePtr
+PersistentAVLTree<Key>::removeMinimum(const NodePtr &node, int &minKey) {
+  if (node->left == nullptr) {
+    minKey = node->key;
+    return node->right;
+  }
+  NodePtr left = removeMinimum(node->left, minKey);
+  return balance(node->key, std::move(left), node->right);
+}
+
+template <KeyComparble Key>
+typename PersistentAVLTree<Key>::NodePtr
+PersistentAVLTree<Key>::removeNode(const NodePtr &node, int key,
+                                   bool &changed) {
+  if (node == nullptr)
+    return node;
+
+  if (key < node->key) {
+    NodePtr left = removeNode(node->left, key, changed);
+    return changed ? balance(node->key, std::move(left), node->right) : node;
+  }
+  if (key > node->key) {
+    NodePtr right = removeNode(node->right, key, changed);
+    return changed ? balance(node->key, node->left, std::move(right)) : node;
+  }
+
+  changed = true;
+  if (node->left == nullptr)
+    return node->right;
+  if (node->right == nullptr)
+    return node->left;
+
+  // replace with the successor, copied out of the right subtree
+  int successorKey = 0;
+  NodePtr right = removeMinimum(node->right, successorKey);
+  return balance(successorKey, node->left, std::move(right));
+}
+
+template <KeyComparble Key>
+PersistentAVLTree<Key> PersistentAVLTree<Key>::insert(int key) const {
+  bool changed = false;
+  return PersistentAVLTree(insertNode(root, key, changed));
+}
+
+template <KeyComparble Key>
+PersistentAVLTree<Key> PersistentAVLTree<Key>::remove(int key) const {
+  bool changed = false;
+  return PersistentAVLTree(removeNode(root, key, changed));
+}
+
+template <KeyComparble Key>
+const PersistentNode<Key> *PersistentAVLTree<Key>::getRoot() const {
+  return root.get();
+}
+
+template <KeyComparble Key>
+const PersistentNode<Key> *PersistentAVLTree<Key>::search(int key) const {
+  const NodeT *node = root.get();
+  while (node != nullptr && node->key != key)
+    node = key < node->key ? node->left.get() : node->right.get();
+  return node;
+}
+
+template <KeyComparble Key>
+const PersistentNode<Key> *PersistentAVLTree<Key>::minimum() const {
+  const NodeT *node = root.get();
+  while (node != nullptr && node->left != nullptr)
+    node = node->left.get();
+  return node;
+}
+
+template <KeyComparble Key>
+const PersistentNode<Key> *PersistentAVLTree<Key>::maximum() const {
+  const NodeT *node = root.get();
+  while (node != nullptr && node->right != nullptr)
+    node = node->right.get();
+  return node;
+}
+
+template <KeyComparble Key> int PersistentAVLTree<Key>::size() const {
+  return root ? root->size : 0;
+}
+
+template <KeyComparble Key> bool PersistentAVLTree<Key>::empty() const {
+  return root == nullptr;
+}
+
+template <KeyComparble Key>
+template <typename Visitor>
+void PersistentAVLTree<Key>::forEach(Visitor &&visit) const {
+  // explicit stack as deep as the tree, no parent pointers needed
+  std::vector<const NodeT *> stack;
+  const NodeT *node = root.get();
+  while (node != nullptr || !stack.empty()) {
+    while (node != nullptr) {
+      stack.push_back(node);
+      node = node->left.get();
+    }
+    node = stack.back();
+    stack.pop_back();
+    visit(node->key);
+    node = node->right.get();
+  }
+}
+
+//-------------------------------------------------------------------------------
+//                        VersionedAVLTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key>
+VersionedAVLTree<Key>::VersionedAVLTree() : current(new Version{}) {}
+
+template <KeyComparble Key> VersionedAVLTree<Key>::~VersionedAVLTree() {
+  // no reader may still be inside snapshot() at this point
+  delete current.load(std::memory_order_relaxed);
+}
+
+template <KeyComparble Key>
+PersistentAVLTree<Key> VersionedAVLTree<Key>::snapshot() const {
+  PARALLEL::EpochGuard guard;
+  return Snapshot(current.load(std::memory_order_acquire)->root);
+}
+
+template <KeyComparble Key>
+void VersionedAVLTree<Key>::publish(typename Snapshot::NodePtr root) {
+  const Version *old = current.exchange(new Version{std::move(root)},
+                                        std::memory_order_acq_rel);
+  PARALLEL::retire(const_cast<Version *>(old));
+}
+
+template <KeyComparble Key> void VersionedAVLTree<Key>::insert(int key) {
+  std::lock_guard<std::mutex> lock(writer);
+  Snapshot version(current.load(std::memory_order_relaxed)->root);
+  Snapshot next = version.insert(key);
+  if (next.root != version.root)
+    publish(std::move(next.root));
+}
+
+template <KeyComparble Key> void VersionedAVLTree<Key>::remove(int key) {
+  std::lock_guard<std::mutex> lock(writer);
+  Snapshot version(current.load(std::memory_order_relaxed)->root);
+  Snapshot next = version.remove(key);
+  if (next.root != version.root)
+    publish(std::move(next.root));
+}
+
+} // namespace TREE
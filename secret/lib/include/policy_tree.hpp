@@ -0,0 +1,635 @@
+#pragma once
+
+#include "node.hpp"
+#include "stats.hpp"
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                          Policy-Based Search Trees
+//-------------------------------------------------------------------------------
+
+// Balancing policies for PolicyTree. Each one names its node type and
+// supplies static hooks the tree calls after the plain BST step:
+//   afterInsert(tree, node)             node was just linked in as a leaf
+//   replace(successor, node)            successor is about to take node's
+//                                       place; hand over node's metadata
+//   afterRemove(tree, node, x, xParent) node is unlinked (not yet freed), x
+//                                       (maybe null) now sits below xParent
+// Everything is resolved at compile time, so search/insert/remove have no
+// virtual calls and the comparison loops inline into the caller.
+struct NoBalance {
+  template <KeyComparble Key> using Node = BSTNode<Key>;
+
+  template <typename Tree, typename NodeT>
+  static void afterInsert(Tree &, NodeT *) {}
+  template <typename NodeT> static void replace(NodeT *, NodeT *) {}
+  template <typename Tree, typename NodeT>
+  static void afterRemove(Tree &, NodeT *, NodeT *, NodeT *) {}
+};
+
+struct AVLBalance {
+  template <KeyComparble Key> using Node = BSTNode<Key>;
+
+  template <typename NodeT> static int height(NodeT *node);
+  template <typename NodeT> static void update(NodeT *node);
+  template <typename Tree, typename NodeT>
+  static NodeT *rebalance(Tree &tree, NodeT *node);
+
+  template <typename Tree, typename NodeT>
+  static void afterInsert(Tree &tree, NodeT *node);
+  template <typename NodeT> static void replace(NodeT *successor, NodeT *node);
+  template <typename Tree, typename NodeT>
+  static void afterRemove(Tree &tree, NodeT *node, NodeT *x, NodeT *xParent);
+};
+
+struct RBBalance {
+  template <KeyComparble Key> using Node = RBTNode<Key>;
+
+  template <typename NodeT> static bool isRed(NodeT *node);
+  template <typename Tree, typename NodeT, typename Color>
+  static void paint(Tree &tree, NodeT *node, Color color);
+
+  template <typename Tree, typename NodeT>
+  static void afterInsert(Tree &tree, NodeT *node);
+  template <typename NodeT> static void replace(NodeT *successor, NodeT *node);
+  template <typename Tree, typename NodeT>
+  static void afterRemove(Tree &tree, NodeT *node, NodeT *x, NodeT *xParent);
+};
+
+// Iterative BST core parameterised on a balancing policy. Unlike
+// BinarySearchTree/AVLTree/RedBlackTree it has no virtual members; use it
+// where the set API below is enough and lookups are hot.
+template <KeyComparble Key, typename Balance> class PolicyTree {
+public:
+  using NodeT = typename Balance::template Node<Key>;
+
+protected:
+  friend Balance;
+
+  NodeT *root{nullptr};
+  int count{0};
+  [[no_unique_address]] mutable StatsCollector counters; // see stats.hpp
+
+  NodeT *rotateLeft(NodeT *node);
+  NodeT *rotateRight(NodeT *node);
+  void replaceChild(NodeT *parent, NodeT *oldChild, NodeT *newChild);
+  static NodeT *minimumNode(NodeT *node);
+  static NodeT *maximumNode(NodeT *node);
+  static NodeT *findNode(NodeT *node, int key);
+  static NodeT *cloneSubtree(const NodeT *node);
+
+public:
+  PolicyTree() = default;
+  PolicyTree(std::initializer_list<int> list);
+  ~PolicyTree();
+
+  // Copies are iterative (degenerate NoBalance trees are fine); moves are
+  // O(1) and leave the source empty.
+  PolicyTree(const PolicyTree &other);
+  PolicyTree(PolicyTree &&other) noexcept;
+  PolicyTree &operator=(const PolicyTree &other);
+  PolicyTree &operator=(PolicyTree &&other) noexcept;
+
+  NodeT *getRoot() const;
+  bool insert(int key); // false if key was already present
+  NodeT *search(int key) const;
+  bool remove(int key); // false if key was absent
+  NodeT *minimum() const;
+  NodeT *maximum() const;
+  NodeT *successor(int key) const; // smallest key > key, or nullptr
+
+  int size() const;
+  int height() const;
+  void clear();
+
+  // Counters from the balancing policy's hooks, when built with TREE_STATS,
+  // plus the shape of the tree as it is now.
+  TreeStats stats() const;
+};
+
+template <KeyComparble Key>
+using StaticBinarySearchTree = PolicyTree<Key, NoBalance>;
+template <KeyComparble Key> using StaticAVLTree = PolicyTree<Key, AVLBalance>;
+
+//-------------------------------------------------------------------------------
+//                           PolicyTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key, typename Balance>
+PolicyTree<Key, Balance>::PolicyTree(std::initializer_list<int> list) {
+  for (int key : list)
+    insert(key);
+}
+
+template <KeyComparble Key, typename Balance>
+PolicyTree<Key, Balance>::~PolicyTree() {
+  clear();
+}
+
+template <KeyComparble Key, typename Balance>
+PolicyTree<Key, Balance>::PolicyTree(const PolicyTree &other)
+    : root(cloneSubtree(other.root)), count(other.count) {}
+
+template <KeyComparble Key, typename Balance>
+PolicyTree<Key, Balance>::PolicyTree(PolicyTree &&other) noexcept
+    : root(std::exchange(other.root, nullptr)),
+      count(std::exchange(other.count, 0)) {}
+
+template <KeyComparble Key, typename Balance>
+PolicyTree<Key, Balance> &
+PolicyTree<Key, Balance>::operator=(const PolicyTree &other) {
+  if (this != &other) {
+    NodeT *copy = cloneSubtree(other.root);
+    clear();
+    root = copy;
+    count = other.count;
+  }
+  return *this;
+}
+
+template <KeyComparble Key, typename Balance>
+PolicyTree<Key, Balance> &
+PolicyTree<Key, Balance>::operator=(PolicyTree &&other) noexcept {
+  if (this != &other) {
+    clear();
+    root = std::exchange(other.root, nullptr);
+    count = std::exchange(other.count, 0);
+  }
+  return *this;
+}
+
+template <KeyComparble Key, typename Balance>
+typename PolicyTree<Key, Balance>::NodeT *
+PolicyTree<Key, Balance>::cloneSubtree(const NodeT *node) {
+  // preorder, so the copies are allocated in the order searches meet them
+  struct Pending {
+    const NodeT *source;
+    NodeT *parent;
+    NodeT **link;
+  };
+  NodeT *copy = nullptr;
+  std::vector<Pending> stack;
+  if (node)
+    stack.push_back({node, nullptr, &copy});
+  while (!stack.empty()) {
+    Pending next = stack.back();
+    stack.pop_back();
+    NodeT *clone = cloneNode(*next.source);
+    clone->parent = next.parent;
+    *next.link = clone;
+    if (next.source->right)
+      stack.push_back({next.source->right, clone, &clone->right});
+    if (next.source->left)
+      stack.push_back({next.source->left, clone, &clone->left});
+  }
+  return copy;
+}
+
+template <KeyComparble Key, typename Balance>
+void PolicyTree<Key, Balance>::replaceChild(NodeT *parent, NodeT *oldChild,
+                                            NodeT *newChild) {
+  if (parent == nullptr)
+    root = newChild;
+  else if (parent->left == oldChild)
+    parent->left = newChild;
+  else
+    parent->right = newChild;
+  if (newChild)
+    newChild->parent = parent;
+}
+
+template <KeyComparble Key, typename Balance>
+typename PolicyTree<Key, Balance>::NodeT *
+PolicyTree<Key, Balance>::rotateLeft(NodeT *node) {
+  NodeT *y = node->right;
+  countStat(counters, &TreeStats::rotations);
+  node->right = y->left;
+  if (y->left)
+    y->left->parent = node;
+  replaceChild(node->parent, node, y);
+  y->left = node;
+  node->parent = y;
+  return y;
+}
+
+template <KeyComparble Key, typename Balance>
+typename PolicyTree<Key, Balance>::NodeT *
+PolicyTree<Key, Balance>::rotateRight(NodeT *node) {
+  NodeT *y = node->left;
+  countStat(counters, &TreeStats::rotations);
+  node->left = y->right;
+  if (y->right)
+    y->right->parent = node;
+  replaceChild(node->parent, node, y);
+  y->right = node;
+  node->parent = y;
+  return y;
+}
+
+template <KeyComparble Key, typename Balance>
+typename PolicyTree<Key, Balance>::NodeT *
+PolicyTree<Key, Balance>::minimumNode(NodeT *node) {
+  while (node->left != nullptr)
+    node = node->left;
+  return node;
+}
+
+template <KeyComparble Key, typename Balance>
+typename PolicyTree<Key, Balance>::NodeT *
+PolicyTree<Key, Balance>::maximumNode(NodeT *node) {
+  while (node->right != nullptr)
+    node = node->right;
+  return node;
+}
+
+template <KeyComparble Key, typename Balance>
+typename PolicyTree<Key, Balance>::NodeT *
+PolicyTree<Key, Balance>::findNode(NodeT *node, int key) {
+  while (node != nullptr && node->key != key)
+    node = key < node->key ? node->left : node->right;
+  return node;
+}
+
+template <KeyComparble Key, typename Balance>
+typename PolicyTree<Key, Balance>::NodeT *
+PolicyTree<Key, Balance>::getRoot() const {
+  return root;
+}
+
+template <KeyComparble Key, typename Balance>
+bool PolicyTree<Key, Balance>::insert(int key) {
+  ScopedLatency<> timer(counters, &TreeStats::insertLatency);
+  NodeT *parent = nullptr;
+  NodeT **link = &root;
+  while (*link != nullptr) {
+    parent = *link;
+    if (key < parent->key)
+      link = &parent->left;
+    else if (parent->key < key)
+      link = &parent->right;
+    else
+      return false; // Duplicate keys not allowed
+  }
+
+  NodeT *node = new NodeT(key);
+  node->parent = parent;
+  *link = node;
+  count++;
+  Balance::afterInsert(*this, node);
+  return true;
+}
+
+template <KeyComparble Key, typename Balance>
+typename PolicyTree<Key, Balance>::NodeT *
+PolicyTree<Key, Balance>::search(int key) const {
+  ScopedLatency<> timer(counters, &TreeStats::searchLatency);
+  return searchCounted(counters, root, key);
+}
+
+template <KeyComparble Key, typename Balance>
+bool PolicyTree<Key, Balance>::remove(int key) {
+  ScopedLatency<> timer(counters, &TreeStats::removeLatency);
+  NodeT *node = findNode(root, key);
+  if (node == nullptr)
+    return false;
+
+  NodeT *x;
+  NodeT *xParent;
+  if (node->left == nullptr || node->right == nullptr) {
+    x = node->left ? node->left : node->right;
+    xParent = node->parent;
+    replaceChild(node->parent, node, x);
+  } else {
+    // the successor leaves its own spot and takes over node's
+    NodeT *successor = minimumNode(node->right);
+    x = successor->right;
+    if (successor->parent == node) {
+      xParent = successor;
+    } else {
+      xParent = successor->parent;
+      replaceChild(successor->parent, successor, x);
+      successor->right = node->right;
+      successor->right->parent = successor;
+    }
+    replaceChild(node->parent, node, successor);
+    successor->left = node->left;
+    successor->left->parent = successor;
+    Balance::replace(successor, node);
+  }
+
+  count--;
+  Balance::afterRemove(*this, node, x, xParent);
+  delete node;
+  return true;
+}
+
+template <KeyComparble Key, typename Balance>
+typename PolicyTree<Key, Balance>::NodeT *
+PolicyTree<Key, Balance>::minimum() const {
+  return root ? minimumNode(root) : nullptr;
+}
+
+template <KeyComparble Key, typename Balance>
+typename PolicyTree<Key, Balance>::NodeT *
+PolicyTree<Key, Balance>::maximum() const {
+  return root ? maximumNode(root) : nullptr;
+}
+
+template <KeyComparble Key, typename Balance>
+typename PolicyTree<Key, Balance>::NodeT *
+PolicyTree<Key, Balance>::successor(int key) const {
+  NodeT *best = nullptr;
+  for (NodeT *node = root; node != nullptr;) {
+    if (key < node->key) {
+      best = node;
+      node = node->left;
+    } else {
+      node = node->right;
+    }
+  }
+  return best;
+}
+
+template <KeyComparble Key, typename Balance>
+int PolicyTree<Key, Balance>::size() const {
+  return count;
+}
+
+template <KeyComparble Key, typename Balance>
+int PolicyTree<Key, Balance>::height() const {
+  // level-by-level, the unbalanced policy may be arbitrarily deep
+  int levels = 0;
+  std::vector<NodeT *> level;
+  if (root)
+    level.push_back(root);
+  while (!level.empty()) {
+    ++levels;
+    std::vector<NodeT *> next;
+    for (NodeT *node : level) {
+      if (node->left)
+        next.push_back(node->left);
+      if (node->right)
+        next.push_back(node->right);
+    }
+    level.swap(next);
+  }
+  return levels;
+}
+
+template <KeyComparble Key, typename Balance>
+void PolicyTree<Key, Balance>::clear() {
+  std::vector<NodeT *> stack;
+  if (root)
+    stack.push_back(root);
+  while (!stack.empty()) {
+    NodeT *node = stack.back();
+    stack.pop_back();
+    if (node->left)
+      stack.push_back(node->left);
+    if (node->right)
+      stack.push_back(node->right);
+    delete node;
+  }
+  root = nullptr;
+  count = 0;
+}
+
+template <KeyComparble Key, typename Balance>
+TreeStats PolicyTree<Key, Balance>::stats() const {
+  TreeStats result = statsOf(counters);
+  collectShape(root, sizeof(*this), result);
+  return result;
+}
+
+//-------------------------------------------------------------------------------
+//                           AVLBalance Implementation
+//-------------------------------------------------------------------------------
+
+template <typename NodeT> int AVLBalance::height(NodeT *node) {
+  return node ? node->height : 0;
+}
+
+template <typename NodeT> void AVLBalance::update(NodeT *node) {
+  node->height = AVLRules::height(height(node->left), height(node->right));
+}
+
+template <typename Tree, typename NodeT>
+NodeT *AVLBalance::rebalance(Tree &tree, NodeT *node) {
+  update(node);
+  int lh = height(node->left);
+  int rh = height(node->right);
+  if (!AVLRules::unbalanced(lh, rh))
+    return node;
+
+  if (lh > rh) {
+    NodeT *l = node->left;
+    if (!AVLRules::singleRotation(height(l->left), height(l->right))) {
+      countStat(tree.counters, &TreeStats::rotationsLR);
+      tree.rotateLeft(l);
+      update(l);
+    } else {
+      countStat(tree.counters, &TreeStats::rotationsLL);
+    }
+    NodeT *top = tree.rotateRight(node);
+    update(node);
+    update(top);
+    return top;
+  }
+
+  NodeT *r = node->right;
+  if (!AVLRules::singleRotation(height(r->right), height(r->left))) {
+    countStat(tree.counters, &TreeStats::rotationsRL);
+    tree.rotateRight(r);
+    update(r);
+  } else {
+    countStat(tree.counters, &TreeStats::rotationsRR);
+  }
+  NodeT *top = tree.rotateLeft(node);
+  update(node);
+  update(top);
+  return top;
+}
+
+template <typename Tree, typename NodeT>
+void AVLBalance::afterInsert(Tree &tree, NodeT *node) {
+  // a rotation restores the subtree's old height, and a node whose height
+  // did not change shields everything above it
+  for (NodeT *p = node->parent; p != nullptr; p = p->parent) {
+    int old = p->height;
+    NodeT *top = rebalance(tree, p);
+    if (top != p || top->height == old)
+      return;
+  }
+}
+
+template <typename NodeT>
+void AVLBalance::replace(NodeT *successor, NodeT *node) {
+  successor->height = node->height;
+}
+
+template <typename Tree, typename NodeT>
+void AVLBalance::afterRemove(Tree &tree, NodeT *, NodeT *, NodeT *xParent) {
+  // unlike insert a rotation may shrink the subtree, so keep climbing
+  // until a node comes out with its old height and no rotation
+  for (NodeT *p = xParent; p != nullptr;) {
+    int old = p->height;
+    NodeT *top = rebalance(tree, p);
+    if (top == p && top->height == old)
+      return;
+    p = top->parent;
+  }
+}
+
+//-------------------------------------------------------------------------------
+//                           RBBalance Implementation
+//-------------------------------------------------------------------------------
+
+template <typename NodeT> bool RBBalance::isRed(NodeT *node) {
+  return node != nullptr && node->color == NodeT::RED;
+}
+
+template <typename Tree, typename NodeT, typename Color>
+void RBBalance::paint(Tree &tree, NodeT *node, Color color) {
+  if (node->color != color)
+    countStat(tree.counters, &TreeStats::recolors);
+  node->color = color;
+}
+
+template <typename Tree, typename NodeT>
+void RBBalance::afterInsert(Tree &tree, NodeT *node) {
+  while (isRed(node->parent)) {
+    NodeT *parent = node->parent;
+    NodeT *grand = parent->parent; // exists, the root is black
+    bool leftSide = parent == grand->left;
+    NodeT *uncle = leftSide ? grand->right : grand->left;
+
+    if (isRed(uncle)) {
+      countFixup(tree.counters, &TreeStats::insertFixups, 1);
+      paint(tree, parent, NodeT::BLACK);
+      paint(tree, uncle, NodeT::BLACK);
+      paint(tree, grand, NodeT::RED);
+      node = grand;
+      continue;
+    }
+
+    if (leftSide) {
+      if (node == parent->right) {
+        countFixup(tree.counters, &TreeStats::insertFixups, 2);
+        countStat(tree.counters, &TreeStats::rotationsLR);
+        tree.rotateLeft(parent);
+        parent = node;
+      } else {
+        countStat(tree.counters, &TreeStats::rotationsLL);
+      }
+      tree.rotateRight(grand);
+    } else {
+      if (node == parent->left) {
+        countFixup(tree.counters, &TreeStats::insertFixups, 2);
+        countStat(tree.counters, &TreeStats::rotationsRL);
+        tree.rotateRight(parent);
+        parent = node;
+      } else {
+        countStat(tree.counters, &TreeStats::rotationsRR);
+      }
+      tree.rotateLeft(grand);
+    }
+    countFixup(tree.counters, &TreeStats::insertFixups, 3);
+    paint(tree, parent, NodeT::BLACK);
+    paint(tree, grand, NodeT::RED);
+    break;
+  }
+  paint(tree, tree.root, NodeT::BLACK);
+}
+
+template <typename NodeT>
+void RBBalance::replace(NodeT *successor, NodeT *node) {
+  // successor inherits node's colour; node keeps the colour that actually
+  // left the tree, which afterRemove looks at
+  auto color = successor->color;
+  successor->color = node->color;
+  node->color = color;
+}
+
+template <typename Tree, typename NodeT>
+void RBBalance::afterRemove(Tree &tree, NodeT *node, NodeT *x,
+                            NodeT *xParent) {
+  if (node->color == NodeT::RED)
+    return;
+
+  // x carries an extra black; push it up or resolve it by rotation
+  while (x != tree.root && !isRed(x)) {
+    if (x == xParent->left) {
+      NodeT *w = xParent->right;
+      if (isRed(w)) {
+        countFixup(tree.counters, &TreeStats::deleteFixups, 1);
+        paint(tree, w, NodeT::BLACK);
+        paint(tree, xParent, NodeT::RED);
+        tree.rotateLeft(xParent);
+        w = xParent->right;
+      }
+      if (!isRed(w->left) && !isRed(w->right)) {
+        countFixup(tree.counters, &TreeStats::deleteFixups, 2);
+        paint(tree, w, NodeT::RED);
+        x = xParent;
+        xParent = x->parent;
+        continue;
+      }
+      if (!isRed(w->right)) {
+        countFixup(tree.counters, &TreeStats::deleteFixups, 3);
+        paint(tree, w->left, NodeT::BLACK);
+        paint(tree, w, NodeT::RED);
+        tree.rotateRight(w);
+        w = xParent->right;
+      }
+      countFixup(tree.counters, &TreeStats::deleteFixups, 4);
+      paint(tree, w, xParent->color);
+      paint(tree, xParent, NodeT::BLACK);
+      paint(tree, w->right, NodeT::BLACK);
+      tree.rotateLeft(xParent);
+    } else {
+      NodeT *w = xParent->left;
+      if (isRed(w)) {
+        countFixup(tree.counters, &TreeStats::deleteFixups, 1);
+        paint(tree, w, NodeT::BLACK);
+        paint(tree, xParent, NodeT::RED);
+        tree.rotateRight(xParent);
+        w = xParent->left;
+      }
+      if (!isRed(w->left) && !isRed(w->right)) {
+        countFixup(tree.counters, &TreeStats::deleteFixups, 2);
+        paint(tree, w, NodeT::RED);
+        x = xParent;
+        xParent = x->parent;
+        continue;
+      }
+      if (!isRed(w->left)) {
+        countFixup(tree.counters, &TreeStats::deleteFixups, 3);
+        paint(tree, w->right, NodeT::BLACK);
+        paint(tree, w, NodeT::RED);
+        tree.rotateLeft(w);
+        w = xParent->left;
+      }
+      countFixup(tree.counters, &TreeStats::deleteFixups, 4);
+      paint(tree, w, xParent->color);
+      paint(tree, xParent, NodeT::BLACK);
+      paint(tree, w->left, NodeT::BLACK);
+      tree.rotateRight(xParent);
+    }
+    x = tree.root;
+  }
+  if (x)
+    paint(tree, x, NodeT::BLACK);
+}
+
+} // namespace TREE
+
+namespace RBTREE {
+
+template <KeyComparble Key>
+using StaticRedBlackTree = TREE::PolicyTree<Key, TREE::RBBalance>;
+
+} // namespace RBTREE
@@ -0,0 +1,1154 @@
+#pragma once
+
+#include "node.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                              Radix Key Encoding
+//-------------------------------------------------------------------------------
+
+// RadixKeyTraits<Key>::encode(key) returns the bytes of key (anything with
+// data() and size() over unsigned char) such that comparing two encodings
+// byte by byte, unsigned, a shorter one first when it is a prefix of the
+// other, orders them exactly as operator< orders the keys.
+template <typename Key> struct RadixKeyTraits;
+
+// Integers: big-endian, signed ones with the sign bit flipped so that
+// negative numbers sort first. Every encoding has the same length.
+template <std::integral Key>
+  requires(!std::same_as<Key, bool>)
+struct RadixKeyTraits<Key> {
+  static std::array<unsigned char, sizeof(Key)> encode(Key key) {
+    using U = std::make_unsigned_t<Key>;
+    U bits = static_cast<U>(key);
+    if constexpr (std::is_signed_v<Key>)
+      bits ^= U(1) << (8 * sizeof(Key) - 1);
+    std::array<unsigned char, sizeof(Key)> bytes;
+    for (std::size_t i = 0; i < sizeof(Key); ++i)
+      bytes[i] = static_cast<unsigned char>(bits >> 8 * (sizeof(Key) - 1 - i));
+    return bytes;
+  }
+};
+
+// Strings: their own bytes, no copy. std::string compares its chars as
+// unsigned char, which is the byte order of the tree.
+template <> struct RadixKeyTraits<std::string> {
+  static std::span<const unsigned char> encode(const std::string &key) {
+    return {reinterpret_cast<const unsigned char *>(key.data()), key.size()};
+  }
+};
+
+template <typename Key>
+concept RadixKey = KeyComparble<Key> && requires(const Key &key) {
+  RadixKeyTraits<Key>::encode(key).data();
+  RadixKeyTraits<Key>::encode(key).size();
+};
+
+//-------------------------------------------------------------------------------
+//                            Adaptive Radix Trees
+//-------------------------------------------------------------------------------
+
+// Ordered set with the insert/search/remove/minimum/maximum/successor/scan
+// interface of BPlusTree, stored as an adaptive radix tree (Leis et al.,
+// ICDE 2013) over the key encoding above. A lookup walks one byte of the
+// key per level, picking the child with one small array probe, and does a
+// single full key comparison at the end, instead of a comparison per level
+// of a balanced tree. Iteration order is the order of operator<.
+//
+// Inner nodes grow and shrink between four layouts as their fan-out
+// changes: Node4 and Node16 keep sorted key bytes beside the children
+// (Node16 searched with SSE2), Node48 maps all 256 bytes to 48 child slots
+// and Node256 indexes its children directly. A chain of single-child nodes
+// is compressed into the prefix of the node below it (the first
+// MAX_PREFIX bytes are kept in the node, the rest are read from any leaf
+// under it when needed), and a key gets its own leaf as soon as its path
+// is unique rather than a node per remaining byte. Leaves hold the whole
+// key and are tagged child pointers; a key that ends at an inner node, a
+// string that is a prefix of other keys, is that node's terminal leaf.
+//
+// search/minimum/maximum/successor/lowerBound return a pointer to the key
+// inside its leaf, or nullptr; it stays valid until that key is removed.
+template <RadixKey Key> class AdaptiveRadixTree {
+protected:
+  using Traits = RadixKeyTraits<Key>;
+
+  static constexpr std::uint32_t MAX_PREFIX = 16; // prefix bytes in a node
+
+  enum class Kind : std::uint8_t { N4, N16, N48, N256 };
+
+  struct Leaf {
+    Key key;
+    explicit Leaf(const Key &k) : key(k) {}
+  };
+
+  struct Node {
+    Kind kind;
+    std::uint16_t count{0};      // children, the terminal leaf not included
+    std::uint32_t prefixLen{0};  // compressed path above the children
+    unsigned char prefix[MAX_PREFIX];
+    Leaf *terminal{nullptr};     // key ending right after the prefix
+
+    explicit Node(Kind k) : kind(k) {}
+  };
+
+  struct Node4 : Node {
+    unsigned char keys[4]{};
+    Node *children[4]{};
+    Node4() : Node(Kind::N4) {}
+  };
+
+  // keys past count are zero: the SSE2 search loads all sixteen
+  struct Node16 : Node {
+    unsigned char keys[16]{};
+    Node *children[16]{};
+    Node16() : Node(Kind::N16) {}
+  };
+
+  // index[byte] is the child's slot + 1, 0 for no child
+  struct Node48 : Node {
+    unsigned char index[256]{};
+    Node *children[48]{};
+    Node48() : Node(Kind::N48) {}
+  };
+
+  struct Node256 : Node {
+    Node *children[256]{};
+    Node256() : Node(Kind::N256) {}
+  };
+
+  // In-order walk state: the next child position of every node on the
+  // path, -1 before the terminal leaf. A leaf frame is a pending key.
+  struct Frame {
+    const Node *node;
+    int pos;
+  };
+
+  Node *root{nullptr}; // inner node, tagged leaf or nullptr
+  int count{0};
+  [[no_unique_address]] mutable StatsCollector counters; // see stats.hpp
+
+  static bool isLeaf(const Node *node) {
+    return reinterpret_cast<std::uintptr_t>(node) & 1;
+  }
+  static Leaf *asLeaf(const Node *node) {
+    return reinterpret_cast<Leaf *>(reinterpret_cast<std::uintptr_t>(node) &
+                                    ~std::uintptr_t(1));
+  }
+  static Node *tagLeaf(Leaf *leaf) {
+    return reinterpret_cast<Node *>(reinterpret_cast<std::uintptr_t>(leaf) |
+                                    1);
+  }
+
+  static int upperPosition(const unsigned char *keys, int n,
+                           unsigned char byte);
+  static Node **findChild(Node *node, unsigned char byte);
+  static int positionAfter(const Node *node, unsigned char byte);
+  static Node *childFrom(const Node *node, int &pos);
+  static Node *lastChild(const Node *node);
+  static const Leaf *minimumLeaf(const Node *node);
+  static const Leaf *maximumLeaf(const Node *node);
+
+  static void setPrefix(Node *node, const unsigned char *bytes,
+                        std::uint32_t len);
+  static unsigned char prefixByte(const Node *node, std::size_t depth,
+                                  std::uint32_t i);
+  static std::uint32_t prefixMismatch(const Node *node,
+                                      const unsigned char *key,
+                                      std::size_t len, std::size_t depth);
+
+  static void addChild(Node *&ref, unsigned char byte, Node *child);
+  static void removeChild(Node *node, unsigned char byte);
+  static void shrink(Node *&ref);
+  static void freeNode(Node *node);
+  static void destroy(Node *node);
+  static Node *cloneTree(const Node *node);
+
+  const Key *find(const Key &key, SearchPath<> &path) const;
+  void seek(std::vector<Frame> &stack, const Key &key, bool strict) const;
+  static const Leaf *advance(std::vector<Frame> &stack);
+
+public:
+  AdaptiveRadixTree() = default;
+  AdaptiveRadixTree(std::initializer_list<Key> list);
+  ~AdaptiveRadixTree();
+
+  // A copy clones the other tree node for node, O(n) with no key
+  // comparisons; a move takes its nodes over in O(1) and leaves it empty.
+  AdaptiveRadixTree(const AdaptiveRadixTree &other);
+  AdaptiveRadixTree &operator=(const AdaptiveRadixTree &other);
+  AdaptiveRadixTree(AdaptiveRadixTree &&other) noexcept;
+  AdaptiveRadixTree &operator=(AdaptiveRadixTree &&other) noexcept;
+
+  AdaptiveRadixTree &operator=(std::initializer_list<Key> list);
+
+  void insert(const Key &key);
+  const Key *search(const Key &key) const;
+  void remove(const Key &key);
+  void clear();
+  const Key *minimum() const;
+  const Key *maximum() const;
+  const Key *successor(const Key &key) const; // only for keys in the tree
+  const Key *lowerBound(const Key &key) const; // smallest key >= key
+
+  int size() const;
+  int height() const; // nodes on the longest root-to-leaf path
+
+  // Counters when built with TREE_STATS, plus the current shape. Inner
+  // nodes and leaves both count as nodes, in search paths too; bytes
+  // leaves out whatever a key owns beyond its leaf (a string's buffer).
+  TreeStats stats() const;
+
+  // visit(key) for every key, or every key in [lo, hi], in order
+  template <typename Visitor> void forEach(Visitor &&visit) const;
+  template <typename Visitor>
+  void scan(const Key &lo, const Key &hi, Visitor &&visit) const;
+};
+
+//-------------------------------------------------------------------------------
+//                       AdaptiveRadixTree Implementation
+//-------------------------------------------------------------------------------
+
+template <RadixKey Key>
+AdaptiveRadixTree<Key>::AdaptiveRadixTree(std::initializer_list<Key> list) {
+  for (const Key &key : list)
+    insert(key);
+}
+
+template <RadixKey Key> AdaptiveRadixTree<Key>::~AdaptiveRadixTree() {
+  destroy(root);
+}
+
+template <RadixKey Key>
+AdaptiveRadixTree<Key>::AdaptiveRadixTree(const AdaptiveRadixTree &other)
+    : root(cloneTree(other.root)), count(other.count) {}
+
+template <RadixKey Key>
+AdaptiveRadixTree<Key> &
+AdaptiveRadixTree<Key>::operator=(const AdaptiveRadixTree &other) {
+  if (this != &other) {
+    Node *copy = cloneTree(other.root);
+    destroy(root);
+    root = copy;
+    count = other.count;
+  }
+  return *this;
+}
+
+template <RadixKey Key>
+AdaptiveRadixTree<Key>::AdaptiveRadixTree(AdaptiveRadixTree &&other) noexcept
+    : root(std::exchange(other.root, nullptr)),
+      count(std::exchange(other.count, 0)) {}
+
+template <RadixKey Key>
+AdaptiveRadixTree<Key> &
+AdaptiveRadixTree<Key>::operator=(AdaptiveRadixTree &&other) noexcept {
+  if (this != &other) {
+    destroy(root);
+    root = std::exchange(other.root, nullptr);
+    count = std::exchange(other.count, 0);
+  }
+  return *this;
+}
+
+template <RadixKey Key>
+AdaptiveRadixTree<Key> &
+AdaptiveRadixTree<Key>::operator=(std::initializer_list<Key> list) {
+  clear();
+  for (const Key &key : list)
+    insert(key);
+  return *this;
+}
+
+template <RadixKey Key> void AdaptiveRadixTree<Key>::clear() {
+  destroy(root);
+  root = nullptr;
+  count = 0;
+}
+
+// Number of keys[0, n) not above byte; keys are sorted and distinct.
+template <RadixKey Key>
+int AdaptiveRadixTree<Key>::upperPosition(const unsigned char *keys, int n,
+                                          unsigned char byte) {
+#if defined(__SSE2__)
+  if (n > 4) {
+    // SSE2 only compares signed bytes, flipping the top bit fixes the order
+    __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    __m128i probe = _mm_xor_si128(_mm_set1_epi8(static_cast<char>(byte)), bias);
+    __m128i all = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys)), bias);
+    unsigned above = static_cast<unsigned>(
+                         _mm_movemask_epi8(_mm_cmpgt_epi8(all, probe))) &
+                     ((1u << n) - 1);
+    return above ? std::countr_zero(above) : n;
+  }
+#endif
+  int i = 0;
+  while (i < n && keys[i] <= byte)
+    ++i;
+  return i;
+}
+
+template <RadixKey Key>
+typename AdaptiveRadixTree<Key>::Node **
+AdaptiveRadixTree<Key>::findChild(Node *node, unsigned char byte) {
+  switch (node->kind) {
+  case Kind::N4: {
+    auto *n = static_cast<Node4 *>(node);
+    for (int i = 0; i < n->count; ++i)
+      if (n->keys[i] == byte)
+        return &n->children[i];
+    return nullptr;
+  }
+  case Kind::N16: {
+    auto *n = static_cast<Node16 *>(node);
+#if defined(__SSE2__)
+    __m128i equal = _mm_cmpeq_epi8(
+        _mm_set1_epi8(static_cast<char>(byte)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(n->keys)));
+    unsigned hits = static_cast<unsigned>(_mm_movemask_epi8(equal)) &
+                    ((1u << n->count) - 1);
+    return hits ? &n->children[std::countr_zero(hits)] : nullptr;
+#else
+    for (int i = 0; i < n->count; ++i)
+      if (n->keys[i] == byte)
+        return &n->children[i];
+    return nullptr;
+#endif
+  }
+  case Kind::N48: {
+    auto *n = static_cast<Node48 *>(node);
+    return n->index[byte] ? &n->children[n->index[byte] - 1] : nullptr;
+  }
+  case Kind::N256: {
+    auto *n = static_cast<Node256 *>(node);
+    return n->children[byte] ? &n->children[byte] : nullptr;
+  }
+  }
+  return nullptr;
+}
+
+// Position, in the sense of childFrom(), of the first child above byte.
+template <RadixKey Key>
+int AdaptiveRadixTree<Key>::positionAfter(const Node *node,
+                                          unsigned char byte) {
+  switch (node->kind) {
+  case Kind::N4:
+    return upperPosition(static_cast<const Node4 *>(node)->keys, node->count,
+                         byte);
+  case Kind::N16:
+    return upperPosition(static_cast<const Node16 *>(node)->keys, node->count,
+                         byte);
+  default: // Node48 and Node256 positions are bytes
+    return byte + 1;
+  }
+}
+
+// First child at position pos or later, in key order; pos moves past it.
+template <RadixKey Key>
+typename AdaptiveRadixTree<Key>::Node *
+AdaptiveRadixTree<Key>::childFrom(const Node *node, int &pos) {
+  switch (node->kind) {
+  case Kind::N4:
+    return pos < node->count ? static_cast<const Node4 *>(node)->children[pos++]
+                             : nullptr;
+  case Kind::N16:
+    return pos < node->count
+               ? static_cast<const Node16 *>(node)->children[pos++]
+               : nullptr;
+  case Kind::N48: {
+    auto *n = static_cast<const Node48 *>(node);
+    for (; pos < 256; ++pos)
+      if (n->index[pos])
+        return n->children[n->index[pos++] - 1];
+    return nullptr;
+  }
+  case Kind::N256: {
+    auto *n = static_cast<const Node256 *>(node);
+    for (; pos < 256; ++pos)
+      if (n->children[pos])
+        return n->children[pos++];
+    return nullptr;
+  }
+  }
+  return nullptr;
+}
+
+template <RadixKey Key>
+typename AdaptiveRadixTree<Key>::Node *
+AdaptiveRadixTree<Key>::lastChild(const Node *node) {
+  if (node->count == 0)
+    return nullptr;
+  switch (node->kind) {
+  case Kind::N4:
+    return static_cast<const Node4 *>(node)->children[node->count - 1];
+  case Kind::N16:
+    return static_cast<const Node16 *>(node)->children[node->count - 1];
+  case Kind::N48: {
+    auto *n = static_cast<const Node48 *>(node);
+    for (int b = 255; b >= 0; --b)
+      if (n->index[b])
+        return n->children[n->index[b] - 1];
+    return nullptr;
+  }
+  case Kind::N256: {
+    auto *n = static_cast<const Node256 *>(node);
+    for (int b = 255; b >= 0; --b)
+      if (n->children[b])
+        return n->children[b];
+    return nullptr;
+  }
+  }
+  return nullptr;
+}
+
+// The terminal leaf sorts before every child: it is a prefix of them.
+template <RadixKey Key>
+const typename AdaptiveRadixTree<Key>::Leaf *
+AdaptiveRadixTree<Key>::minimumLeaf(const Node *node) {
+  while (!isLeaf(node)) {
+    if (node->terminal != nullptr)
+      return node->terminal;
+    int pos = 0;
+    node = childFrom(node, pos);
+  }
+  return asLeaf(node);
+}
+
+template <RadixKey Key>
+const typename AdaptiveRadixTree<Key>::Leaf *
+AdaptiveRadixTree<Key>::maximumLeaf(const Node *node) {
+  while (!isLeaf(node)) {
+    Node *last = lastChild(node);
+    if (last == nullptr)
+      return node->terminal;
+    node = last;
+  }
+  return asLeaf(node);
+}
+
+template <RadixKey Key>
+void AdaptiveRadixTree<Key>::setPrefix(Node *node, const unsigned char *bytes,
+                                       std::uint32_t len) {
+  node->prefixLen = len;
+  for (std::uint32_t i = 0; i < len && i < MAX_PREFIX; ++i)
+    node->prefix[i] = bytes[i];
+}
+
+// Byte i of the prefix of node, which starts at key byte depth. Bytes past
+// MAX_PREFIX are not stored, but every leaf below node has them.
+template <RadixKey Key>
+unsigned char AdaptiveRadixTree<Key>::prefixByte(const Node *node,
+                                                 std::size_t depth,
+                                                 std::uint32_t i) {
+  if (i < MAX_PREFIX)
+    return node->prefix[i];
+  return Traits::encode(minimumLeaf(node)->key).data()[depth + i];
+}
+
+// Length of the common part of node's prefix and key[depth, len).
+template <RadixKey Key>
+std::uint32_t AdaptiveRadixTree<Key>::prefixMismatch(const Node *node,
+                                                     const unsigned char *key,
+                                                     std::size_t len,
+                                                     std::size_t depth) {
+  std::uint32_t limit = static_cast<std::uint32_t>(
+      std::min<std::size_t>(node->prefixLen, len - depth));
+  std::uint32_t i = 0;
+  for (std::uint32_t stored = std::min(limit, MAX_PREFIX); i < stored; ++i)
+    if (node->prefix[i] != key[depth + i])
+      return i;
+  if (i < limit) {
+    auto bytes = Traits::encode(minimumLeaf(node)->key);
+    for (; i < limit; ++i)
+      if (bytes.data()[depth + i] != key[depth + i])
+        return i;
+  }
+  return limit;
+}
+
+template <RadixKey Key>
+void AdaptiveRadixTree<Key>::addChild(Node *&ref, unsigned char byte,
+                                      Node *child) {
+  Node *node = ref;
+  auto grow = [&](auto *bigger) {
+    bigger->prefixLen = node->prefixLen;
+    std::memcpy(bigger->prefix, node->prefix, MAX_PREFIX);
+    bigger->terminal = node->terminal;
+    bigger->count = node->count;
+    ref = bigger;
+  };
+
+  switch (node->kind) {
+  case Kind::N4: {
+    auto *n = static_cast<Node4 *>(node);
+    if (n->count == 4) {
+      auto *bigger = new Node16;
+      std::memcpy(bigger->keys, n->keys, 4);
+      std::memcpy(bigger->children, n->children, sizeof(n->children));
+      grow(bigger);
+      delete n;
+      return addChild(ref, byte, child);
+    }
+    int pos = upperPosition(n->keys, n->count, byte);
+    std::memmove(n->keys + pos + 1, n->keys + pos, n->count - pos);
+    std::memmove(n->children + pos + 1, n->children + pos,
+                 (n->count - pos) * sizeof(Node *));
+    n->keys[pos] = byte;
+    n->children[pos] = child;
+    ++n->count;
+    return;
+  }
+  case Kind::N16: {
+    auto *n = static_cast<Node16 *>(node);
+    if (n->count == 16) {
+      auto *bigger = new Node48;
+      for (int i = 0; i < 16; ++i) {
+        bigger->index[n->keys[i]] = static_cast<unsigned char>(i + 1);
+        bigger->children[i] = n->children[i];
+      }
+      grow(bigger);
+      delete n;
+      return addChild(ref, byte, child);
+    }
+    int pos = upperPosition(n->keys, n->count, byte);
+    std::memmove(n->keys + pos + 1, n->keys + pos, n->count - pos);
+    std::memmove(n->children + pos + 1, n->children + pos,
+                 (n->count - pos) * sizeof(Node *));
+    n->keys[pos] = byte;
+    n->children[pos] = child;
+    ++n->count;
+    return;
+  }
+  case Kind::N48: {
+    auto *n = static_cast<Node48 *>(node);
+    if (n->count == 48) {
+      auto *bigger = new Node256;
+      for (int b = 0; b < 256; ++b)
+        if (n->index[b])
+          bigger->children[b] = n->children[n->index[b] - 1];
+      grow(bigger);
+      delete n;
+      return addChild(ref, byte, child);
+    }
+    int slot = 0;
+    while (n->children[slot] != nullptr)
+      ++slot;
+    n->index[byte] = static_cast<unsigned char>(slot + 1);
+    n->children[slot] = child;
+    ++n->count;
+    return;
+  }
+  case Kind::N256: {
+    auto *n = static_cast<Node256 *>(node);
+    n->children[byte] = child;
+    ++n->count;
+    return;
+  }
+  }
+}
+
+template <RadixKey Key>
+void AdaptiveRadixTree<Key>::removeChild(Node *node, unsigned char byte) {
+  auto erase = [&](unsigned char *keys, Node **children) {
+    int pos = 0;
+    while (keys[pos] != byte)
+      ++pos;
+    std::memmove(keys + pos, keys + pos + 1, node->count - pos - 1);
+    std::memmove(children + pos, children + pos + 1,
+                 (node->count - pos - 1) * sizeof(Node *));
+  };
+
+  switch (node->kind) {
+  case Kind::N4: {
+    auto *n = static_cast<Node4 *>(node);
+    erase(n->keys, n->children);
+    break;
+  }
+  case Kind::N16: {
+    auto *n = static_cast<Node16 *>(node);
+    erase(n->keys, n->children);
+    break;
+  }
+  case Kind::N48: {
+    auto *n = static_cast<Node48 *>(node);
+    n->children[n->index[byte] - 1] = nullptr;
+    n->index[byte] = 0;
+    break;
+  }
+  case Kind::N256:
+    static_cast<Node256 *>(node)->children[byte] = nullptr;
+    break;
+  }
+  --node->count;
+}
+
+// After a removal from *ref: moves to a smaller layout once the node is
+// well below capacity (with some slack, so that a key added and removed
+// at the boundary does not convert the node back and forth), and replaces
+// a node left with a single entry by that entry.
+template <RadixKey Key> void AdaptiveRadixTree<Key>::shrink(Node *&ref) {
+  Node *node = ref;
+  auto shrunk = [&](auto *smaller) {
+    smaller->prefixLen = node->prefixLen;
+    std::memcpy(smaller->prefix, node->prefix, MAX_PREFIX);
+    smaller->terminal = node->terminal;
+    smaller->count = node->count;
+    ref = smaller;
+    freeNode(node);
+  };
+
+  if (node->count == 0) {
+    ref = node->terminal != nullptr ? tagLeaf(node->terminal) : nullptr;
+    freeNode(node);
+    return;
+  }
+  if (node->count == 1 && node->terminal == nullptr) {
+    int pos = 0;
+    Node *child = childFrom(node, pos);
+    if (!isLeaf(child)) {
+      // node's prefix, the byte leading to child, then child's prefix
+      unsigned char merged[MAX_PREFIX];
+      std::uint32_t used = std::min(node->prefixLen, MAX_PREFIX);
+      std::memcpy(merged, node->prefix, used);
+      if (used < MAX_PREFIX) {
+        if (node->kind == Kind::N4)
+          merged[used++] = static_cast<Node4 *>(node)->keys[0];
+        else if (node->kind == Kind::N16)
+          merged[used++] = static_cast<Node16 *>(node)->keys[0];
+        else // childFrom left pos one past the child's byte
+          merged[used++] = static_cast<unsigned char>(pos - 1);
+      }
+      std::uint32_t rest = std::min(child->prefixLen, MAX_PREFIX - used);
+      std::memcpy(merged + used, child->prefix, rest);
+      std::memcpy(child->prefix, merged, used + rest);
+      child->prefixLen += node->prefixLen + 1;
+    }
+    ref = child;
+    freeNode(node);
+    return;
+  }
+
+  switch (node->kind) {
+  case Kind::N4:
+    return;
+  case Kind::N16: {
+    auto *n = static_cast<Node16 *>(node);
+    if (n->count > 3)
+      return;
+    auto *smaller = new Node4;
+    std::memcpy(smaller->keys, n->keys, n->count);
+    std::memcpy(smaller->children, n->children, n->count * sizeof(Node *));
+    return shrunk(smaller);
+  }
+  case Kind::N48: {
+    auto *n = static_cast<Node48 *>(node);
+    if (n->count > 12)
+      return;
+    auto *smaller = new Node16;
+    int i = 0;
+    for (int b = 0; b < 256; ++b) {
+      if (n->index[b]) {
+        smaller->keys[i] = static_cast<unsigned char>(b);
+        smaller->children[i++] = n->children[n->index[b] - 1];
+      }
+    }
+    return shrunk(smaller);
+  }
+  case Kind::N256: {
+    auto *n = static_cast<Node256 *>(node);
+    if (n->count > 37)
+      return;
+    auto *smaller = new Node48;
+    int slot = 0;
+    for (int b = 0; b < 256; ++b) {
+      if (n->children[b]) {
+        smaller->index[b] = static_cast<unsigned char>(slot + 1);
+        smaller->children[slot++] = n->children[b];
+      }
+    }
+    return shrunk(smaller);
+  }
+  }
+}
+
+// Frees node alone, not its children or terminal leaf.
+template <RadixKey Key> void AdaptiveRadixTree<Key>::freeNode(Node *node) {
+  switch (node->kind) {
+  case Kind::N4:
+    delete static_cast<Node4 *>(node);
+    break;
+  case Kind::N16:
+    delete static_cast<Node16 *>(node);
+    break;
+  case Kind::N48:
+    delete static_cast<Node48 *>(node);
+    break;
+  case Kind::N256:
+    delete static_cast<Node256 *>(node);
+    break;
+  }
+}
+
+template <RadixKey Key> void AdaptiveRadixTree<Key>::destroy(Node *node) {
+  std::vector<Node *> stack;
+  if (node != nullptr)
+    stack.push_back(node);
+  while (!stack.empty()) {
+    node = stack.back();
+    stack.pop_back();
+    if (isLeaf(node)) {
+      delete asLeaf(node);
+      continue;
+    }
+    int pos = 0;
+    while (Node *child = childFrom(node, pos))
+      stack.push_back(child);
+    delete node->terminal;
+    freeNode(node);
+  }
+}
+
+// Copies every node as is, then points each child slot of the copy, which
+// still holds the source child, at a copy of that child in turn.
+template <RadixKey Key>
+typename AdaptiveRadixTree<Key>::Node *
+AdaptiveRadixTree<Key>::cloneTree(const Node *node) {
+  Node *copy = const_cast<Node *>(node);
+  std::vector<Node **> pending;
+  if (node != nullptr)
+    pending.push_back(&copy);
+  while (!pending.empty()) {
+    Node **slot = pending.back();
+    pending.pop_back();
+    const Node *source = *slot;
+    if (isLeaf(source)) {
+      *slot = tagLeaf(new Leaf(asLeaf(source)->key));
+      continue;
+    }
+
+    auto fix = [&](auto *clone, Node **children, int slots) {
+      *slot = clone;
+      if (source->terminal != nullptr)
+        clone->terminal = new Leaf(source->terminal->key);
+      for (int i = 0; i < slots; ++i)
+        if (children[i] != nullptr)
+          pending.push_back(&children[i]);
+    };
+    switch (source->kind) {
+    case Kind::N4: {
+      auto *clone = new Node4(*static_cast<const Node4 *>(source));
+      fix(clone, clone->children, clone->count);
+      break;
+    }
+    case Kind::N16: {
+      auto *clone = new Node16(*static_cast<const Node16 *>(source));
+      fix(clone, clone->children, clone->count);
+      break;
+    }
+    case Kind::N48: {
+      auto *clone = new Node48(*static_cast<const Node48 *>(source));
+      fix(clone, clone->children, 48);
+      break;
+    }
+    case Kind::N256: {
+      auto *clone = new Node256(*static_cast<const Node256 *>(source));
+      fix(clone, clone->children, 256);
+      break;
+    }
+    }
+  }
+  return copy;
+}
+
+template <RadixKey Key> void AdaptiveRadixTree<Key>::insert(const Key &key) {
+  ScopedLatency<> timer(counters, &TreeStats::insertLatency);
+  auto encoded = Traits::encode(key);
+  const unsigned char *bytes = encoded.data();
+  std::size_t len = encoded.size();
+
+  // places leaf below node, as its terminal when the key ends at depth
+  auto attach = [&](Node *&ref, Leaf *leaf, std::size_t depth) {
+    auto leafBytes = Traits::encode(leaf->key);
+    if (depth == leafBytes.size())
+      ref->terminal = leaf;
+    else
+      addChild(ref, leafBytes.data()[depth], tagLeaf(leaf));
+  };
+
+  Node **ref = &root;
+  std::size_t depth = 0;
+  for (;;) {
+    Node *node = *ref;
+    if (node == nullptr) {
+      *ref = tagLeaf(new Leaf(key));
+      ++count;
+      return;
+    }
+
+    if (isLeaf(node)) {
+      // lazy expansion ends here: both keys get a node where they part
+      Leaf *other = asLeaf(node);
+      if (other->key == key)
+        return;
+      auto otherBytes = Traits::encode(other->key);
+      std::size_t end = std::min(len, otherBytes.size());
+      std::size_t common = depth;
+      while (common < end && bytes[common] == otherBytes.data()[common])
+        ++common;
+      Node *parent = new Node4;
+      setPrefix(parent, bytes + depth,
+                static_cast<std::uint32_t>(common - depth));
+      attach(parent, other, common);
+      attach(parent, new Leaf(key), common);
+      *ref = parent;
+      ++count;
+      return;
+    }
+
+    if (node->prefixLen > 0) {
+      std::uint32_t match = prefixMismatch(node, bytes, len, depth);
+      if (match < node->prefixLen) {
+        // the key leaves the compressed path: split it at the mismatch
+        Node *parent = new Node4;
+        setPrefix(parent, bytes + depth, match);
+        unsigned char byte = prefixByte(node, depth, match);
+        std::uint32_t rest = node->prefixLen - match - 1;
+        if (node->prefixLen <= MAX_PREFIX) {
+          std::memmove(node->prefix, node->prefix + match + 1, rest);
+        } else {
+          auto leafBytes = Traits::encode(minimumLeaf(node)->key);
+          std::memcpy(node->prefix, leafBytes.data() + depth + match + 1,
+                      std::min(rest, MAX_PREFIX));
+        }
+        node->prefixLen = rest;
+        addChild(parent, byte, node);
+        attach(parent, new Leaf(key), depth + match);
+        *ref = parent;
+        ++count;
+        return;
+      }
+      depth += node->prefixLen;
+    }
+
+    if (depth == len) {
+      if (node->terminal != nullptr)
+        return;
+      node->terminal = new Leaf(key);
+      ++count;
+      return;
+    }
+    Node **child = findChild(node, bytes[depth]);
+    if (child == nullptr) {
+      addChild(*ref, bytes[depth], tagLeaf(new Leaf(key)));
+      ++count;
+      return;
+    }
+    ref = child;
+    ++depth;
+  }
+}
+
+template <RadixKey Key>
+const Key *AdaptiveRadixTree<Key>::search(const Key &key) const {
+  ScopedLatency<> timer(counters, &TreeStats::searchLatency);
+  SearchPath<> path;
+  const Key *found = find(key, path);
+  recordSearch(counters, path.length());
+  return found;
+}
+
+template <RadixKey Key>
+const Key *AdaptiveRadixTree<Key>::find(const Key &key,
+                                        SearchPath<> &path) const {
+  auto encoded = Traits::encode(key);
+  const unsigned char *bytes = encoded.data();
+  std::size_t len = encoded.size();
+
+  // optimistic: only the stored prefix bytes are compared on the way down,
+  // the comparison with the full key at the end catches the rest
+  const Node *node = root;
+  std::size_t depth = 0;
+  while (node != nullptr) {
+    path.visit();
+    if (isLeaf(node)) {
+      const Leaf *leaf = asLeaf(node);
+      return leaf->key == key ? &leaf->key : nullptr;
+    }
+    if (node->prefixLen > 0) {
+      if (len - depth < node->prefixLen)
+        return nullptr;
+      std::uint32_t stored = std::min(node->prefixLen, MAX_PREFIX);
+      if (std::memcmp(node->prefix, bytes + depth, stored) != 0)
+        return nullptr;
+      depth += node->prefixLen;
+    }
+    if (depth == len) {
+      const Leaf *leaf = node->terminal;
+      if (leaf != nullptr)
+        path.visit();
+      return leaf != nullptr && leaf->key == key ? &leaf->key : nullptr;
+    }
+    Node **child = findChild(const_cast<Node *>(node), bytes[depth]);
+    if (child == nullptr)
+      return nullptr;
+    node = *child;
+    ++depth;
+  }
+  return nullptr;
+}
+
+template <RadixKey Key> void AdaptiveRadixTree<Key>::remove(const Key &key) {
+  ScopedLatency<> timer(counters, &TreeStats::removeLatency);
+  auto encoded = Traits::encode(key);
+  const unsigned char *bytes = encoded.data();
+  std::size_t len = encoded.size();
+
+  if (root == nullptr)
+    return;
+  if (isLeaf(root)) {
+    if (asLeaf(root)->key == key) {
+      delete asLeaf(root);
+      root = nullptr;
+      --count;
+    }
+    return;
+  }
+
+  Node **ref = &root;
+  std::size_t depth = 0;
+  for (;;) {
+    Node *node = *ref;
+    if (node->prefixLen > 0) {
+      if (len - depth < node->prefixLen)
+        return;
+      std::uint32_t stored = std::min(node->prefixLen, MAX_PREFIX);
+      if (std::memcmp(node->prefix, bytes + depth, stored) != 0)
+        return;
+      depth += node->prefixLen;
+    }
+    if (depth == len) {
+      if (node->terminal == nullptr || !(node->terminal->key == key))
+        return;
+      delete node->terminal;
+      node->terminal = nullptr;
+      --count;
+      shrink(*ref);
+      return;
+    }
+    Node **child = findChild(node, bytes[depth]);
+    if (child == nullptr)
+      return;
+    if (isLeaf(*child)) {
+      Leaf *leaf = asLeaf(*child);
+      if (!(leaf->key == key))
+        return;
+      removeChild(node, bytes[depth]);
+      delete leaf;
+      --count;
+      shrink(*ref);
+      return;
+    }
+    ref = child;
+    ++depth;
+  }
+}
+
+template <RadixKey Key> const Key *AdaptiveRadixTree<Key>::minimum() const {
+  return root != nullptr ? &minimumLeaf(root)->key : nullptr;
+}
+
+template <RadixKey Key> const Key *AdaptiveRadixTree<Key>::maximum() const {
+  return root != nullptr ? &maximumLeaf(root)->key : nullptr;
+}
+
+// Fills stack so that advance() returns the keys >= key (> key if strict)
+// in order. Each inner node on key's path leaves a frame positioned after
+// the byte key takes there; the descent stops where the path leaves key.
+template <RadixKey Key>
+void AdaptiveRadixTree<Key>::seek(std::vector<Frame> &stack, const Key &key,
+                                  bool strict) const {
+  auto encoded = Traits::encode(key);
+  const unsigned char *bytes = encoded.data();
+  std::size_t len = encoded.size();
+
+  stack.clear();
+  const Node *node = root;
+  std::size_t depth = 0;
+  while (node != nullptr) {
+    if (isLeaf(node)) {
+      const Key &found = asLeaf(node)->key;
+      if (key < found || (!strict && !(found < key)))
+        stack.push_back({node, 0});
+      return;
+    }
+    if (node->prefixLen > 0) {
+      std::uint32_t match = prefixMismatch(node, bytes, len, depth);
+      if (match < node->prefixLen) {
+        // the whole subtree lies on one side of key; it is above key when
+        // key runs out first or has the smaller byte
+        if (depth + match == len ||
+            bytes[depth + match] < prefixByte(node, depth, match))
+          stack.push_back({node, -1});
+        return;
+      }
+      depth += node->prefixLen;
+    }
+    if (depth == len) {
+      // the terminal leaf is key itself, the children are all above it
+      stack.push_back({node, strict ? 0 : -1});
+      return;
+    }
+    stack.push_back({node, positionAfter(node, bytes[depth])});
+    Node **child = findChild(const_cast<Node *>(node), bytes[depth]);
+    if (child == nullptr)
+      return;
+    node = *child;
+    ++depth;
+  }
+}
+
+template <RadixKey Key>
+const typename AdaptiveRadixTree<Key>::Leaf *
+AdaptiveRadixTree<Key>::advance(std::vector<Frame> &stack) {
+  while (!stack.empty()) {
+    Frame &top = stack.back();
+    if (isLeaf(top.node)) {
+      const Leaf *leaf = asLeaf(top.node);
+      stack.pop_back();
+      return leaf;
+    }
+    if (top.pos < 0) {
+      top.pos = 0;
+      if (top.node->terminal != nullptr)
+        return top.node->terminal;
+    }
+    const Node *child = childFrom(top.node, top.pos);
+    if (child == nullptr)
+      stack.pop_back();
+    else
+      stack.push_back({child, -1});
+  }
+  return nullptr;
+}
+
+template <RadixKey Key>
+const Key *AdaptiveRadixTree<Key>::successor(const Key &key) const {
+  if (search(key) == nullptr)
+    return nullptr; // like BPlusTree, only keys in the tree
+  std::vector<Frame> stack;
+  seek(stack, key, true);
+  const Leaf *leaf = advance(stack);
+  return leaf != nullptr ? &leaf->key : nullptr;
+}
+
+template <RadixKey Key>
+const Key *AdaptiveRadixTree<Key>::lowerBound(const Key &key) const {
+  std::vector<Frame> stack;
+  seek(stack, key, false);
+  const Leaf *leaf = advance(stack);
+  return leaf != nullptr ? &leaf->key : nullptr;
+}
+
+template <RadixKey Key> int AdaptiveRadixTree<Key>::size() const {
+  return count;
+}
+
+template <RadixKey Key> int AdaptiveRadixTree<Key>::height() const {
+  int best = 0;
+  std::vector<std::pair<const Node *, int>> stack;
+  if (root != nullptr)
+    stack.push_back({root, 1});
+  while (!stack.empty()) {
+    auto [node, level] = stack.back();
+    stack.pop_back();
+    best = std::max(best, level);
+    if (isLeaf(node))
+      continue;
+    if (node->terminal != nullptr)
+      best = std::max(best, level + 1);
+    int pos = 0;
+    while (const Node *child = childFrom(node, pos))
+      stack.push_back({child, level + 1});
+  }
+  return best;
+}
+
+template <RadixKey Key> TreeStats AdaptiveRadixTree<Key>::stats() const {
+  TreeStats result = statsOf(counters);
+  result.bytes = sizeof(*this);
+  std::vector<std::pair<const Node *, std::size_t>> stack;
+  if (root != nullptr)
+    stack.push_back({root, 0});
+  while (!stack.empty()) {
+    auto [node, depth] = stack.back();
+    stack.pop_back();
+    countNode(result, depth);
+    if (isLeaf(node)) {
+      result.bytes += sizeof(Leaf);
+      continue;
+    }
+    switch (node->kind) {
+    case Kind::N4:
+      result.bytes += sizeof(Node4);
+      break;
+    case Kind::N16:
+      result.bytes += sizeof(Node16);
+      break;
+    case Kind::N48:
+      result.bytes += sizeof(Node48);
+      break;
+    case Kind::N256:
+      result.bytes += sizeof(Node256);
+      break;
+    }
+    if (node->terminal != nullptr)
+      stack.push_back({tagLeaf(node->terminal), depth + 1});
+    int pos = 0;
+    while (const Node *child = childFrom(node, pos))
+      stack.push_back({child, depth + 1});
+  }
+  return result;
+}
+
+template <RadixKey Key>
+template <typename Visitor>
+void AdaptiveRadixTree<Key>::forEach(Visitor &&visit) const {
+  std::vector<Frame> stack;
+  if (root != nullptr)
+    stack.push_back({root, -1});
+  while (const Leaf *leaf = advance(stack))
+    visit(leaf->key);
+}
+
+template <RadixKey Key>
+template <typename Visitor>
+void AdaptiveRadixTree<Key>::scan(const Key &lo, const Key &hi,
+                                  Visitor &&visit) const {
+  std::vector<Frame> stack;
+  seek(stack, lo, false);
+  while (const Leaf *leaf = advance(stack)) {
+    if (hi < leaf->key)
+      return;
+    visit(leaf->key);
+  }
+}
+
+} // namespace TREE
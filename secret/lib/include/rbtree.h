@@ -1,9 +1,20 @@
 #pragma once
 
+#include "batch.hpp"
+#include "eytzinger.hpp"
+#include "monoid.hpp"
 #include "node.hpp"
+#include "parallel.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
 #include "util.hpp"
+#include <atomic>
 #include <initializer_list>
+#include <optional>
+#include <span>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace RBTREE {
 
@@ -11,20 +22,37 @@ namespace RBTREE {
 //                              Red-Black Trees
 //-------------------------------------------------------------------------------
 
-template <KeyComparble Key> class RedBlackTree {
+// Node types whose links unlocked readers follow while the writer is at
+// work; RedBlackTree publishes their links with release stores.
+template <typename NodeT>
+concept PublishedLinkNode = requires { requires NodeT::PUBLISH_LINKS; };
+
+// Node may be any type laid out like RBTNode. If it is a SummarizedNode,
+// its summary is refreshed wherever a subtree size would be: on the insert
+// path, above a removed node, and in every rotation and join.
+template <KeyComparble Key, typename Node = RBTNode<Key>>
+class RedBlackTree {
 protected:
-  using NodeT = RBTNode<Key>;
-  using Color = typename RBTNode<Key>::Color;
+  using NodeT = Node;
+  using Color = typename Node::Color;
   NodeT *root;
-
-  // Basic BST operations
-  NodeT *insertNode(NodeT *node, int key, NodeT *parent);
+  [[no_unique_address]] mutable TREE::StatsCollector counters; // stats.hpp
+  NodeT *leftmost{nullptr};  // cached minimum()
+  NodeT *rightmost{nullptr}; // cached maximum()
+
+  // Basic BST operations. insertNode finds or adds key in one descent and
+  // returns its node. attachNode links a new node below parent (or as the
+  // root), then restores sizes, summaries and the red-black invariants.
+  NodeT *insertNode(int key);
+  void attachNode(NodeT *parent, bool asLeft, NodeT *node);
   NodeT *searchNode(NodeT *node, int key);
   NodeT *deleteNode(NodeT *root, NodeT *node);
+  void unlinkNode(NodeT *node);
   NodeT *minimumNode(NodeT *node);
   NodeT *maximumNode(NodeT *node);
   NodeT *successorNode(NodeT *node);
   void transplant(NodeT *u, NodeT *v);
+  std::vector<Key> sortedKeys();
 
   // Red-Black Tree specific operations
   void fixInsert(NodeT *node);
@@ -32,75 +60,330 @@ protected:
   NodeT *rotateLeft(NodeT *node);
   NodeT *rotateRight(NodeT *node);
 
+  // Bulk construction
+  template <std::forward_iterator It>
+  NodeT *buildSorted(It &it, It last, int n, int depth, int redDepth,
+                     NodeT *parent);
+  template <std::input_iterator It> void insertRange(It first, It last);
+
+  // Join-based primitives on detached subtrees. Subtree roots may be red;
+  // black heights travel alongside the pointers so no call has to re-walk a
+  // spine. None of them touch this->root, so disjoint subtrees can be
+  // processed on different threads.
+  struct Joined {
+    NodeT *node;
+    int blackHeight;
+  };
+  struct SplitResult {
+    Joined less;
+    NodeT *found; // node holding the split key, or nullptr
+    Joined greater;
+  };
+  int blackHeight(NodeT *node);
+  NodeT *link(NodeT *left, NodeT *node, NodeT *right, Color color);
+  NodeT *joinRight(Joined left, NodeT *node, Joined right);
+  NodeT *joinLeft(Joined left, NodeT *node, Joined right);
+  Joined joinNode(Joined left, NodeT *node, Joined right);
+  Joined joinNode(Joined left, Joined right);
+  SplitResult splitNode(Joined tree, int key);
+  Joined splitLast(Joined tree, NodeT *&last);
+  Joined unionNode(Joined a, Joined b, int depth);
+  Joined intersectNode(Joined a, Joined b, int depth);
+  Joined differenceNode(Joined a, Joined b, int depth);
+  bool shouldFork(Joined a, Joined b, int depth);
+  void adopt(NodeT *node);
+  void destroySubtree(NodeT *node);
+  NodeT *cloneSubtree(const NodeT *node);
+
+  // Every child and root link is written here. Plain stores, unless Node is
+  // a PublishedLinkNode (ConcurrentRedBlackTree): then they are release
+  // stores, so a reader that walks the tree without the writer's lock never
+  // reaches a node whose fields it cannot see yet.
+  static void setLink(NodeT *&link, NodeT *node);
+
+  // Cached extremes
+  void trackInserted(NodeT *node);
+  void trackRemoved(NodeT *node); // before node is unlinked
+  void resetEnds();
+
   // Helper functions
   bool isRed(NodeT *node);
   void setColor(NodeT *node, Color color);
   Color getColor(NodeT *node);
   NodeT *getSibling(NodeT *node);
 
+  // Order-statistic helpers
+  void updateSizeUpward(NodeT *node);
+  int countLess(int key, bool inclusive);
+
 public:
-  virtual ~RedBlackTree() = default;
+  virtual ~RedBlackTree();
 
   // Constructor
   RedBlackTree();
   RedBlackTree(std::initializer_list<int> list);
+  template <std::input_iterator It> RedBlackTree(It first, It last);
   virtual RedBlackTree &operator=(std::initializer_list<int> list);
 
+  // A copy clones the other tree node for node, colours included, in one
+  // preorder pass; a move takes its nodes over in O(1) and leaves it empty.
+  RedBlackTree(const RedBlackTree &other);
+  RedBlackTree(RedBlackTree &&other) noexcept;
+  RedBlackTree &operator=(const RedBlackTree &other);
+  RedBlackTree &operator=(RedBlackTree &&other) noexcept;
+
+  // Frees every node, O(n) with neither recursion nor a stack.
+  virtual void clear();
+
+  // O(n) build of a balanced, correctly coloured tree from a sorted range;
+  // duplicate keys are collapsed. Unsorted input falls back to inserts.
+  template <std::forward_iterator It>
+  static RedBlackTree fromSorted(It first, It last);
+
+  // Join-based bulk operations. join() requires every key of left to be
+  // smaller than key and every key of right to be larger; split() moves the
+  // keys below/above key into less/greater. Both leave the inputs empty.
+  // The set operations consume other and fork their recursive halves onto
+  // PARALLEL::ThreadPool when the subtrees are large.
+  static RedBlackTree join(RedBlackTree &left, int key, RedBlackTree &right);
+  bool split(int key, RedBlackTree &less, RedBlackTree &greater);
+  void unionWith(RedBlackTree &other);
+  void intersectWith(RedBlackTree &other);
+  void differenceWith(RedBlackTree &other);
+  void eraseRange(int lo, int hi);
+
   NodeT *getRoot();
   virtual void insert(int key);
   virtual NodeT *search(int key);
   virtual void remove(int key);
-  NodeT *minimum();
-  NodeT *maximum();
   NodeT *successor(int key);
+
+  // search() for every element of keys into result, with up to
+  // SEARCH_BATCH descents interleaved so their cache misses overlap (see
+  // batch.hpp). Lookups are not recorded in stats().
+  void searchBatch(std::span<const int> keys, std::span<NodeT *> result);
   void printWithoutPrefix(NodeT *node);
   void printWithPrefix(const std::string &prefix, NodeT *node);
+
+  // Double-ended priority queue. The smallest and largest nodes are cached
+  // and kept up to date by insert/remove (rotations never reorder nodes),
+  // so minimum(), maximum() and the peeks are O(1). A pop unlinks a node
+  // with at most one child: O(1) amortized recolouring, at most 3
+  // rotations.
+  NodeT *minimum();
+  NodeT *maximum();
+  std::optional<Key> peekMin();
+  std::optional<Key> peekMax();
+  std::optional<Key> popMin();
+  std::optional<Key> popMax();
+
+  // Order statistics in O(log n), only for trees of sized nodes (see
+  // OrderStatisticRedBlackTree). Sizes are always kept by insert/remove and
+  // the rotations done in fixInsert/fixDelete.
+  void updateSize(NodeT *node);
+  int getSize(NodeT *node) requires SizedNode<Node>;
+  NodeT *select(int k) requires SizedNode<Node>; // k-th smallest, 0-based
+  int rank(int key) requires SizedNode<Node>;    // number of keys < key
+  int countRange(int lo, int hi) requires SizedNode<Node>; // keys in [lo, hi]
+
+  // Monoid summary of the keys in [lo, hi], O(log n). Only for trees of
+  // aggregate nodes, see AggregateRedBlackTree.
+  auto aggregate(int lo, int hi) requires TREE::AggregateNode<Node>;
+
+  // Immutable copy of the keys laid out for fast lookups, O(n).
+  TREE::EytzingerIndex<Key> freeze();
+
+  // Binary snapshot of the keys, see snapshot.hpp. load() replaces the
+  // contents with a verified snapshot, or returns false and leaves the
+  // tree alone if the file is missing, corrupt or holds another key type.
+  // For read-only use, TREE::Snapshot serves the file without loading it.
+  bool save(const std::string &path);
+  bool load(const std::string &path);
+
+  // Operation counters and latencies (TREE_STATS builds) plus the current
+  // depth histogram and footprint, O(n). See stats.hpp.
+  TREE::TreeStats stats();
 };
 
+// Red-black tree whose nodes carry a Monoid summary of their subtree, kept
+// current wherever subtree sizes are.
+template <KeyComparble Key, TREE::KeyMonoid<Key> Monoid>
+using AggregateRedBlackTree = RedBlackTree<Key, AggregateRBTNode<Key, Monoid>>;
+
+// Red-black tree with select / rank / countRange; its nodes carry subtree
+// sizes.
+template <KeyComparble Key>
+using OrderStatisticRedBlackTree = RedBlackTree<Key, SizedRBTNode<Key>>;
+
 //-------------------------------------------------------------------------------
 //                        RedBlackTree Implementation
 //-------------------------------------------------------------------------------
 
-template <KeyComparble Key> RedBlackTree<Key>::RedBlackTree() : root(nullptr) {}
+template <KeyComparble Key, typename Node>
+RedBlackTree<Key, Node>::RedBlackTree() : root(nullptr) {}
 
-template <KeyComparble Key>
-RedBlackTree<Key>::RedBlackTree(std::initializer_list<int> list) {
+template <KeyComparble Key, typename Node>
+RedBlackTree<Key, Node>::RedBlackTree(std::initializer_list<int> list) {
   root = nullptr;
-  for (int key : list) {
-    insert(key);
-  }
+  insertRange(list.begin(), list.end());
 }
 
-template <KeyComparble Key>
-RedBlackTree<Key> &
-RedBlackTree<Key>::operator=(std::initializer_list<int> list) {
-  for (int key : list) {
-    insert(key);
+template <KeyComparble Key, typename Node>
+template <std::input_iterator It>
+RedBlackTree<Key, Node>::RedBlackTree(It first, It last) {
+  root = nullptr;
+  insertRange(first, last);
+}
+
+template <KeyComparble Key, typename Node>
+RedBlackTree<Key, Node> &
+RedBlackTree<Key, Node>::operator=(std::initializer_list<int> list) {
+  insertRange(list.begin(), list.end());
+  return *this;
+}
+
+template <KeyComparble Key, typename Node>
+RedBlackTree<Key, Node>::~RedBlackTree() {
+  destroySubtree(root);
+}
+
+template <KeyComparble Key, typename Node>
+RedBlackTree<Key, Node>::RedBlackTree(const RedBlackTree &other)
+    : root(cloneSubtree(other.root)), counters(other.counters) {
+  resetEnds();
+}
+
+template <KeyComparble Key, typename Node>
+RedBlackTree<Key, Node>::RedBlackTree(RedBlackTree &&other) noexcept
+    : root(std::exchange(other.root, nullptr)), counters(other.counters),
+      leftmost(std::exchange(other.leftmost, nullptr)),
+      rightmost(std::exchange(other.rightmost, nullptr)) {}
+
+template <KeyComparble Key, typename Node>
+RedBlackTree<Key, Node> &
+RedBlackTree<Key, Node>::operator=(const RedBlackTree &other) {
+  if (this != &other) {
+    NodeT *copy = cloneSubtree(other.root);
+    destroySubtree(root);
+    adopt(copy);
+    counters = other.counters;
   }
   return *this;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::insertNode(NodeT *node, int key,
-                                            NodeT *parent) {
-  if (node == nullptr) {
-    NodeT *newNode = new NodeT(key);
-    newNode->parent = parent;
-    newNode->color = Color::RED; // New nodes are always red
-    return newNode;
+template <KeyComparble Key, typename Node>
+RedBlackTree<Key, Node> &
+RedBlackTree<Key, Node>::operator=(RedBlackTree &&other) noexcept {
+  if (this != &other) {
+    destroySubtree(root);
+    root = std::exchange(other.root, nullptr);
+    counters = other.counters;
+    leftmost = std::exchange(other.leftmost, nullptr);
+    rightmost = std::exchange(other.rightmost, nullptr);
   }
+  return *this;
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::clear() {
+  destroySubtree(root);
+  adopt(nullptr);
+}
 
-  if (key < node->key) {
-    node->left = insertNode(node->left, key, node);
-  } else if (key > node->key) {
-    node->right = insertNode(node->right, key, node);
+template <KeyComparble Key, typename Node>
+template <std::forward_iterator It>
+RedBlackTree<Key, Node> RedBlackTree<Key, Node>::fromSorted(It first, It last) {
+  return RedBlackTree(first, last);
+}
+
+template <KeyComparble Key, typename Node>
+template <std::input_iterator It>
+void RedBlackTree<Key, Node>::insertRange(It first, It last) {
+  if constexpr (std::forward_iterator<It>) {
+    if (root == nullptr) {
+      int n = sortedDistinctCount(first, last);
+      if (n >= 0) {
+        // every level but the last is full; colouring the last level red
+        // gives all root-to-leaf paths the same number of black nodes
+        int redDepth = 0;
+        while ((2 << redDepth) <= n)
+          ++redDepth;
+        root = buildSorted(first, last, n, 0, redDepth, nullptr);
+        resetEnds();
+        return;
+      }
+    }
   }
+  for (; first != last; ++first)
+    insert(*first);
+}
+
+template <KeyComparble Key, typename Node>
+template <std::forward_iterator It>
+Node *RedBlackTree<Key, Node>::buildSorted(It &it, It last, int n,
+                                           int depth, int redDepth,
+                                           NodeT *parent) {
+  if (n <= 0)
+    return nullptr;
+
+  int leftCount = (n - 1) / 2;
+  NodeT *left = buildSorted(it, last, leftCount, depth + 1, redDepth, nullptr);
 
+  NodeT *node = new NodeT(*it);
+  for (++it; it != last && *it == node->key; ++it) {
+    // skip duplicates of the key just taken
+  }
+  node->parent = parent;
+  node->color = (depth > 0 && depth == redDepth) ? Color::RED : Color::BLACK;
+  node->left = left;
+  if (left)
+    left->parent = node;
+  node->right =
+      buildSorted(it, last, n - 1 - leftCount, depth + 1, redDepth, node);
+  if constexpr (SizedNode<Node>)
+    node->size = n;
+  if constexpr (SummarizedNode<Node>)
+    node->updateSummary();
   return node;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::searchNode(NodeT *node, int key) {
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::insertNode(int key) {
+  NodeT *parent = nullptr;
+  NodeT *node = root;
+  while (node != nullptr) {
+    parent = node;
+    if (key < node->key)
+      node = node->left;
+    else if (key > node->key)
+      node = node->right;
+    else
+      return node; // duplicates are ignored, an existing node is not re-fixed
+  }
+
+  NodeT *newNode = new NodeT(key); // new nodes are always red
+  attachNode(parent, parent != nullptr && key < parent->key, newNode);
+  trackInserted(newNode);
+  return newNode;
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::attachNode(NodeT *parent, bool asLeft,
+                                         NodeT *node) {
+  node->parent = parent;
+  if (parent == nullptr)
+    setLink(root, node);
+  else if (asLeft)
+    setLink(parent->left, node);
+  else
+    setLink(parent->right, node);
+
+  updateSizeUpward(parent);
+  fixInsert(node);
+}
+
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::searchNode(NodeT *node, int key) {
   if (node == nullptr || node->key == key) {
     return node;
   }
@@ -110,14 +393,14 @@ RBTNode<Key> *RedBlackTree<Key>::searchNode(NodeT *node, int key) {
     return searchNode(node->right, key);
 }
 
-template <KeyComparble Key>
-void RedBlackTree<Key>::transplant(NodeT *u, NodeT *v) {
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::transplant(NodeT *u, NodeT *v) {
   if (u->parent == nullptr) {
-    root = v;
+    setLink(root, v);
   } else if (u == u->parent->left) {
-    u->parent->left = v;
+    setLink(u->parent->left, v);
   } else {
-    u->parent->right = v;
+    setLink(u->parent->right, v);
   }
 
   if (v != nullptr) {
@@ -125,12 +408,20 @@ void RedBlackTree<Key>::transplant(NodeT *u, NodeT *v) {
   }
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::deleteNode(NodeT *root, NodeT *node) {
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::deleteNode(NodeT *root, NodeT *node) {
   if (node == nullptr) {
     return root;
   }
 
+  unlinkNode(node);
+  delete node;
+  return this->root;
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::unlinkNode(NodeT *node) {
+  trackRemoved(node);
   NodeT *toDelete = node;
   NodeT *replacement = nullptr;
   Color originalColor = toDelete->color;
@@ -138,6 +429,7 @@ RBTNode<Key> *RedBlackTree<Key>::deleteNode(NodeT *root, NodeT *node) {
   if (node->left == nullptr) {
     replacement = node->right;
     transplant(node, node->right);
+    updateSizeUpward(node->parent);
     if (originalColor == Color::BLACK && replacement != nullptr) {
       fixDelete(replacement, replacement->parent);
     } else if (originalColor == Color::BLACK && replacement == nullptr) {
@@ -146,6 +438,7 @@ RBTNode<Key> *RedBlackTree<Key>::deleteNode(NodeT *root, NodeT *node) {
   } else if (node->right == nullptr) {
     replacement = node->left;
     transplant(node, node->left);
+    updateSizeUpward(node->parent);
     if (originalColor == Color::BLACK && replacement != nullptr) {
       fixDelete(replacement, replacement->parent);
     } else if (originalColor == Color::BLACK && replacement == nullptr) {
@@ -160,7 +453,7 @@ RBTNode<Key> *RedBlackTree<Key>::deleteNode(NodeT *root, NodeT *node) {
     if (toDelete->parent != node) {
       replacementParent = toDelete->parent;
       transplant(toDelete, toDelete->right);
-      toDelete->right = node->right;
+      setLink(toDelete->right, node->right);
       toDelete->right->parent = toDelete;
     } else {
       if (replacement != nullptr) {
@@ -169,35 +462,33 @@ RBTNode<Key> *RedBlackTree<Key>::deleteNode(NodeT *root, NodeT *node) {
     }
 
     transplant(node, toDelete);
-    toDelete->left = node->left;
+    setLink(toDelete->left, node->left);
     toDelete->left->parent = toDelete;
     toDelete->color = node->color;
+    updateSizeUpward(replacementParent);
 
     if (originalColor == Color::BLACK) {
       fixDelete(replacement, replacementParent);
     }
   }
-
-  delete node;
-  return this->root;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::minimumNode(NodeT *node) {
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::minimumNode(NodeT *node) {
   while (node->left != nullptr)
     node = node->left;
   return node;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::maximumNode(NodeT *node) {
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::maximumNode(NodeT *node) {
   while (node->right != nullptr)
     node = node->right;
   return node;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::successorNode(NodeT *node) {
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::successorNode(NodeT *node) {
   if (node == nullptr)
     return nullptr;
 
@@ -215,14 +506,15 @@ RBTNode<Key> *RedBlackTree<Key>::successorNode(NodeT *node) {
   return parent;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::rotateLeft(NodeT *z) {
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::rotateLeft(NodeT *z) {
   NodeT *y = z->right;
   NodeT *T2 = y->left;
+  TREE::countStat(counters, &TREE::TreeStats::rotations);
 
   // Perform rotation
-  y->left = z;
-  z->right = T2;
+  setLink(z->right, T2);
+  setLink(y->left, z);
 
   // Update parents
   y->parent = z->parent;
@@ -232,24 +524,27 @@ RBTNode<Key> *RedBlackTree<Key>::rotateLeft(NodeT *z) {
 
   // Update parent's pointer to this subtree
   if (y->parent == nullptr) {
-    root = y;
+    setLink(root, y);
   } else if (y->parent->left == z) {
-    y->parent->left = y;
+    setLink(y->parent->left, y);
   } else {
-    y->parent->right = y;
+    setLink(y->parent->right, y);
   }
 
+  updateSize(z);
+  updateSize(y);
   return y;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::rotateRight(NodeT *z) {
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::rotateRight(NodeT *z) {
   NodeT *y = z->left;
   NodeT *T3 = y->right;
+  TREE::countStat(counters, &TREE::TreeStats::rotations);
 
   // Perform rotation
-  y->right = z;
-  z->left = T3;
+  setLink(z->left, T3);
+  setLink(y->right, z);
 
   // Update parents
   y->parent = z->parent;
@@ -259,17 +554,20 @@ RBTNode<Key> *RedBlackTree<Key>::rotateRight(NodeT *z) {
 
   // Update parent's pointer to this subtree
   if (y->parent == nullptr) {
-    root = y;
+    setLink(root, y);
   } else if (y->parent->left == z) {
-    y->parent->left = y;
+    setLink(y->parent->left, y);
   } else {
-    y->parent->right = y;
+    setLink(y->parent->right, y);
   }
 
+  updateSize(z);
+  updateSize(y);
   return y;
 }
 
-template <KeyComparble Key> void RedBlackTree<Key>::fixInsert(NodeT *node) {
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::fixInsert(NodeT *node) {
   while (node != root && isRed(node->parent)) {
     if (node->parent == node->parent->parent->left) {
       // Parent is left child
@@ -277,6 +575,7 @@ template <KeyComparble Key> void RedBlackTree<Key>::fixInsert(NodeT *node) {
 
       if (isRed(uncle)) {
         // Case 1: Uncle is red - recolor
+        TREE::countFixup(counters, &TREE::TreeStats::insertFixups, 1);
         setColor(node->parent, Color::BLACK);
         setColor(uncle, Color::BLACK);
         setColor(node->parent->parent, Color::RED);
@@ -284,10 +583,15 @@ template <KeyComparble Key> void RedBlackTree<Key>::fixInsert(NodeT *node) {
       } else {
         if (node == node->parent->right) {
           // Case 2: Node is right child - left rotate
+          TREE::countFixup(counters, &TREE::TreeStats::insertFixups, 2);
+          TREE::countStat(counters, &TREE::TreeStats::rotationsLR);
           node = node->parent;
           rotateLeft(node);
+        } else {
+          TREE::countStat(counters, &TREE::TreeStats::rotationsLL);
         }
         // Case 3: Node is left child - right rotate and recolor
+        TREE::countFixup(counters, &TREE::TreeStats::insertFixups, 3);
         setColor(node->parent, Color::BLACK);
         setColor(node->parent->parent, Color::RED);
         rotateRight(node->parent->parent);
@@ -298,6 +602,7 @@ template <KeyComparble Key> void RedBlackTree<Key>::fixInsert(NodeT *node) {
 
       if (isRed(uncle)) {
         // Case 1: Uncle is red - recolor
+        TREE::countFixup(counters, &TREE::TreeStats::insertFixups, 1);
         setColor(node->parent, Color::BLACK);
         setColor(uncle, Color::BLACK);
         setColor(node->parent->parent, Color::RED);
@@ -305,10 +610,15 @@ template <KeyComparble Key> void RedBlackTree<Key>::fixInsert(NodeT *node) {
       } else {
         if (node == node->parent->left) {
           // Case 2: Node is left child - right rotate
+          TREE::countFixup(counters, &TREE::TreeStats::insertFixups, 2);
+          TREE::countStat(counters, &TREE::TreeStats::rotationsRL);
           node = node->parent;
           rotateRight(node);
+        } else {
+          TREE::countStat(counters, &TREE::TreeStats::rotationsRR);
         }
         // Case 3: Node is right child - left rotate and recolor
+        TREE::countFixup(counters, &TREE::TreeStats::insertFixups, 3);
         setColor(node->parent, Color::BLACK);
         setColor(node->parent->parent, Color::RED);
         rotateLeft(node->parent->parent);
@@ -318,14 +628,15 @@ template <KeyComparble Key> void RedBlackTree<Key>::fixInsert(NodeT *node) {
   setColor(root, Color::BLACK);
 }
 
-template <KeyComparble Key>
-void RedBlackTree<Key>::fixDelete(NodeT *node, NodeT *parent) {
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::fixDelete(NodeT *node, NodeT *parent) {
   while (node != root && getColor(node) == Color::BLACK) {
     if (node == (parent ? parent->left : nullptr)) {
       NodeT *sibling = parent ? parent->right : nullptr;
 
       if (isRed(sibling)) {
         // Case 1: Sibling is red
+        TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 1);
         setColor(sibling, Color::BLACK);
         setColor(parent, Color::RED);
         rotateLeft(parent);
@@ -335,18 +646,21 @@ void RedBlackTree<Key>::fixDelete(NodeT *node, NodeT *parent) {
       if (getColor(sibling ? sibling->left : nullptr) == Color::BLACK &&
           getColor(sibling ? sibling->right : nullptr) == Color::BLACK) {
         // Case 2: Sibling's children are both black
+        TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 2);
         setColor(sibling, Color::RED);
         node = parent;
         parent = node ? node->parent : nullptr;
       } else {
         if (getColor(sibling ? sibling->right : nullptr) == Color::BLACK) {
           // Case 3: Sibling's right child is black
+          TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 3);
           setColor(sibling->left, Color::BLACK);
           setColor(sibling, Color::RED);
           rotateRight(sibling);
           sibling = parent->right;
         }
         // Case 4: Sibling's right child is red
+        TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 4);
         setColor(sibling, getColor(parent));
         setColor(parent, Color::BLACK);
         setColor(sibling->right, Color::BLACK);
@@ -359,6 +673,7 @@ void RedBlackTree<Key>::fixDelete(NodeT *node, NodeT *parent) {
       NodeT *sibling = parent ? parent->left : nullptr;
 
       if (isRed(sibling)) {
+        TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 1);
         setColor(sibling, Color::BLACK);
         setColor(parent, Color::RED);
         rotateRight(parent);
@@ -367,16 +682,19 @@ void RedBlackTree<Key>::fixDelete(NodeT *node, NodeT *parent) {
 
       if (getColor(sibling ? sibling->right : nullptr) == Color::BLACK &&
           getColor(sibling ? sibling->left : nullptr) == Color::BLACK) {
+        TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 2);
         setColor(sibling, Color::RED);
         node = parent;
         parent = node ? node->parent : nullptr;
       } else {
         if (getColor(sibling ? sibling->left : nullptr) == Color::BLACK) {
+          TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 3);
           setColor(sibling->right, Color::BLACK);
           setColor(sibling, Color::RED);
           rotateLeft(sibling);
           sibling = parent->left;
         }
+        TREE::countFixup(counters, &TREE::TreeStats::deleteFixups, 4);
         setColor(sibling, getColor(parent));
         setColor(parent, Color::BLACK);
         setColor(sibling->left, Color::BLACK);
@@ -389,24 +707,36 @@ void RedBlackTree<Key>::fixDelete(NodeT *node, NodeT *parent) {
   setColor(node, Color::BLACK);
 }
 
-template <KeyComparble Key> bool RedBlackTree<Key>::isRed(NodeT *node) {
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::setLink(NodeT *&link, NodeT *node) {
+  if constexpr (PublishedLinkNode<Node>)
+    std::atomic_ref<NodeT *>(link).store(node, std::memory_order_release);
+  else
+    link = node;
+}
+
+template <KeyComparble Key, typename Node>
+bool RedBlackTree<Key, Node>::isRed(NodeT *node) {
   return node != nullptr && node->color == Color::RED;
 }
 
-template <KeyComparble Key>
-void RedBlackTree<Key>::setColor(NodeT *node, Color color) {
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::setColor(NodeT *node, Color color) {
   if (node != nullptr) {
+    if (node->color != color)
+      TREE::countStat(counters, &TREE::TreeStats::recolors);
     node->color = color;
   }
 }
 
-template <KeyComparble Key>
-typename RedBlackTree<Key>::Color RedBlackTree<Key>::getColor(NodeT *node) {
+template <KeyComparble Key, typename Node>
+typename RedBlackTree<Key, Node>::Color
+RedBlackTree<Key, Node>::getColor(NodeT *node) {
   return node ? node->color : Color::BLACK;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::getSibling(NodeT *node) {
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::getSibling(NodeT *node) {
   if (node == nullptr || node->parent == nullptr)
     return nullptr;
 
@@ -416,54 +746,617 @@ RBTNode<Key> *RedBlackTree<Key>::getSibling(NodeT *node) {
     return node->parent->left;
 }
 
-template <KeyComparble Key> RBTNode<Key> *RedBlackTree<Key>::getRoot() {
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::getRoot() {
   return root;
 }
 
-template <KeyComparble Key> void RedBlackTree<Key>::insert(int key) {
-  root = insertNode(root, key, nullptr);
-
-  // Find the newly inserted node
-  NodeT *newNode = searchNode(root, key);
-  if (newNode) {
-    fixInsert(newNode);
-  }
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::insert(int key) {
+  TREE::ScopedLatency<> timer(counters, &TREE::TreeStats::insertLatency);
+  insertNode(key);
 }
 
-template <KeyComparble Key> RBTNode<Key> *RedBlackTree<Key>::search(int key) {
-  return searchNode(root, key);
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::search(int key) {
+  TREE::ScopedLatency<> timer(counters, &TREE::TreeStats::searchLatency);
+  return TREE::searchCounted(counters, root, key);
 }
 
-template <KeyComparble Key> void RedBlackTree<Key>::remove(int key) {
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::remove(int key) {
+  TREE::ScopedLatency<> timer(counters, &TREE::TreeStats::removeLatency);
   NodeT *node = searchNode(root, key);
   if (node) {
     deleteNode(root, node);
   }
 }
 
-template <KeyComparble Key> RBTNode<Key> *RedBlackTree<Key>::minimum() {
-  return minimumNode(root);
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::minimum() {
+  return leftmost;
 }
 
-template <KeyComparble Key> RBTNode<Key> *RedBlackTree<Key>::maximum() {
-  return maximumNode(root);
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::maximum() {
+  return rightmost;
 }
 
-template <KeyComparble Key>
-RBTNode<Key> *RedBlackTree<Key>::successor(int key) {
+template <KeyComparble Key, typename Node>
+std::optional<Key> RedBlackTree<Key, Node>::peekMin() {
+  return leftmost ? std::optional<Key>(leftmost->key) : std::nullopt;
+}
+
+template <KeyComparble Key, typename Node>
+std::optional<Key> RedBlackTree<Key, Node>::peekMax() {
+  return rightmost ? std::optional<Key>(rightmost->key) : std::nullopt;
+}
+
+template <KeyComparble Key, typename Node>
+std::optional<Key> RedBlackTree<Key, Node>::popMin() {
+  if (leftmost == nullptr)
+    return std::nullopt;
+  Key key = leftmost->key;
+  deleteNode(root, leftmost);
+  return key;
+}
+
+template <KeyComparble Key, typename Node>
+std::optional<Key> RedBlackTree<Key, Node>::popMax() {
+  if (rightmost == nullptr)
+    return std::nullopt;
+  Key key = rightmost->key;
+  deleteNode(root, rightmost);
+  return key;
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::trackInserted(NodeT *node) {
+  if (leftmost == nullptr || node->key < leftmost->key)
+    leftmost = node;
+  if (rightmost == nullptr || rightmost->key < node->key)
+    rightmost = node;
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::trackRemoved(NodeT *node) {
+  // the extremes have at most one child: the next one in line is the
+  // nearest key in that child's subtree, or else the parent
+  if (node == leftmost)
+    leftmost = node->right ? minimumNode(node->right) : node->parent;
+  if (node == rightmost)
+    rightmost = node->left ? maximumNode(node->left) : node->parent;
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::resetEnds() {
+  leftmost = root ? minimumNode(root) : nullptr;
+  rightmost = root ? maximumNode(root) : nullptr;
+}
+
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::successor(int key) {
   NodeT *node = search(key);
   return successorNode(node);
 }
 
-template <KeyComparble Key>
-void RedBlackTree<Key>::printWithoutPrefix(NodeT *node) {
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::searchBatch(std::span<const int> keys,
+                                          std::span<NodeT *> result) {
+  TREE::searchBatch(root, keys, result);
+}
+
+template <KeyComparble Key, typename Node>
+std::vector<Key> RedBlackTree<Key, Node>::sortedKeys() {
+  // successorNode() returns the maximum itself, walk with a stack instead
+  std::vector<Key> keys;
+  std::vector<NodeT *> stack;
+  NodeT *node = root;
+  while (node != nullptr || !stack.empty()) {
+    for (; node != nullptr; node = node->left)
+      stack.push_back(node);
+    node = stack.back();
+    stack.pop_back();
+    keys.push_back(node->key);
+    node = node->right;
+  }
+  return keys;
+}
+
+template <KeyComparble Key, typename Node>
+TREE::EytzingerIndex<Key> RedBlackTree<Key, Node>::freeze() {
+  std::vector<Key> keys = sortedKeys();
+  return TREE::EytzingerIndex<Key>(keys.begin(), keys.end());
+}
+
+template <KeyComparble Key, typename Node>
+TREE::TreeStats RedBlackTree<Key, Node>::stats() {
+  TREE::TreeStats result = TREE::statsOf(counters);
+  TREE::collectShape(root, sizeof(*this), result);
+  return result;
+}
+
+template <KeyComparble Key, typename Node>
+bool RedBlackTree<Key, Node>::save(const std::string &path) {
+  std::vector<Key> keys = sortedKeys();
+  return TREE::saveSnapshot<Key>(path, keys.begin(), keys.end());
+}
+
+template <KeyComparble Key, typename Node>
+bool RedBlackTree<Key, Node>::load(const std::string &path) {
+  TREE::Snapshot<Key> snapshot;
+  if (!snapshot.open(path) || !snapshot.verify())
+    return false;
+
+  std::vector<Key> keys;
+  keys.reserve(snapshot.size());
+  snapshot.forEach([&](const Key &key) { keys.push_back(key); });
+
+  destroySubtree(root);
+  adopt(nullptr);
+  insertRange(keys.begin(), keys.end());
+  return true;
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::printWithoutPrefix(NodeT *node) {
   printTree("", node, false);
 }
 
-template <KeyComparble Key>
-void RedBlackTree<Key>::printWithPrefix(const std::string &prefix,
-                                        NodeT *node) {
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::printWithPrefix(const std::string &prefix,
+                                              NodeT *node) {
   printTree(prefix, node, false);
 }
 
+template <KeyComparble Key, typename Node>
+int RedBlackTree<Key, Node>::blackHeight(NodeT *node) {
+  int height = 0;
+  for (; node != nullptr; node = node->left)
+    if (!isRed(node))
+      ++height;
+  return height;
+}
+
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::link(NodeT *left, NodeT *node, NodeT *right,
+                                    Color color) {
+  node->left = left;
+  node->right = right;
+  node->parent = nullptr;
+  node->color = color;
+  if (left)
+    left->parent = node;
+  if (right)
+    right->parent = node;
+  updateSize(node);
+  return node;
+}
+
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::joinRight(Joined left, NodeT *node,
+                                         Joined right) {
+  // left has the larger black height: walk down its right spine to a black
+  // node of matching height, hang node there red and repair red-red pairs
+  // on the way back up. The result keeps left's black height.
+  if (left.blackHeight == right.blackHeight && !isRed(left.node))
+    return link(left.node, node, right.node, Color::RED);
+
+  NodeT *t = left.node;
+  Joined child{t->right, left.blackHeight - (isRed(t) ? 0 : 1)};
+  NodeT *joined = link(t->left, t, joinRight(child, node, right), t->color);
+
+  if (!isRed(joined) && isRed(joined->right) &&
+      isRed(joined->right->right)) {
+    NodeT *y = joined->right;
+    y->right->color = Color::BLACK;
+    return link(link(joined->left, joined, y->left, joined->color), y,
+                y->right, y->color);
+  }
+  return joined;
+}
+
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::joinLeft(Joined left, NodeT *node,
+                                        Joined right) {
+  // mirror of joinRight, right has the larger black height
+  if (left.blackHeight == right.blackHeight && !isRed(right.node))
+    return link(left.node, node, right.node, Color::RED);
+
+  NodeT *t = right.node;
+  Joined child{t->left, right.blackHeight - (isRed(t) ? 0 : 1)};
+  NodeT *joined = link(joinLeft(left, node, child), t, t->right, t->color);
+
+  if (!isRed(joined) && isRed(joined->left) && isRed(joined->left->left)) {
+    NodeT *y = joined->left;
+    y->left->color = Color::BLACK;
+    return link(y->left, y,
+                link(y->right, joined, joined->right, joined->color),
+                y->color);
+  }
+  return joined;
+}
+
+template <KeyComparble Key, typename Node>
+typename RedBlackTree<Key, Node>::Joined
+RedBlackTree<Key, Node>::joinNode(Joined left, NodeT *node, Joined right) {
+  if (left.blackHeight > right.blackHeight) {
+    NodeT *t = joinRight(left, node, right);
+    if (isRed(t) && isRed(t->right)) {
+      t->color = Color::BLACK;
+      return {t, left.blackHeight + 1};
+    }
+    return {t, left.blackHeight};
+  }
+  if (right.blackHeight > left.blackHeight) {
+    NodeT *t = joinLeft(left, node, right);
+    if (isRed(t) && isRed(t->left)) {
+      t->color = Color::BLACK;
+      return {t, right.blackHeight + 1};
+    }
+    return {t, right.blackHeight};
+  }
+  if (!isRed(left.node) && !isRed(right.node))
+    return {link(left.node, node, right.node, Color::RED), left.blackHeight};
+  return {link(left.node, node, right.node, Color::BLACK),
+          left.blackHeight + 1};
+}
+
+template <KeyComparble Key, typename Node>
+typename RedBlackTree<Key, Node>::Joined
+RedBlackTree<Key, Node>::joinNode(Joined left, Joined right) {
+  if (left.node == nullptr)
+    return right;
+  NodeT *last = nullptr;
+  Joined rest = splitLast(left, last);
+  return joinNode(rest, last, right);
+}
+
+template <KeyComparble Key, typename Node>
+typename RedBlackTree<Key, Node>::SplitResult
+RedBlackTree<Key, Node>::splitNode(Joined tree, int key) {
+  NodeT *t = tree.node;
+  if (t == nullptr)
+    return {{nullptr, 0}, nullptr, {nullptr, 0}};
+
+  int childHeight = tree.blackHeight - (isRed(t) ? 0 : 1);
+  Joined l{t->left, childHeight};
+  Joined r{t->right, childHeight};
+  if (key == t->key) {
+    t->left = t->right = t->parent = nullptr;
+    return {l, t, r};
+  }
+  if (key < t->key) {
+    SplitResult s = splitNode(l, key);
+    return {s.less, s.found, joinNode(s.greater, t, r)};
+  }
+  SplitResult s = splitNode(r, key);
+  return {joinNode(l, t, s.less), s.found, s.greater};
+}
+
+template <KeyComparble Key, typename Node>
+typename RedBlackTree<Key, Node>::Joined
+RedBlackTree<Key, Node>::splitLast(Joined tree, NodeT *&last) {
+  NodeT *t = tree.node;
+  Joined l{t->left, tree.blackHeight - (isRed(t) ? 0 : 1)};
+  if (t->right == nullptr) {
+    last = t;
+    t->left = t->parent = nullptr;
+    return l;
+  }
+  Joined rest = splitLast({t->right, l.blackHeight}, last);
+  return joinNode(l, t, rest);
+}
+
+template <KeyComparble Key, typename Node>
+bool RedBlackTree<Key, Node>::shouldFork(Joined a, Joined b, int depth) {
+  // below ~10^4 nodes a task costs more than it saves
+  return depth < PARALLEL::forkDepth() &&
+         std::min(a.blackHeight, b.blackHeight) >= 8;
+}
+
+template <KeyComparble Key, typename Node>
+typename RedBlackTree<Key, Node>::Joined
+RedBlackTree<Key, Node>::unionNode(Joined a, Joined b, int depth) {
+  if (a.node == nullptr)
+    return b;
+  if (b.node == nullptr)
+    return a;
+
+  NodeT *t = a.node;
+  int childHeight = a.blackHeight - (isRed(t) ? 0 : 1);
+  Joined al{t->left, childHeight};
+  Joined ar{t->right, childHeight};
+  bool fork = shouldFork(a, b, depth); // before split frees anything
+  SplitResult s = splitNode(b, t->key);
+  delete s.found;
+
+  Joined l{nullptr, 0};
+  Joined r{nullptr, 0};
+  if (fork) {
+    PARALLEL::forkJoin([&] { l = unionNode(al, s.less, depth + 1); },
+                       [&] { r = unionNode(ar, s.greater, depth + 1); });
+  } else {
+    l = unionNode(al, s.less, depth + 1);
+    r = unionNode(ar, s.greater, depth + 1);
+  }
+  return joinNode(l, t, r);
+}
+
+template <KeyComparble Key, typename Node>
+typename RedBlackTree<Key, Node>::Joined
+RedBlackTree<Key, Node>::intersectNode(Joined a, Joined b, int depth) {
+  if (a.node == nullptr || b.node == nullptr) {
+    destroySubtree(a.node);
+    destroySubtree(b.node);
+    return {nullptr, 0};
+  }
+
+  NodeT *t = a.node;
+  int childHeight = a.blackHeight - (isRed(t) ? 0 : 1);
+  Joined al{t->left, childHeight};
+  Joined ar{t->right, childHeight};
+  bool fork = shouldFork(a, b, depth); // before split frees anything
+  SplitResult s = splitNode(b, t->key);
+
+  Joined l{nullptr, 0};
+  Joined r{nullptr, 0};
+  if (fork) {
+    PARALLEL::forkJoin([&] { l = intersectNode(al, s.less, depth + 1); },
+                       [&] { r = intersectNode(ar, s.greater, depth + 1); });
+  } else {
+    l = intersectNode(al, s.less, depth + 1);
+    r = intersectNode(ar, s.greater, depth + 1);
+  }
+
+  if (s.found) {
+    delete s.found;
+    return joinNode(l, t, r);
+  }
+  delete t;
+  return joinNode(l, r);
+}
+
+template <KeyComparble Key, typename Node>
+typename RedBlackTree<Key, Node>::Joined
+RedBlackTree<Key, Node>::differenceNode(Joined a, Joined b, int depth) {
+  if (a.node == nullptr || b.node == nullptr) {
+    destroySubtree(b.node);
+    return a;
+  }
+
+  NodeT *t = b.node;
+  int childHeight = b.blackHeight - (isRed(t) ? 0 : 1);
+  Joined bl{t->left, childHeight};
+  Joined br{t->right, childHeight};
+  bool fork = shouldFork(a, b, depth); // before split frees anything
+  SplitResult s = splitNode(a, t->key);
+  delete s.found;
+
+  Joined l{nullptr, 0};
+  Joined r{nullptr, 0};
+  if (fork) {
+    PARALLEL::forkJoin([&] { l = differenceNode(s.less, bl, depth + 1); },
+                       [&] { r = differenceNode(s.greater, br, depth + 1); });
+  } else {
+    l = differenceNode(s.less, bl, depth + 1);
+    r = differenceNode(s.greater, br, depth + 1);
+  }
+  delete t;
+  return joinNode(l, r);
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::adopt(NodeT *node) {
+  root = node;
+  if (node) {
+    node->parent = nullptr;
+    node->color = Color::BLACK;
+  }
+  resetEnds();
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::destroySubtree(NodeT *node) {
+  // rotate left children up until node has none, then free it and carry on
+  // to the right; no stack needed
+  while (node != nullptr) {
+    if (NodeT *left = node->left) {
+      node->left = left->right;
+      left->right = node;
+      node = left;
+    } else {
+      NodeT *right = node->right;
+      delete node;
+      node = right;
+    }
+  }
+}
+
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::cloneSubtree(const NodeT *node) {
+  // preorder, so the copies are allocated in the order searches meet them
+  struct Pending {
+    const NodeT *source;
+    NodeT *parent;
+    NodeT **link;
+  };
+  NodeT *copy = nullptr;
+  std::vector<Pending> stack;
+  if (node)
+    stack.push_back({node, nullptr, &copy});
+  while (!stack.empty()) {
+    Pending next = stack.back();
+    stack.pop_back();
+    NodeT *clone = cloneNode(*next.source);
+    clone->parent = next.parent;
+    *next.link = clone;
+    if (next.source->right)
+      stack.push_back({next.source->right, clone, &clone->right});
+    if (next.source->left)
+      stack.push_back({next.source->left, clone, &clone->left});
+  }
+  return copy;
+}
+
+template <KeyComparble Key, typename Node>
+RedBlackTree<Key, Node>
+RedBlackTree<Key, Node>::join(RedBlackTree &left, int key,
+                              RedBlackTree &right) {
+  RedBlackTree result;
+  Joined l{left.root, left.blackHeight(left.root)};
+  Joined r{right.root, right.blackHeight(right.root)};
+  result.adopt(left.joinNode(l, new NodeT(key), r).node);
+  left.adopt(nullptr);
+  right.adopt(nullptr);
+  return result;
+}
+
+template <KeyComparble Key, typename Node>
+bool RedBlackTree<Key, Node>::split(int key, RedBlackTree &less,
+                                    RedBlackTree &greater) {
+  SplitResult s = splitNode({root, blackHeight(root)}, key);
+  adopt(nullptr);
+
+  destroySubtree(less.root);
+  destroySubtree(greater.root);
+  less.adopt(s.less.node);
+  greater.adopt(s.greater.node);
+
+  bool found = s.found != nullptr;
+  delete s.found;
+  return found;
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::unionWith(RedBlackTree &other) {
+  if (this == &other)
+    return;
+  adopt(unionNode({root, blackHeight(root)},
+                  {other.root, blackHeight(other.root)}, 0)
+            .node);
+  other.adopt(nullptr);
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::intersectWith(RedBlackTree &other) {
+  if (this == &other)
+    return;
+  adopt(intersectNode({root, blackHeight(root)},
+                      {other.root, blackHeight(other.root)}, 0)
+            .node);
+  other.adopt(nullptr);
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::differenceWith(RedBlackTree &other) {
+  if (this == &other) {
+    destroySubtree(root);
+    adopt(nullptr);
+    return;
+  }
+  adopt(differenceNode({root, blackHeight(root)},
+                       {other.root, blackHeight(other.root)}, 0)
+            .node);
+  other.adopt(nullptr);
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::eraseRange(int lo, int hi) {
+  if (hi < lo)
+    return;
+  // root = [< lo] + [lo, hi] + [> hi]; drop the middle, join the rest
+  SplitResult low = splitNode({root, blackHeight(root)}, lo);
+  SplitResult high = splitNode(low.greater, hi);
+  delete low.found;
+  delete high.found;
+  destroySubtree(high.less.node);
+  adopt(joinNode(low.less, high.greater).node);
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::updateSizeUpward(NodeT *node) {
+  if constexpr (!SizedNode<Node> && !SummarizedNode<Node>)
+    return;
+  for (; node != nullptr; node = node->parent)
+    updateSize(node);
+}
+
+template <KeyComparble Key, typename Node>
+int RedBlackTree<Key, Node>::getSize(NodeT *node)
+  requires SizedNode<Node>
+{
+  return node ? node->size : 0;
+}
+
+template <KeyComparble Key, typename Node>
+void RedBlackTree<Key, Node>::updateSize(NodeT *node) {
+  if (!node)
+    return;
+  if constexpr (SummarizedNode<Node>)
+    node->updateSummary();
+  if constexpr (SizedNode<Node>)
+    node->size = getSize(node->left) + getSize(node->right) + 1;
+}
+
+template <KeyComparble Key, typename Node>
+Node *RedBlackTree<Key, Node>::select(int k)
+  requires SizedNode<Node>
+{
+  if (k < 0 || k >= getSize(root))
+    return nullptr;
+
+  NodeT *node = root;
+  while (node != nullptr) {
+    int leftSize = getSize(node->left);
+    if (k < leftSize) {
+      node = node->left;
+    } else if (k == leftSize) {
+      return node;
+    } else {
+      k -= leftSize + 1;
+      node = node->right;
+    }
+  }
+  return nullptr;
+}
+
+template <KeyComparble Key, typename Node>
+int RedBlackTree<Key, Node>::countLess(int key, bool inclusive) {
+  int count = 0;
+  NodeT *node = root;
+  while (node != nullptr) {
+    if (key < node->key || (!inclusive && key == node->key)) {
+      node = node->left;
+    } else {
+      count += getSize(node->left) + 1;
+      node = node->right;
+    }
+  }
+  return count;
+}
+
+template <KeyComparble Key, typename Node>
+int RedBlackTree<Key, Node>::rank(int key)
+  requires SizedNode<Node>
+{
+  return countLess(key, false);
+}
+
+template <KeyComparble Key, typename Node>
+int RedBlackTree<Key, Node>::countRange(int lo, int hi)
+  requires SizedNode<Node>
+{
+  if (hi < lo)
+    return 0;
+  return countLess(hi, true) - countLess(lo, false);
+}
+
+template <KeyComparble Key, typename Node>
+auto RedBlackTree<Key, Node>::aggregate(int lo, int hi)
+  requires TREE::AggregateNode<Node>
+{
+  return TREE::aggregateRange(root, lo, hi);
+}
+
 } // namespace RBTREE
@@ -0,0 +1,338 @@
+#pragma once
+
+#include "tree.hpp"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                               Sharded Sets
+//-------------------------------------------------------------------------------
+
+// Ordered set of ints range-partitioned over a fixed number of shards, each
+// an ordinary Tree (AVLTree<int> or RBTREE::RedBlackTree<int>) behind its own
+// mutex. Producers that hit different shards never touch the same lock or
+// cache line, so inserts scale with the cores as long as the keys spread
+// over the shards.
+//
+// Shard i holds the keys in [lo, hi]; the ranges tile the int line. A key is
+// routed with a lock-free binary search over the shard lower bounds and the
+// shard's own range is re-checked under its lock, so a concurrent
+// rebalance() only costs the operation a retry.
+//
+// The split points adapt to the data: every REBALANCE_CHECK inserts a shard
+// compares its size with the average, and a shard twice as full as it
+// should be triggers rebalance(). That joins all shards into one tree,
+// picks the split keys at equal-count quantiles and splits it again, all
+// O(n / shards) joins and splits plus one O(n) walk.
+//
+// Iteration and range queries walk the shards in key order, locking one
+// shard at a time: keys come out sorted and at most once, but a scan that
+// runs alongside writers sees each shard as of the moment it reached it.
+// The visitor runs with no lock held, on a copy of the shard's keys, so it
+// may insert, remove or look up keys itself.
+template <typename Tree = AVLTree<int>> class ShardedSet {
+protected:
+  static constexpr int REBALANCE_CHECK = 1024; // inserts between checks
+  static constexpr int MIN_SHARD_SIZE = 256;   // no rebalancing below this
+
+  struct alignas(64) Shard {
+    std::mutex lock;
+    Tree tree;
+    int lo;
+    int hi;
+    std::atomic<int> count{0}; // written under lock, read anywhere
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::vector<std::atomic<int>> lower; // shards[i]->lo, for routing
+  std::mutex rebalancing;
+
+  int route(int key) const;
+  template <typename F> auto withShard(int key, F f);
+  void maybeRebalance(Shard &shard);
+  void repartition();
+
+  template <typename NodeT, typename F>
+  static void walk(NodeT *node, int lo, int hi, F &visit);
+
+public:
+  // one shard per hardware thread by default
+  explicit ShardedSet(
+      int count = static_cast<int>(std::thread::hardware_concurrency()));
+
+  ShardedSet(const ShardedSet &) = delete;
+  ShardedSet &operator=(const ShardedSet &) = delete;
+
+  bool insert(int key); // true if key was added
+  bool remove(int key); // true if key was removed
+  bool contains(int key);
+  std::optional<int> lowerBound(int key); // smallest key >= key
+
+  int size();
+  bool empty();
+  int shardCount() const;
+  int shardSize(int shard) const;
+
+  // In-order visit(key) of every key, or of the keys in [lo, hi].
+  template <typename F> void forEach(F visit);
+  template <typename F> void forEachInRange(int lo, int hi, F visit);
+
+  // Re-partitions at the current quantiles; blocks every shard meanwhile.
+  void rebalance();
+};
+
+//-------------------------------------------------------------------------------
+//                          ShardedSet Implementation
+//-------------------------------------------------------------------------------
+
+template <typename Tree>
+ShardedSet<Tree>::ShardedSet(int count) : lower(std::max(count, 1)) {
+  count = std::max(count, 1);
+  // until the data says otherwise, cut the int line into equal parts
+  long long first = std::numeric_limits<int>::min();
+  long long span = (1LL << 32) / count;
+  for (int i = 0; i < count; ++i) {
+    auto shard = std::make_unique<Shard>();
+    shard->lo = static_cast<int>(first + i * span);
+    shard->hi = i + 1 < count ? static_cast<int>(first + (i + 1) * span - 1)
+                              : std::numeric_limits<int>::max();
+    lower[i].store(shard->lo, std::memory_order_relaxed);
+    shards.push_back(std::move(shard));
+  }
+}
+
+template <typename Tree> int ShardedSet<Tree>::route(int key) const {
+  // last shard whose lower bound is <= key; shard 0 starts at INT_MIN
+  int a = 0, b = static_cast<int>(lower.size()) - 1;
+  while (a < b) {
+    int mid = (a + b + 1) / 2;
+    if (lower[mid].load(std::memory_order_relaxed) <= key)
+      a = mid;
+    else
+      b = mid - 1;
+  }
+  return a;
+}
+
+template <typename Tree>
+template <typename F>
+auto ShardedSet<Tree>::withShard(int key, F f) {
+  for (;;) {
+    Shard &shard = *shards[route(key)];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    if (shard.lo <= key && key <= shard.hi)
+      return f(shard);
+    // a rebalance moved the bounds after we routed, look again
+  }
+}
+
+template <typename Tree> bool ShardedSet<Tree>::insert(int key) {
+  Shard *target = nullptr;
+  bool added = withShard(key, [&](Shard &shard) {
+    target = &shard;
+    if (shard.tree.search(key))
+      return false;
+    shard.tree.insert(key);
+    shard.count.store(shard.count.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+    return true;
+  });
+  if (added)
+    maybeRebalance(*target);
+  return added;
+}
+
+template <typename Tree> bool ShardedSet<Tree>::remove(int key) {
+  return withShard(key, [&](Shard &shard) {
+    if (!shard.tree.search(key))
+      return false;
+    shard.tree.remove(key);
+    shard.count.store(shard.count.load(std::memory_order_relaxed) - 1,
+                      std::memory_order_relaxed);
+    return true;
+  });
+}
+
+template <typename Tree> bool ShardedSet<Tree>::contains(int key) {
+  return withShard(key, [&](Shard &shard) {
+    return shard.tree.search(key) != nullptr;
+  });
+}
+
+template <typename Tree>
+std::optional<int> ShardedSet<Tree>::lowerBound(int key) {
+  // an empty shard passes the question on to the next one
+  for (int from = key;;) {
+    std::optional<int> found;
+    int end = withShard(from, [&](Shard &shard) {
+      for (auto *node = shard.tree.getRoot(); node != nullptr;) {
+        if (node->key < from) {
+          node = node->right;
+        } else {
+          found = node->key;
+          node = node->left;
+        }
+      }
+      return shard.hi;
+    });
+    if (found || end == std::numeric_limits<int>::max())
+      return found;
+    from = end + 1;
+  }
+}
+
+template <typename Tree> int ShardedSet<Tree>::size() {
+  int total = 0;
+  for (auto &shard : shards)
+    total += shard->count.load(std::memory_order_relaxed);
+  return total;
+}
+
+template <typename Tree> bool ShardedSet<Tree>::empty() { return size() == 0; }
+
+template <typename Tree> int ShardedSet<Tree>::shardCount() const {
+  return static_cast<int>(shards.size());
+}
+
+template <typename Tree> int ShardedSet<Tree>::shardSize(int shard) const {
+  return shards[shard]->count.load(std::memory_order_relaxed);
+}
+
+template <typename Tree>
+template <typename NodeT, typename F>
+void ShardedSet<Tree>::walk(NodeT *node, int lo, int hi, F &visit) {
+  // in-order, skipping the subtrees that lie wholly outside [lo, hi]
+  std::vector<NodeT *> stack;
+  while (node != nullptr || !stack.empty()) {
+    while (node != nullptr) {
+      if (node->key < lo) {
+        node = node->right;
+      } else {
+        stack.push_back(node);
+        node = node->left;
+      }
+    }
+    if (stack.empty())
+      return;
+    node = stack.back();
+    stack.pop_back();
+    if (hi < node->key)
+      return;
+    visit(node->key);
+    node = node->right;
+  }
+}
+
+template <typename Tree>
+template <typename F>
+void ShardedSet<Tree>::forEachInRange(int lo, int hi, F visit) {
+  // resume from the end of the last shard visited rather than from the next
+  // index, so a rebalance in between cannot repeat or skip keys. Each
+  // shard's keys are copied out under its lock and visited after it is
+  // released, so visit may call back into the set and never stalls writers
+  std::vector<int> keys;
+  auto collect = [&](int key) { keys.push_back(key); };
+  int from = lo;
+  while (from <= hi) {
+    keys.clear();
+    int end = withShard(from, [&](Shard &shard) {
+      walk(shard.tree.getRoot(), from, std::min(hi, shard.hi), collect);
+      return shard.hi;
+    });
+    for (int key : keys)
+      visit(key);
+    if (end >= hi)
+      return;
+    from = end + 1;
+  }
+}
+
+template <typename Tree>
+template <typename F>
+void ShardedSet<Tree>::forEach(F visit) {
+  forEachInRange(std::numeric_limits<int>::min(),
+                 std::numeric_limits<int>::max(), visit);
+}
+
+template <typename Tree>
+void ShardedSet<Tree>::maybeRebalance(Shard &shard) {
+  int count = shard.count.load(std::memory_order_relaxed);
+  if (count % REBALANCE_CHECK != 0)
+    return;
+  long long total = size();
+  long long parts = shards.size();
+  if (parts == 1 || total < parts * MIN_SHARD_SIZE ||
+      count * parts <= 2 * total)
+    return;
+  // one producer re-partitions, the others carry on inserting
+  std::unique_lock<std::mutex> lock(rebalancing, std::try_to_lock);
+  if (lock.owns_lock())
+    repartition();
+}
+
+template <typename Tree> void ShardedSet<Tree>::rebalance() {
+  std::lock_guard<std::mutex> lock(rebalancing);
+  repartition();
+}
+
+template <typename Tree> void ShardedSet<Tree>::repartition() {
+  // shards are only ever locked one at a time elsewhere, so taking them
+  // all in index order cannot deadlock
+  std::vector<std::unique_lock<std::mutex>> locks;
+  for (auto &shard : shards)
+    locks.emplace_back(shard->lock);
+
+  int total = 0;
+  for (auto &shard : shards)
+    total += shard->count.load(std::memory_order_relaxed);
+  int parts = static_cast<int>(shards.size());
+  if (total < parts)
+    return; // not enough keys for distinct split points
+
+  // the ranges are disjoint and ordered, so shards join end to end; the
+  // next shard's smallest key is the join key
+  Tree all;
+  for (auto &shard : shards) {
+    if (std::optional<int> key = shard->tree.popMin())
+      all = Tree::join(all, *key, shard->tree);
+  }
+
+  // split keys at equal-count quantiles
+  std::vector<int> splits;
+  int position = 0;
+  auto pick = [&](int key) {
+    if (position++ == static_cast<long long>(splits.size() + 1) * total / parts)
+      splits.push_back(key);
+  };
+  walk(all.getRoot(), std::numeric_limits<int>::min(),
+       std::numeric_limits<int>::max(), pick);
+
+  // peel the shards off the top, each split key opening its shard
+  for (int i = parts - 1; i > 0; --i) {
+    Shard &shard = *shards[i];
+    all.split(splits[i - 1], all, shard.tree);
+    shard.tree.insert(splits[i - 1]);
+    shard.lo = splits[i - 1];
+    shard.hi = i + 1 < parts ? splits[i] - 1 : std::numeric_limits<int>::max();
+    shard.count.store((i + 1) * static_cast<long long>(total) / parts -
+                          i * static_cast<long long>(total) / parts,
+                      std::memory_order_relaxed);
+    lower[i].store(shard.lo, std::memory_order_relaxed);
+  }
+  Shard &first = *shards[0];
+  first.tree = std::move(all);
+  first.hi = parts > 1 ? splits[0] - 1 : std::numeric_limits<int>::max();
+  first.count.store(static_cast<long long>(total) / parts,
+                    std::memory_order_relaxed);
+}
+
+} // namespace TREE
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "node.hpp"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                              Tree Snapshots
+//-------------------------------------------------------------------------------
+
+// File layout, version 1, native byte order:
+//   SnapshotHeader, padding to keysOffset, count keys in Eytzinger order
+// (slot k at index k - 1, children of k are 2k and 2k + 1). Sections are
+// addressed by offsets from the start of the file, so a mapping at any
+// address is usable as is. The header carries its own checksum, checked on
+// every open; the key section checksum is checked by verify() and load().
+struct SnapshotHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t keySize;
+  std::uint64_t count;
+  std::uint64_t keysOffset;
+  std::uint64_t keysChecksum;
+  std::uint64_t headerChecksum; // over every field above
+};
+
+inline constexpr char SNAPSHOT_MAGIC[8] = {'T', 'R', 'E', 'E',
+                                           'S', 'N', 'A', 'P'};
+inline constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+
+// FNV-1a, 64 bit
+std::uint64_t snapshotChecksum(const void *data, std::size_t bytes);
+
+// Writes header and key section to a uniquely named temporary file, syncs
+// it, renames it over path and syncs the directory. False on any I/O error;
+// path then still holds the old snapshot, unless only the last directory
+// sync failed, in which case the new one is in place but may not survive a
+// crash.
+bool writeSnapshot(const std::string &path, const void *keys,
+                   std::size_t count, std::size_t keySize);
+
+// Read-only POSIX mapping of a whole file, unmapped on destruction.
+class MappedFile {
+  const unsigned char *base{nullptr};
+  std::size_t length{0};
+
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  bool open(const std::string &path);
+  void close();
+  const unsigned char *data() const { return base; }
+  std::size_t size() const { return length; }
+};
+
+// Header of a mapped snapshot if it is intact and holds keySize-byte
+// keys whose section fits in the file, otherwise nullptr.
+const SnapshotHeader *checkSnapshot(const MappedFile &file,
+                                    std::size_t keySize);
+
+// Read-only ordered set served straight from a mapped snapshot: no
+// deserialization, pages come in on first touch. The Eytzinger layout keeps
+// the top levels of every search on the first few pages.
+template <KeyComparble Key> class Snapshot {
+  static_assert(std::is_trivially_copyable_v<Key>,
+                "snapshot keys are stored as raw bytes");
+
+  MappedFile file;
+  const Key *slots{nullptr}; // slot k at slots[k - 1]
+  std::size_t count{0};
+
+  std::size_t descend(int key) const;
+  template <typename F> void walk(std::size_t k, F &visit) const;
+
+public:
+  Snapshot() = default;
+
+  bool open(const std::string &path); // false for more than INT_MAX keys
+  bool verify() const; // key section checksum, touches every page
+
+  int size() const;
+  bool empty() const;
+  bool contains(int key) const;
+  const Key *lowerBound(int key) const; // smallest key >= key, or nullptr
+
+  // In-order visit of every key.
+  template <typename F> void forEach(F visit) const;
+};
+
+// Saves the sorted, duplicate-free range [first, last).
+template <KeyComparble Key, std::forward_iterator It>
+bool saveSnapshot(const std::string &path, It first, It last);
+
+//-------------------------------------------------------------------------------
+//                            Snapshot Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key>
+bool Snapshot<Key>::open(const std::string &path) {
+  slots = nullptr;
+  count = 0;
+  if (!file.open(path))
+    return false;
+
+  const SnapshotHeader *header = checkSnapshot(file, sizeof(Key));
+  if (header == nullptr) {
+    file.close();
+    return false;
+  }
+  if (header->count > static_cast<std::uint64_t>(
+                          std::numeric_limits<int>::max())) {
+    file.close(); // size() and the trees count in int
+    return false;
+  }
+  slots = reinterpret_cast<const Key *>(file.data() + header->keysOffset);
+  count = header->count;
+  return true;
+}
+
+template <KeyComparble Key> bool Snapshot<Key>::verify() const {
+  if (file.data() == nullptr)
+    return false;
+  auto header = reinterpret_cast<const SnapshotHeader *>(file.data());
+  return snapshotChecksum(slots, count * sizeof(Key)) == header->keysChecksum;
+}
+
+template <KeyComparble Key> int Snapshot<Key>::size() const {
+  return static_cast<int>(count);
+}
+
+template <KeyComparble Key> bool Snapshot<Key>::empty() const {
+  return count == 0;
+}
+
+template <KeyComparble Key>
+std::size_t Snapshot<Key>::descend(int key) const {
+  std::size_t k = 1;
+  while (k <= count)
+    k = 2 * k + (slots[k - 1] < key);
+  // strip the trailing right turns and the left turn before them
+  return k >> (std::countr_one(k) + 1);
+}
+
+template <KeyComparble Key> bool Snapshot<Key>::contains(int key) const {
+  std::size_t k = descend(key);
+  return k != 0 && slots[k - 1] == key;
+}
+
+template <KeyComparble Key>
+const Key *Snapshot<Key>::lowerBound(int key) const {
+  std::size_t k = descend(key);
+  return k != 0 ? slots + (k - 1) : nullptr;
+}
+
+template <KeyComparble Key>
+template <typename F>
+void Snapshot<Key>::walk(std::size_t k, F &visit) const {
+  if (k <= count) {
+    walk(2 * k, visit);
+    visit(slots[k - 1]);
+    walk(2 * k + 1, visit);
+  }
+}
+
+template <KeyComparble Key>
+template <typename F>
+void Snapshot<Key>::forEach(F visit) const {
+  walk(1, visit);
+}
+
+template <KeyComparble Key, std::forward_iterator It>
+bool saveSnapshot(const std::string &path, It first, It last) {
+  static_assert(std::is_trivially_copyable_v<Key>,
+                "snapshot keys are stored as raw bytes");
+  std::size_t count = static_cast<std::size_t>(std::distance(first, last));
+  std::vector<Key> slots(count);
+
+  // in-order walk of the implicit tree hands out the sorted keys
+  std::vector<std::size_t> stack;
+  std::size_t k = 1;
+  while (k <= count || !stack.empty()) {
+    for (; k <= count; k *= 2)
+      stack.push_back(k);
+    k = stack.back();
+    stack.pop_back();
+    slots[k - 1] = *first++;
+    k = 2 * k + 1;
+  }
+  return writeSnapshot(path, slots.data(), count, sizeof(Key));
+}
+
+} // namespace TREE
@@ -0,0 +1,358 @@
+#pragma once
+
+#include "node.hpp"
+#include "stats.hpp"
+#include "tree.hpp"
+#include <cstddef>
+#include <initializer_list>
+#include <span>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                                Splay Trees
+//-------------------------------------------------------------------------------
+
+// Self-adjusting BST: every access splays the node it reached to the root,
+// so a small hot set stays a few levels deep and operations are O(log n)
+// amortized. Duplicate keys are ignored. The tree may be temporarily as deep
+// as it is large, so nothing here recurses.
+//
+// Splaying is top-down (Sleator and Tarjan): one walk from the root splits
+// the tree into the keys below and above the target and joins them under
+// the node the walk ended at. There is no second pass up the path and no
+// heights to keep; SplayTree leaves the height field alone. Sizes and
+// summaries are repaired only if the node type has them.
+//
+// Semi-splay mode restructures reads less: a search only halves the depth of
+// the path it walked (zig-zig steps rotate once instead of twice) instead of
+// moving the node all the way up, which cuts the pointer writes a read-heavy
+// workload pays for. It splays bottom-up from the node found, with the same
+// relink-only rotations. Inserts and removes always splay fully.
+template <KeyComparble Key, typename Node = BSTNode<Key>>
+class SplayTree : public BinarySearchTree<Key, Node> {
+protected:
+  using NodeT = Node;
+  bool semiSplay{false};
+
+  // sizes or summaries to repair after relinking
+  static constexpr bool KEEPS_SUBTREE_DATA =
+      SizedNode<Node> || SummarizedNode<Node>;
+
+  // node holding key, else the last node visited
+  NodeT *descend(int key, SearchPath<> &path);
+  // new top of top's parentless subtree
+  NodeT *splay(NodeT *top, int key, SearchPath<> &path);
+  NodeT *splay(NodeT *top, int key);
+  void lift(NodeT *node); // one rotation lifting node over its parent
+  void splayHalfway(NodeT *node);
+  NodeT *access(int key, SearchPath<> &path); // search() without the timer
+
+public:
+  SplayTree();
+  SplayTree(std::initializer_list<int> list);
+  SplayTree &operator=(std::initializer_list<int> list) override;
+
+  void setSemiSplay(bool enabled);
+
+  void insert(int key) override;
+  NodeT *search(int key) override;
+  void remove(int key) override;
+
+  // search() for every element of keys in turn. Every lookup reshapes the
+  // tree for the next one, so unlike BinarySearchTree::searchBatch there
+  // is nothing to interleave; this keeps batched reads splaying. Lookups
+  // are not recorded in stats().
+  void searchBatch(std::span<const int> keys, std::span<NodeT *> result);
+};
+
+//-------------------------------------------------------------------------------
+//                          SplayTree Implementation
+//-------------------------------------------------------------------------------
+
+template <KeyComparble Key, typename Node>
+SplayTree<Key, Node>::SplayTree() {
+  this->root = nullptr;
+}
+
+template <KeyComparble Key, typename Node>
+SplayTree<Key, Node>::SplayTree(std::initializer_list<int> list) {
+  this->root = nullptr;
+  for (int key : list)
+    insert(key);
+}
+
+template <KeyComparble Key, typename Node>
+SplayTree<Key, Node> &
+SplayTree<Key, Node>::operator=(std::initializer_list<int> list) {
+  for (int key : list)
+    insert(key);
+  return *this;
+}
+
+template <KeyComparble Key, typename Node>
+void SplayTree<Key, Node>::setSemiSplay(bool enabled) {
+  semiSplay = enabled;
+}
+
+template <KeyComparble Key, typename Node>
+Node *SplayTree<Key, Node>::descend(int key, SearchPath<> &path) {
+  NodeT *node = this->root;
+  while (node != nullptr) {
+    path.visit();
+    NodeT *next = key < node->key   ? node->left
+                  : node->key < key ? node->right
+                                    : nullptr;
+    if (next == nullptr)
+      return node;
+    node = next;
+  }
+  return nullptr;
+}
+
+template <KeyComparble Key, typename Node>
+Node *SplayTree<Key, Node>::splay(NodeT *top, int key, SearchPath<> &path) {
+  // Nodes passed on the way down go to a left tree (keys below key) or a
+  // right tree (keys above), each hung at the open end of its inner spine:
+  // the right child of leftMax, the left child of rightMin.
+  NodeT *leftTree = nullptr;
+  NodeT *rightTree = nullptr;
+  NodeT *leftMax = nullptr;
+  NodeT *rightMin = nullptr;
+  NodeT **leftHook = &leftTree;
+  NodeT **rightHook = &rightTree;
+  NodeT *node = top;
+  for (;;) {
+    path.visit();
+    if (key < node->key) {
+      NodeT *child = node->left;
+      if (child == nullptr)
+        break;
+      if (key < child->key) { // zig-zig: rotate child over node first
+        path.visit();
+        countStat(this->counters, &TreeStats::rotations);
+        node->left = child->right;
+        if (node->left)
+          node->left->parent = node;
+        child->right = node;
+        node->parent = child;
+        if constexpr (KEEPS_SUBTREE_DATA)
+          this->updateSize(node);
+        node = child;
+        if (node->left == nullptr)
+          break;
+      }
+      *rightHook = node;
+      node->parent = rightMin;
+      rightMin = node;
+      rightHook = &node->left;
+      node = node->left;
+    } else if (node->key < key) {
+      NodeT *child = node->right;
+      if (child == nullptr)
+        break;
+      if (child->key < key) { // zig-zig
+        path.visit();
+        countStat(this->counters, &TreeStats::rotations);
+        node->right = child->left;
+        if (node->right)
+          node->right->parent = node;
+        child->left = node;
+        node->parent = child;
+        if constexpr (KEEPS_SUBTREE_DATA)
+          this->updateSize(node);
+        node = child;
+        if (node->right == nullptr)
+          break;
+      }
+      *leftHook = node;
+      node->parent = leftMax;
+      leftMax = node;
+      leftHook = &node->right;
+      node = node->right;
+    } else {
+      break;
+    }
+  }
+
+  // node's subtrees fill the open ends, the side trees become its subtrees
+  *leftHook = node->left;
+  if (node->left)
+    node->left->parent = leftMax;
+  *rightHook = node->right;
+  if (node->right)
+    node->right->parent = rightMin;
+  node->left = leftTree;
+  if (leftTree)
+    leftTree->parent = node;
+  node->right = rightTree;
+  if (rightTree)
+    rightTree->parent = node;
+  node->parent = nullptr;
+
+  if constexpr (KEEPS_SUBTREE_DATA) {
+    // only the spines changed below them, repair them from the bottom up
+    for (NodeT *n = leftMax; n != nullptr && n != node; n = n->parent)
+      this->updateSize(n);
+    for (NodeT *n = rightMin; n != nullptr && n != node; n = n->parent)
+      this->updateSize(n);
+    this->updateSize(node);
+  }
+  return node;
+}
+
+template <KeyComparble Key, typename Node>
+Node *SplayTree<Key, Node>::splay(NodeT *top, int key) {
+  SearchPath<> uncounted;
+  return splay(top, key, uncounted);
+}
+
+template <KeyComparble Key, typename Node>
+void SplayTree<Key, Node>::lift(NodeT *node) {
+  // rotateLeft/rotateRight without the height upkeep a splay tree never
+  // reads
+  NodeT *parent = node->parent;
+  NodeT *grand = parent->parent;
+  countStat(this->counters, &TreeStats::rotations);
+  if (node == parent->left) {
+    parent->left = node->right;
+    if (node->right)
+      node->right->parent = parent;
+    node->right = parent;
+  } else {
+    parent->right = node->left;
+    if (node->left)
+      node->left->parent = parent;
+    node->left = parent;
+  }
+  parent->parent = node;
+  node->parent = grand;
+  if (grand == nullptr)
+    this->root = node;
+  else if (grand->left == parent)
+    grand->left = node;
+  else
+    grand->right = node;
+
+  if constexpr (KEEPS_SUBTREE_DATA) {
+    this->updateSize(parent);
+    this->updateSize(node);
+  }
+}
+
+template <KeyComparble Key, typename Node>
+void SplayTree<Key, Node>::splayHalfway(NodeT *node) {
+  while (node->parent != nullptr) {
+    NodeT *parent = node->parent;
+    NodeT *grand = parent->parent;
+    if (grand == nullptr) {
+      lift(node);
+    } else if ((node == parent->left) == (parent == grand->left)) {
+      lift(parent); // node keeps its parent, carry on from there
+      node = parent;
+    } else {
+      lift(node);
+      lift(node);
+    }
+  }
+}
+
+template <KeyComparble Key, typename Node>
+Node *SplayTree<Key, Node>::access(int key, SearchPath<> &path) {
+  if (this->root == nullptr)
+    return nullptr;
+
+  // a miss splays the last node visited, so repeated misses get cheap too
+  NodeT *node;
+  if (semiSplay) {
+    node = descend(key, path);
+    splayHalfway(node);
+  } else {
+    node = this->root = splay(this->root, key, path);
+  }
+  return node->key == key ? node : nullptr;
+}
+
+template <KeyComparble Key, typename Node>
+void SplayTree<Key, Node>::insert(int key) {
+  ScopedLatency<> timer(this->counters, &TreeStats::insertLatency);
+  if (this->root == nullptr) {
+    this->root = new NodeT(key);
+    return;
+  }
+  NodeT *top = this->root = splay(this->root, key);
+  if (top->key == key)
+    return;
+
+  // top is key's neighbour: split the tree between them
+  NodeT *node = new NodeT(key);
+  if (key < top->key) {
+    node->left = top->left;
+    node->right = top;
+    top->left = nullptr;
+  } else {
+    node->right = top->right;
+    node->left = top;
+    top->right = nullptr;
+  }
+  if (node->left)
+    node->left->parent = node;
+  if (node->right)
+    node->right->parent = node;
+  if constexpr (KEEPS_SUBTREE_DATA) {
+    this->updateSize(top);
+    this->updateSize(node);
+  }
+  this->root = node;
+}
+
+template <KeyComparble Key, typename Node>
+Node *SplayTree<Key, Node>::search(int key) {
+  ScopedLatency<> timer(this->counters, &TreeStats::searchLatency);
+  SearchPath<> path;
+  NodeT *node = access(key, path);
+  recordSearch(this->counters, path.length());
+  return node;
+}
+
+template <KeyComparble Key, typename Node>
+void SplayTree<Key, Node>::remove(int key) {
+  ScopedLatency<> timer(this->counters, &TreeStats::removeLatency);
+  if (this->root == nullptr)
+    return;
+  NodeT *node = this->root = splay(this->root, key);
+  if (node->key != key)
+    return;
+
+  // every key on the left is below key, so splaying the left subtree for it
+  // brings up its largest key, which has no right child: hang the right
+  // subtree there
+  NodeT *left = node->left;
+  NodeT *right = node->right;
+  delete node;
+  if (right)
+    right->parent = nullptr;
+  if (left == nullptr) {
+    this->root = right;
+    return;
+  }
+
+  left->parent = nullptr;
+  NodeT *top = splay(left, key);
+  top->right = right;
+  if (right)
+    right->parent = top;
+  if constexpr (KEEPS_SUBTREE_DATA)
+    this->updateSize(top);
+  this->root = top;
+}
+
+template <KeyComparble Key, typename Node>
+void SplayTree<Key, Node>::searchBatch(std::span<const int> keys,
+                                       std::span<NodeT *> result) {
+  SearchPath<> uncounted;
+  for (std::size_t i = 0; i < keys.size(); ++i)
+    result[i] = access(keys[i], uncounted);
+}
+
+} // namespace TREE
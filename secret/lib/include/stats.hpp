@@ -0,0 +1,222 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace TREE {
+
+//-------------------------------------------------------------------------------
+//                            Tree Operation Stats
+//-------------------------------------------------------------------------------
+
+// Counters and latencies are collected only when the library is built with
+// TREE_STATS defined (CMake option SECRET_TREE_STATS). Otherwise the trees
+// hold an empty NoStats and every hook below compiles to nothing. The shape
+// part of TreeStats (depth histogram, footprint) is computed on request and
+// is available either way.
+#if defined(TREE_STATS)
+inline constexpr bool STATS_ENABLED = true;
+#else
+inline constexpr bool STATS_ENABLED = false;
+#endif
+
+// Power-of-two buckets: bucket b counts samples in [2^b, 2^(b+1)) ns.
+struct LatencyHistogram {
+  static constexpr int BUCKETS = 40;
+  std::array<std::uint64_t, BUCKETS> counts{};
+
+  void record(std::uint64_t nanoseconds);
+  void recordShared(std::uint64_t nanoseconds); // relaxed atomic increment
+  std::uint64_t samples() const;
+  std::uint64_t percentile(double p) const; // upper edge of the bucket, ns
+};
+
+struct TreeStats {
+  // rebalancing: AVL balance() cases and red-black insert fix-up shapes
+  std::uint64_t rotationsLL{0};
+  std::uint64_t rotationsRR{0};
+  std::uint64_t rotationsLR{0};
+  std::uint64_t rotationsRL{0};
+  std::uint64_t rotations{0}; // every single rotation, including the above
+  std::uint64_t recolors{0};
+  std::array<std::uint64_t, 3> insertFixups{}; // red-black cases 1-3
+  std::array<std::uint64_t, 4> deleteFixups{}; // red-black cases 1-4
+
+  // B+ and B-epsilon trees: nodes split off and nodes merged away
+  std::uint64_t splits{0};
+  std::uint64_t merges{0};
+
+  // search paths, nodes visited per search() (tree nodes, not keys, in the
+  // B+, B-epsilon and radix trees)
+  std::uint64_t searches{0};
+  std::uint64_t searchPathTotal{0};
+  std::uint64_t searchPathMax{0};
+
+  LatencyHistogram insertLatency;
+  LatencyHistogram searchLatency;
+  LatencyHistogram removeLatency;
+
+  // shape, filled in by the tree's stats()
+  std::vector<std::uint64_t> depthHistogram; // nodes per depth, root at 0
+  std::uint64_t nodes{0};
+  std::uint64_t bytes{0};
+
+  bool collected{STATS_ENABLED}; // false: counters above stay zero
+
+  double averageSearchPath() const;
+};
+
+std::string toJson(const TreeStats &stats);
+
+struct NoStats {};
+using StatsCollector = std::conditional_t<STATS_ENABLED, TreeStats, NoStats>;
+
+// Hooks used by the trees; the NoStats overloads are empty.
+inline void countStat(NoStats &, std::uint64_t TreeStats::*) {}
+inline void countStat(TreeStats &stats, std::uint64_t TreeStats::*counter) {
+  ++(stats.*counter);
+}
+
+template <std::size_t N>
+void countFixup(NoStats &, std::array<std::uint64_t, N> TreeStats::*,
+                std::size_t) {}
+template <std::size_t N>
+void countFixup(TreeStats &stats,
+                std::array<std::uint64_t, N> TreeStats::*cases,
+                std::size_t which) {
+  ++(stats.*cases)[which - 1];
+}
+
+inline void recordSearch(NoStats &, std::uint64_t) {}
+inline void recordSearch(TreeStats &stats, std::uint64_t pathLength) {
+  ++stats.searches;
+  stats.searchPathTotal += pathLength;
+  if (pathLength > stats.searchPathMax)
+    stats.searchPathMax = pathLength;
+}
+
+// The same hooks for a tree that several threads update at once
+// (ConcurrentAVLTree): every increment is a relaxed atomic one, so the
+// counters are exact but shared by all threads.
+inline void countStatShared(NoStats &, std::uint64_t TreeStats::*) {}
+inline void countStatShared(TreeStats &stats,
+                            std::uint64_t TreeStats::*counter) {
+  std::atomic_ref<std::uint64_t>(stats.*counter)
+      .fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void recordSearchShared(NoStats &, std::uint64_t) {}
+inline void recordSearchShared(TreeStats &stats, std::uint64_t pathLength) {
+  std::atomic_ref<std::uint64_t>(stats.searches)
+      .fetch_add(1, std::memory_order_relaxed);
+  std::atomic_ref<std::uint64_t>(stats.searchPathTotal)
+      .fetch_add(pathLength, std::memory_order_relaxed);
+  std::atomic_ref<std::uint64_t> longest(stats.searchPathMax);
+  std::uint64_t seen = longest.load(std::memory_order_relaxed);
+  while (pathLength > seen &&
+         !longest.compare_exchange_weak(seen, pathLength,
+                                        std::memory_order_relaxed))
+    ;
+}
+
+inline TreeStats statsOf(const NoStats &) { return TreeStats{}; }
+inline TreeStats statsOf(const TreeStats &stats) { return stats; }
+
+// Counts the nodes a search visits as it goes, for recordSearch(); with
+// stats off it holds nothing and length() is a constant 0.
+template <bool Enabled = STATS_ENABLED> class SearchPath {
+public:
+  void visit() {}
+  std::uint64_t length() const { return 0; }
+};
+
+template <> class SearchPath<true> {
+  std::uint64_t visited{0};
+
+public:
+  void visit() { ++visited; }
+  std::uint64_t length() const { return visited; }
+};
+
+// Times its scope into one of the latency histograms; Shared records with
+// LatencyHistogram::recordShared.
+template <bool Enabled = STATS_ENABLED, bool Shared = false>
+class ScopedLatency {
+public:
+  ScopedLatency(StatsCollector &, LatencyHistogram TreeStats::*) {}
+};
+
+template <bool Shared> class ScopedLatency<true, Shared> {
+  LatencyHistogram &histogram;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  ScopedLatency(TreeStats &stats, LatencyHistogram TreeStats::*member)
+      : histogram(stats.*member), start(std::chrono::steady_clock::now()) {}
+  ~ScopedLatency() {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    auto ns = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    if constexpr (Shared)
+      histogram.recordShared(ns);
+    else
+      histogram.record(ns);
+  }
+
+  ScopedLatency(const ScopedLatency &) = delete;
+  ScopedLatency &operator=(const ScopedLatency &) = delete;
+};
+
+// Binary search tree descent for key that counts its path; the search() of
+// the pointer-based trees is this.
+template <typename Stats, typename NodeT>
+NodeT *searchCounted(Stats &stats, NodeT *node, int key) {
+  SearchPath<> path;
+  while (node != nullptr) {
+    path.visit();
+    if (node->key == key)
+      break;
+    node = key < node->key ? node->left : node->right;
+  }
+  recordSearch(stats, path.length());
+  return node;
+}
+
+// One node at depth for the shape part of stats(); the trees whose nodes
+// collectShape cannot walk call this from their own walk and add up bytes
+// themselves.
+inline void countNode(TreeStats &stats, std::size_t depth) {
+  if (stats.depthHistogram.size() <= depth)
+    stats.depthHistogram.resize(depth + 1);
+  ++stats.depthHistogram[depth];
+  ++stats.nodes;
+}
+
+// Fills in depthHistogram, nodes and bytes for the tree under root.
+template <typename NodeT>
+void collectShape(const NodeT *root, std::size_t treeBytes, TreeStats &stats) {
+  stats.depthHistogram.clear();
+  stats.nodes = 0;
+  std::vector<std::pair<const NodeT *, std::size_t>> stack;
+  if (root)
+    stack.push_back({root, 0});
+  while (!stack.empty()) {
+    auto [node, depth] = stack.back();
+    stack.pop_back();
+    countNode(stats, depth);
+    if (const NodeT *left = node->left)
+      stack.push_back({left, depth + 1});
+    if (const NodeT *right = node->right)
+      stack.push_back({right, depth + 1});
+  }
+  stats.bytes = treeBytes + stats.nodes * sizeof(NodeT);
+}
+
+} // namespace TREE
@@ -1,10 +1,20 @@
 #pragma once
 
+#include "batch.hpp"
+#include "eytzinger.hpp"
+#include "monoid.hpp"
 #include "node.hpp"
+#include "parallel.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
 #include "util.hpp"
 #include <algorithm>
 #include <initializer_list>
+#include <optional>
+#include <span>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace TREE {
 
@@ -12,10 +22,13 @@ namespace TREE {
 //                              Binary Search Trees
 //-------------------------------------------------------------------------------
 
-template <KeyComparble Key> class BinarySearchTree {
+template <KeyComparble Key, typename Node = BSTNode<Key>>
+class BinarySearchTree {
 protected:
-  using NodeT = BSTNode<Key>;
+  using NodeT = Node;
   NodeT *root;
+  // empty without TREE_STATS; mutable so const lookups can count too
+  [[no_unique_address]] mutable StatsCollector counters;
 
   virtual NodeT *insertNode(NodeT *node, int key, NodeT *parent);
   NodeT *searchNode(NodeT *node, int key);
@@ -28,13 +41,33 @@ protected:
   NodeT *rotateLeft(NodeT *z);
   NodeT *rotateRight(NodeT *z);
 
+  template <std::forward_iterator It>
+  NodeT *buildSorted(It &it, It last, int n, NodeT *parent);
+
+  void updateSizeUpward(NodeT *node);
+  int countLess(int key, bool inclusive);
+
+  void destroySubtree(NodeT *node);
+  NodeT *cloneSubtree(const NodeT *node);
+
 public:
-  virtual ~BinarySearchTree() = default;
+  virtual ~BinarySearchTree();
 
   BinarySearchTree();
   BinarySearchTree(std::initializer_list<int> list);
   virtual BinarySearchTree &operator=(std::initializer_list<int> list);
 
+  // A copy clones the other tree node for node in one preorder pass, O(n)
+  // and no rebalancing; a move takes its nodes over in O(1) and leaves it
+  // empty.
+  BinarySearchTree(const BinarySearchTree &other);
+  BinarySearchTree(BinarySearchTree &&other) noexcept;
+  BinarySearchTree &operator=(const BinarySearchTree &other);
+  BinarySearchTree &operator=(BinarySearchTree &&other) noexcept;
+
+  // Frees every node, O(n) with neither recursion nor a stack.
+  virtual void clear();
+
   NodeT *getRoot();
   virtual void insert(int key);
   virtual NodeT *search(int key);
@@ -42,54 +75,175 @@ public:
   NodeT *minimum();
   NodeT *maximum();
   NodeT *successor(int key);
+
+  // search() for every element of keys into result, with up to
+  // SEARCH_BATCH descents interleaved so their cache misses overlap (see
+  // batch.hpp). Lookups are not recorded in stats().
+  void searchBatch(std::span<const int> keys, std::span<NodeT *> result);
   void printWithoutPrefix(NodeT *node);
   void printWithPrefix(const std::string &prefix, NodeT *node);
 
   int getHeight(NodeT *node);
   int getBalance(NodeT *node);
   void updateHeight(NodeT *node);
+
+  // Order statistics, O(log n) on balanced trees; only for trees of sized
+  // nodes, see OrderStatisticAVLTree. The node type is the only switch:
+  // with sized nodes insert/remove/rotations always keep the sizes current,
+  // so queries never rebuild them.
+  void updateSize(NodeT *node);
+  int getSize(NodeT *node) requires SizedNode<Node>;
+  NodeT *select(int k) requires SizedNode<Node>; // k-th smallest, 0-based
+  int rank(int key) requires SizedNode<Node>;    // number of keys < key
+  int countRange(int lo, int hi) requires SizedNode<Node>; // keys in [lo, hi]
+
+  // Monoid summary of the keys in [lo, hi], O(log n) on balanced trees.
+  // Only for trees of aggregate nodes, see AggregateAVLTree.
+  auto aggregate(int lo, int hi) requires AggregateNode<Node>;
+
+  // Immutable copy of the keys laid out for fast lookups, O(n).
+  EytzingerIndex<Key> freeze();
+
+  // Operation counters and latencies (TREE_STATS builds) plus the current
+  // depth histogram and footprint, O(n). See stats.hpp.
+  TreeStats stats();
 };
 
 //-------------------------------------------------------------------------------
 //                                   AVL Trees
 //-------------------------------------------------------------------------------
 
-template <KeyComparble Key> class AVLTree : public BinarySearchTree<Key> {
+template <KeyComparble Key, typename Node = BSTNode<Key>>
+class AVLTree : public BinarySearchTree<Key, Node> {
 protected:
-  using NodeT = BSTNode<Key>;
+  using NodeT = Node;
+  NodeT *finger{nullptr}; // last inserted node, in finger mode
+  bool fingerSearch{false};
+  NodeT *leftmost{nullptr};  // cached minimum()
+  NodeT *rightmost{nullptr}; // cached maximum()
+
+  void trackInserted(NodeT *node);
+  void trackRemoved(NodeT *node); // before node is unlinked
+  void resetEnds();
+
   NodeT *balance(NodeT *node);
+  void retrace(NodeT *node);
 
   NodeT *insertNode(NodeT *node, int key, NodeT *parent) override;
   NodeT *deleteNode(NodeT *root, NodeT *node) override;
 
+  template <std::input_iterator It> void insertRange(It first, It last);
+
+  // Join-based primitives on detached subtrees. They never touch this->root,
+  // so disjoint subtrees can be processed on different threads.
+  struct SplitResult {
+    NodeT *less;
+    NodeT *found; // node holding the split key, or nullptr
+    NodeT *greater;
+  };
+  NodeT *link(NodeT *left, NodeT *node, NodeT *right);
+  NodeT *linkRotateLeft(NodeT *node);
+  NodeT *linkRotateRight(NodeT *node);
+  NodeT *joinRight(NodeT *left, NodeT *node, NodeT *right);
+  NodeT *joinLeft(NodeT *left, NodeT *node, NodeT *right);
+  NodeT *joinNode(NodeT *left, NodeT *node, NodeT *right);
+  NodeT *joinNode(NodeT *left, NodeT *right);
+  SplitResult splitNode(NodeT *node, int key);
+  NodeT *splitLast(NodeT *node, NodeT *&last);
+  NodeT *unionNode(NodeT *a, NodeT *b, int depth);
+  NodeT *intersectNode(NodeT *a, NodeT *b, int depth);
+  NodeT *differenceNode(NodeT *a, NodeT *b, int depth);
+  bool shouldFork(NodeT *a, NodeT *b, int depth);
+  void adopt(NodeT *node);
+
 public:
   AVLTree();
   AVLTree(std::initializer_list<int> list);
+  template <std::input_iterator It> AVLTree(It first, It last);
   AVLTree &operator=(std::initializer_list<int> list) override;
 
+  AVLTree(const AVLTree &other);
+  AVLTree(AVLTree &&other) noexcept;
+  AVLTree &operator=(const AVLTree &other);
+  AVLTree &operator=(AVLTree &&other) noexcept;
+  void clear() override;
+
+  // O(n) build of a perfectly balanced tree from a sorted range; duplicate
+  // keys are collapsed. Unsorted input falls back to one insert per key.
+  template <std::forward_iterator It>
+  static AVLTree fromSorted(It first, It last);
+
+  // Join-based bulk operations. join() requires every key of left to be
+  // smaller than key and every key of right to be larger; split() moves the
+  // keys below/above key into less/greater. Both leave the inputs empty.
+  // The set operations consume other and fork their recursive halves onto
+  // PARALLEL::ThreadPool when the subtrees are large.
+  static AVLTree join(AVLTree &left, int key, AVLTree &right);
+  bool split(int key, AVLTree &less, AVLTree &greater);
+  void unionWith(AVLTree &other);
+  void intersectWith(AVLTree &other);
+  void differenceWith(AVLTree &other);
+  void eraseRange(int lo, int hi);
+
+  // Hinted insertion: the search starts at hint (a node of this tree, or
+  // nullptr for the root) and climbs only as far as key requires, so a key
+  // d positions away from hint costs O(log d) plus amortized O(1)
+  // rebalancing. Returns the node holding key, which makes a good next hint.
+  NodeT *insert(NodeT *hint, int key);
+  // Inserts a range made of sorted runs, each key hinted by the previous one.
+  template <std::input_iterator It> void insertRuns(It first, It last);
+  // Finger mode: insert(key) starts from the previously inserted node.
+  void setFingerSearch(bool enabled);
+
+  // Binary snapshot of the keys, see snapshot.hpp. load() replaces the
+  // contents with a verified snapshot, or returns false and leaves the
+  // tree alone if the file is missing, corrupt or holds another key type.
+  bool save(const std::string &path);
+  bool load(const std::string &path);
+
+  // Double-ended priority queue. The smallest and largest nodes are cached
+  // and kept up to date by insert/remove (a rotation never moves one node
+  // past another), so minimum(), maximum() and the peeks are O(1). A pop
+  // removes a node with at most one child, a single AVL retrace.
+  NodeT *minimum();
+  NodeT *maximum();
+  std::optional<Key> peekMin();
+  std::optional<Key> peekMax();
+  std::optional<Key> popMin();
+  std::optional<Key> popMax();
+
   void insert(int key) override;
   NodeT *search(int key) override;
   void remove(int key) override;
 };
 
+// AVL tree whose nodes carry a Monoid summary of their subtree; it is kept
+// current by the same calls that maintain heights and sizes.
+template <KeyComparble Key, KeyMonoid<Key> Monoid>
+using AggregateAVLTree = AVLTree<Key, AggregateBSTNode<Key, Monoid>>;
+
+// AVL tree with select / rank / countRange; its nodes carry subtree sizes.
+template <KeyComparble Key>
+using OrderStatisticAVLTree = AVLTree<Key, SizedBSTNode<Key>>;
+
 //-------------------------------------------------------------------------------
 //                        BinarySearchTree Implementation
 //-------------------------------------------------------------------------------
 
-template <KeyComparble Key>
-BinarySearchTree<Key>::BinarySearchTree() : root(nullptr) {}
+template <KeyComparble Key, typename Node>
+BinarySearchTree<Key, Node>::BinarySearchTree() : root(nullptr) {}
 
-template <KeyComparble Key>
-BinarySearchTree<Key>::BinarySearchTree(std::initializer_list<int> list) {
+template <KeyComparble Key, typename Node>
+BinarySearchTree<Key, Node>::BinarySearchTree(std::initializer_list<int> list) {
   root = nullptr;
   for (int key : list) {
     BinarySearchTree::insert(key);
   }
 }
 
-template <KeyComparble Key>
-BinarySearchTree<Key> &
-BinarySearchTree<Key>::operator=(std::initializer_list<int> list) {
+template <KeyComparble Key, typename Node>
+BinarySearchTree<Key, Node> &
+BinarySearchTree<Key, Node>::operator=(std::initializer_list<int> list) {
   for (int key : list) {
     BinarySearchTree::insert(key);
   }
@@ -97,9 +251,51 @@ BinarySearchTree<Key>::operator=(std::initializer_list<int> list) {
   return *this;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::insertNode(NodeT *node, int key,
-                                                NodeT *parent) {
+template <KeyComparble Key, typename Node>
+BinarySearchTree<Key, Node>::~BinarySearchTree() {
+  destroySubtree(root);
+}
+
+template <KeyComparble Key, typename Node>
+BinarySearchTree<Key, Node>::BinarySearchTree(const BinarySearchTree &other)
+    : root(cloneSubtree(other.root)), counters(other.counters) {}
+
+template <KeyComparble Key, typename Node>
+BinarySearchTree<Key, Node>::BinarySearchTree(BinarySearchTree &&other) noexcept
+    : root(std::exchange(other.root, nullptr)), counters(other.counters) {}
+
+template <KeyComparble Key, typename Node>
+BinarySearchTree<Key, Node> &
+BinarySearchTree<Key, Node>::operator=(const BinarySearchTree &other) {
+  if (this != &other) {
+    NodeT *copy = cloneSubtree(other.root);
+    destroySubtree(root);
+    root = copy;
+    counters = other.counters;
+  }
+  return *this;
+}
+
+template <KeyComparble Key, typename Node>
+BinarySearchTree<Key, Node> &
+BinarySearchTree<Key, Node>::operator=(BinarySearchTree &&other) noexcept {
+  if (this != &other) {
+    destroySubtree(root);
+    root = std::exchange(other.root, nullptr);
+    counters = other.counters;
+  }
+  return *this;
+}
+
+template <KeyComparble Key, typename Node>
+void BinarySearchTree<Key, Node>::clear() {
+  destroySubtree(root);
+  root = nullptr;
+}
+
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::insertNode(NodeT *node, int key,
+                                              NodeT *parent) {
   if (node == nullptr) { // check value, if not exist, create it
     NodeT *newNode = new NodeT(key);
     newNode->parent = parent;
@@ -108,17 +304,19 @@ BSTNode<Key> *BinarySearchTree<Key>::insertNode(NodeT *node, int key,
     return newNode;
   }
 
-  // recursively search for appropriate place
+  // recursively search for appropriate place; qualified so the recursion
+  // is a direct call rather than a trip through the vtable per level
   if (key < node->key) {
-    node->left = insertNode(node->left, key, node);
+    node->left = BinarySearchTree::insertNode(node->left, key, node);
   } else {
-    node->right = insertNode(node->right, key, node);
+    node->right = BinarySearchTree::insertNode(node->right, key, node);
   }
+  updateSize(node);
   return node; // return parent node, recursively return root
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::searchNode(NodeT *node, int key) {
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::searchNode(NodeT *node, int key) {
   if (node == nullptr || node->key == key) { // check value
     return node;
   }
@@ -128,9 +326,9 @@ BSTNode<Key> *BinarySearchTree<Key>::searchNode(NodeT *node, int key) {
     return searchNode(node->right, key);
 }
 
-template <KeyComparble Key>
-void BinarySearchTree<Key>::transplant(NodeT *u,
-                                       NodeT *v) { // used to replace u with v
+template <KeyComparble Key, typename Node>
+void BinarySearchTree<Key, Node>::transplant(
+    NodeT *u, NodeT *v) { // used to replace u with v
   if (u->parent == nullptr)
     // if u is the root
     this->root = v;
@@ -145,11 +343,13 @@ void BinarySearchTree<Key>::transplant(NodeT *u,
   }
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::deleteNode(NodeT *root, NodeT *node) {
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::deleteNode(NodeT *root, NodeT *node) {
   if (root == nullptr || node == nullptr) // nothing to delete or node not found
     return root;
 
+  NodeT *changed = node->parent; // lowest node whose subtree shrank
+
   if (node->left == nullptr) {
     // cases on node doesn't have left subtrees
     transplant(node, node->right);
@@ -161,7 +361,9 @@ BSTNode<Key> *BinarySearchTree<Key>::deleteNode(NodeT *root, NodeT *node) {
   } else {
     // cases on node both have left and right child
     NodeT *sec = minimumNode(node->right); // successor
+    changed = sec;
     if (sec->parent != node) {
+      changed = sec->parent;
       transplant(sec, sec->right);
       sec->right = node->right;
       if (sec->right)
@@ -173,25 +375,26 @@ BSTNode<Key> *BinarySearchTree<Key>::deleteNode(NodeT *root, NodeT *node) {
       sec->left->parent = sec;
     delete node;
   }
+  updateSizeUpward(changed);
   return this->root; // Return the current root
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::minimumNode(NodeT *node) {
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::minimumNode(NodeT *node) {
   while (node->left != nullptr)
     node = node->left;
   return node;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::maximumNode(NodeT *node) {
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::maximumNode(NodeT *node) {
   while (node->right != nullptr)
     node = node->right;
   return node;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::successorNode(NodeT *node) {
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::successorNode(NodeT *node) {
   if (node == nullptr)
     return nullptr;
 
@@ -206,12 +409,13 @@ BSTNode<Key> *BinarySearchTree<Key>::successorNode(NodeT *node) {
   return parent;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::rotateLeft(NodeT *z) {
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::rotateLeft(NodeT *z) {
   NodeT *y = z->right;
   NodeT *T2 = y->left;
   NodeT *z_parent = z->parent;
 
+  countStat(counters, &TreeStats::rotations);
   y->left = z;
   z->right = T2;
 
@@ -231,16 +435,19 @@ BSTNode<Key> *BinarySearchTree<Key>::rotateLeft(NodeT *z) {
 
   updateHeight(z);
   updateHeight(y);
+  updateSize(z);
+  updateSize(y);
 
   return y;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::rotateRight(NodeT *z) {
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::rotateRight(NodeT *z) {
   NodeT *y = z->left;
   NodeT *T3 = y->right;
   NodeT *z_parent = z->parent;
 
+  countStat(counters, &TreeStats::rotations);
   y->right = z;
   z->left = T3;
 
@@ -260,141 +467,437 @@ BSTNode<Key> *BinarySearchTree<Key>::rotateRight(NodeT *z) {
 
   updateHeight(z);
   updateHeight(y);
+  updateSize(z);
+  updateSize(y);
 
   return y; 
 }
 
-template <KeyComparble Key> BSTNode<Key> *BinarySearchTree<Key>::getRoot() {
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::getRoot() {
   return root;
 }
 
-template <KeyComparble Key> void BinarySearchTree<Key>::insert(int key) {
+template <KeyComparble Key, typename Node>
+void BinarySearchTree<Key, Node>::insert(int key) {
+  ScopedLatency<> timer(counters, &TreeStats::insertLatency);
   root = insertNode(root, key, nullptr);
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::search(int key) {
-  return searchNode(root, key);
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::search(int key) {
+  ScopedLatency<> timer(counters, &TreeStats::searchLatency);
+  return searchCounted(counters, root, key);
 }
 
-template <KeyComparble Key> void BinarySearchTree<Key>::remove(int key) {
+template <KeyComparble Key, typename Node>
+void BinarySearchTree<Key, Node>::remove(int key) {
+  ScopedLatency<> timer(counters, &TreeStats::removeLatency);
   NodeT *node = searchNode(root, key);
   if (node) {
     deleteNode(root, node);
   }
 }
 
-template <KeyComparble Key> BSTNode<Key> *BinarySearchTree<Key>::minimum() {
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::minimum() {
   return root ? minimumNode(root) : nullptr;
 }
 
-template <KeyComparble Key> BSTNode<Key> *BinarySearchTree<Key>::maximum() {
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::maximum() {
   return root ? maximumNode(root) : nullptr;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *BinarySearchTree<Key>::successor(int key) {
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::successor(int key) {
   NodeT *node = search(key);
   return successorNode(node);
 }
 
-template <KeyComparble Key>
-void BinarySearchTree<Key>::printWithoutPrefix(NodeT *node) {
+template <KeyComparble Key, typename Node>
+void BinarySearchTree<Key, Node>::searchBatch(std::span<const int> keys,
+                                              std::span<NodeT *> result) {
+  TREE::searchBatch(root, keys, result);
+}
+
+template <KeyComparble Key, typename Node>
+EytzingerIndex<Key> BinarySearchTree<Key, Node>::freeze() {
+  std::vector<Key> keys;
+  for (NodeT *node = minimum(); node != nullptr; node = successorNode(node))
+    keys.push_back(node->key);
+  return EytzingerIndex<Key>(keys.begin(), keys.end());
+}
+
+template <KeyComparble Key, typename Node>
+TreeStats BinarySearchTree<Key, Node>::stats() {
+  TreeStats result = statsOf(counters);
+  collectShape(root, sizeof(*this), result);
+  return result;
+}
+
+template <KeyComparble Key, typename Node>
+void BinarySearchTree<Key, Node>::printWithoutPrefix(NodeT *node) {
   printTree("", node, false);
 }
 
-template <KeyComparble Key>
-void BinarySearchTree<Key>::printWithPrefix(const std::string &string,
-                                            NodeT *node) {
+template <KeyComparble Key, typename Node>
+void BinarySearchTree<Key, Node>::printWithPrefix(const std::string &string,
+                                                  NodeT *node) {
   printTree(string, node, false);
 }
 
-template <KeyComparble Key> int BinarySearchTree<Key>::getHeight(NodeT *node) {
+template <KeyComparble Key, typename Node>
+int BinarySearchTree<Key, Node>::getHeight(NodeT *node) {
   return node ? node->height : 0;
 }
 
-template <KeyComparble Key> int BinarySearchTree<Key>::getBalance(NodeT *node) {
+template <KeyComparble Key, typename Node>
+int BinarySearchTree<Key, Node>::getBalance(NodeT *node) {
   return node ? getHeight(node->left) - getHeight(node->right) : 0;
 }
 
-template <KeyComparble Key>
-void BinarySearchTree<Key>::updateHeight(NodeT *node) {
+template <KeyComparble Key, typename Node>
+void BinarySearchTree<Key, Node>::updateHeight(NodeT *node) {
   if (!node)
     return;
-  node->height = std::max(getHeight(node->left), getHeight(node->right)) + 1;
+  node->height =
+      AVLRules::height(getHeight(node->left), getHeight(node->right));
+}
+
+template <KeyComparble Key, typename Node>
+template <std::forward_iterator It>
+Node *BinarySearchTree<Key, Node>::buildSorted(It &it, It last, int n,
+                                               NodeT *parent) {
+  if (n <= 0)
+    return nullptr;
+
+  // consume the range in order: left half, this node, right half
+  int leftCount = (n - 1) / 2;
+  NodeT *left = buildSorted(it, last, leftCount, nullptr);
+
+  NodeT *node = new NodeT(*it);
+  for (++it; it != last && *it == node->key; ++it) {
+    // skip duplicates of the key just taken
+  }
+  node->parent = parent;
+  node->left = left;
+  if (left)
+    left->parent = node;
+  node->right = buildSorted(it, last, n - 1 - leftCount, node);
+
+  updateHeight(node);
+  if constexpr (SizedNode<Node>)
+    node->size = n;
+  if constexpr (SummarizedNode<Node>)
+    node->updateSummary();
+  return node;
+}
+
+template <KeyComparble Key, typename Node>
+void BinarySearchTree<Key, Node>::destroySubtree(NodeT *node) {
+  // rotate left children up until node has none, then free it and carry on
+  // to the right: every node is rotated at most once, and a degenerate BST
+  // needs no stack
+  while (node != nullptr) {
+    if (NodeT *left = node->left) {
+      node->left = left->right;
+      left->right = node;
+      node = left;
+    } else {
+      NodeT *right = node->right;
+      delete node;
+      node = right;
+    }
+  }
+}
+
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::cloneSubtree(const NodeT *node) {
+  // preorder, so the copies are allocated in the order searches meet them
+  struct Pending {
+    const NodeT *source;
+    NodeT *parent;
+    NodeT **link;
+  };
+  NodeT *copy = nullptr;
+  std::vector<Pending> stack;
+  if (node)
+    stack.push_back({node, nullptr, &copy});
+  while (!stack.empty()) {
+    Pending next = stack.back();
+    stack.pop_back();
+    NodeT *clone = cloneNode(*next.source);
+    clone->parent = next.parent;
+    *next.link = clone;
+    if (next.source->right)
+      stack.push_back({next.source->right, clone, &clone->right});
+    if (next.source->left)
+      stack.push_back({next.source->left, clone, &clone->left});
+  }
+  return copy;
+}
+
+template <KeyComparble Key, typename Node>
+void BinarySearchTree<Key, Node>::updateSizeUpward(NodeT *node) {
+  if constexpr (!SizedNode<Node> && !SummarizedNode<Node>)
+    return;
+  for (; node != nullptr; node = node->parent)
+    updateSize(node);
+}
+
+template <KeyComparble Key, typename Node>
+int BinarySearchTree<Key, Node>::getSize(NodeT *node)
+  requires SizedNode<Node>
+{
+  return node ? node->size : 0;
+}
+
+template <KeyComparble Key, typename Node>
+void BinarySearchTree<Key, Node>::updateSize(NodeT *node) {
+  if (!node)
+    return;
+  if constexpr (SummarizedNode<Node>)
+    node->updateSummary();
+  if constexpr (SizedNode<Node>)
+    node->size = getSize(node->left) + getSize(node->right) + 1;
+}
+
+template <KeyComparble Key, typename Node>
+Node *BinarySearchTree<Key, Node>::select(int k)
+  requires SizedNode<Node>
+{
+  if (k < 0 || k >= getSize(root))
+    return nullptr;
+
+  NodeT *node = root;
+  while (node != nullptr) {
+    int leftSize = getSize(node->left);
+    if (k < leftSize) {
+      node = node->left;
+    } else if (k == leftSize) {
+      return node;
+    } else {
+      k -= leftSize + 1;
+      node = node->right;
+    }
+  }
+  return nullptr;
+}
+
+template <KeyComparble Key, typename Node>
+int BinarySearchTree<Key, Node>::countLess(int key, bool inclusive) {
+  int count = 0;
+  NodeT *node = root;
+  while (node != nullptr) {
+    if (key < node->key || (!inclusive && key == node->key)) {
+      node = node->left;
+    } else {
+      count += getSize(node->left) + 1;
+      node = node->right;
+    }
+  }
+  return count;
+}
+
+template <KeyComparble Key, typename Node>
+int BinarySearchTree<Key, Node>::rank(int key)
+  requires SizedNode<Node>
+{
+  return countLess(key, false);
+}
+
+template <KeyComparble Key, typename Node>
+int BinarySearchTree<Key, Node>::countRange(int lo, int hi)
+  requires SizedNode<Node>
+{
+  if (hi < lo)
+    return 0;
+  return countLess(hi, true) - countLess(lo, false);
+}
+
+template <KeyComparble Key, typename Node>
+auto BinarySearchTree<Key, Node>::aggregate(int lo, int hi)
+  requires AggregateNode<Node>
+{
+  return aggregateRange(root, lo, hi);
 }
 
 //-------------------------------------------------------------------------------
 //                            AVLTree Implementation
 //-------------------------------------------------------------------------------
 
-template <KeyComparble Key> AVLTree<Key>::AVLTree() { this->root = nullptr; }
+template <KeyComparble Key, typename Node>
+AVLTree<Key, Node>::AVLTree() { this->root = nullptr; }
 
-template <KeyComparble Key>
-AVLTree<Key>::AVLTree(std::initializer_list<int> list) {
+template <KeyComparble Key, typename Node>
+AVLTree<Key, Node>::AVLTree(std::initializer_list<int> list) {
   this->root = nullptr;
-  for (auto key : list)
-    AVLTree::insert(key);
+  insertRange(list.begin(), list.end());
 }
 
-template <KeyComparble Key>
-AVLTree<Key> &AVLTree<Key>::operator=(std::initializer_list<int> list) {
-  for (auto key : list)
-    AVLTree::insert(key);
+template <KeyComparble Key, typename Node>
+template <std::input_iterator It>
+AVLTree<Key, Node>::AVLTree(It first, It last) {
+  this->root = nullptr;
+  insertRange(first, last);
+}
+
+template <KeyComparble Key, typename Node>
+AVLTree<Key, Node> &
+AVLTree<Key, Node>::operator=(std::initializer_list<int> list) {
+  insertRange(list.begin(), list.end());
 
   return *this;
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *AVLTree<Key>::balance(NodeT *node) {
+template <KeyComparble Key, typename Node>
+AVLTree<Key, Node>::AVLTree(const AVLTree &other)
+    : BinarySearchTree<Key, Node>(other), fingerSearch(other.fingerSearch) {
+  resetEnds(); // the finger starts over at the root
+}
+
+template <KeyComparble Key, typename Node>
+AVLTree<Key, Node>::AVLTree(AVLTree &&other) noexcept
+    : BinarySearchTree<Key, Node>(std::move(other)),
+      finger(std::exchange(other.finger, nullptr)),
+      fingerSearch(other.fingerSearch),
+      leftmost(std::exchange(other.leftmost, nullptr)),
+      rightmost(std::exchange(other.rightmost, nullptr)) {}
+
+template <KeyComparble Key, typename Node>
+AVLTree<Key, Node> &AVLTree<Key, Node>::operator=(const AVLTree &other) {
+  if (this != &other) {
+    BinarySearchTree<Key, Node>::operator=(other);
+    finger = nullptr;
+    fingerSearch = other.fingerSearch;
+    resetEnds();
+  }
+  return *this;
+}
+
+template <KeyComparble Key, typename Node>
+AVLTree<Key, Node> &AVLTree<Key, Node>::operator=(AVLTree &&other) noexcept {
+  if (this != &other) {
+    BinarySearchTree<Key, Node>::operator=(std::move(other));
+    finger = std::exchange(other.finger, nullptr);
+    fingerSearch = other.fingerSearch;
+    leftmost = std::exchange(other.leftmost, nullptr);
+    rightmost = std::exchange(other.rightmost, nullptr);
+  }
+  return *this;
+}
+
+template <KeyComparble Key, typename Node> void AVLTree<Key, Node>::clear() {
+  BinarySearchTree<Key, Node>::clear();
+  finger = nullptr;
+  resetEnds();
+}
+
+template <KeyComparble Key, typename Node>
+template <std::forward_iterator It>
+AVLTree<Key, Node> AVLTree<Key, Node>::fromSorted(It first, It last) {
+  return AVLTree(first, last);
+}
+
+template <KeyComparble Key, typename Node>
+template <std::input_iterator It>
+void AVLTree<Key, Node>::insertRange(It first, It last) {
+  if constexpr (std::forward_iterator<It>) {
+    // sorted input into an empty tree is built bottom-up, no rebalancing
+    if (this->root == nullptr) {
+      int n = sortedDistinctCount(first, last);
+      if (n >= 0) {
+        this->root = this->buildSorted(first, last, n, nullptr);
+        resetEnds();
+        return;
+      }
+    }
+  }
+  for (; first != last; ++first)
+    AVLTree::insert(*first);
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::balance(NodeT *node) {
   this->updateHeight(node); 
+  this->updateSize(node);
 
-  int balance = this->getBalance(node);
+  int leftHeight = this->getHeight(node->left);
+  int rightHeight = this->getHeight(node->right);
+  if (!AVLRules::unbalanced(leftHeight, rightHeight))
+    return node;
 
-  if (balance > 1) {
-    if (this->getBalance(node->left) < 0) {
+  if (leftHeight > rightHeight) {
+    NodeT *left = node->left;
+    if (!AVLRules::singleRotation(this->getHeight(left->left),
+                                  this->getHeight(left->right))) {
+      countStat(this->counters, &TreeStats::rotationsLR);
       node->left = this->rotateLeft(node->left);
+    } else {
+      countStat(this->counters, &TreeStats::rotationsLL);
     }
     return this->rotateRight(node);
   }
 
-  if (balance < -1) {
-    if (this->getBalance(node->right) > 0) {
-      node->right = this->rotateRight(node->right);
-    }
-    return this->rotateLeft(node);
+  NodeT *right = node->right;
+  if (!AVLRules::singleRotation(this->getHeight(right->right),
+                                this->getHeight(right->left))) {
+    countStat(this->counters, &TreeStats::rotationsRL);
+    node->right = this->rotateRight(node->right);
+  } else {
+    countStat(this->counters, &TreeStats::rotationsRR);
   }
+  return this->rotateLeft(node);
+}
 
-  return node;
+template <KeyComparble Key, typename Node>
+void AVLTree<Key, Node>::retrace(NodeT *node) {
+  // after a leaf insertion: once a subtree keeps its height, or a rotation
+  // restores it, nothing above can go out of balance; only sizes still
+  // need to be carried to the root
+  for (; node != nullptr; node = node->parent) {
+    int old = node->height;
+    NodeT *top = balance(node);
+    if (top != node || top->height == old) {
+      this->updateSizeUpward(top->parent);
+      return;
+    }
+  }
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *AVLTree<Key>::insertNode(NodeT *node, int key, NodeT *parent) {
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::insertNode(NodeT *node, int key, NodeT *parent) {
   if (node == nullptr) { // check value, if not exist, create it
     NodeT *newNode = new NodeT(key);
     newNode->parent = parent;
     if (this->root == nullptr)
       this->root = newNode; // maintain the root
+    trackInserted(newNode);
     return newNode;
   }
 
   // recursively search for appropriate place
   if (key < node->key) {
-    node->left = insertNode(node->left, key, node);
+    node->left = AVLTree::insertNode(node->left, key, node);
   } else if (key > node->key) {
-    node->right = insertNode(node->right, key, node);
+    node->right = AVLTree::insertNode(node->right, key, node);
   } else
     return node; // Duplicate keys not allowed
 
   return balance(node);
 }
 
-template <KeyComparble Key>
-BSTNode<Key> *AVLTree<Key>::deleteNode(NodeT *root, NodeT *node) {
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::deleteNode(NodeT *root, NodeT *node) {
   if (node == nullptr) {
     return root;
   }
 
+  if (node == finger)
+    finger = nullptr;
+  trackRemoved(node);
+
   NodeT *parent = node->parent;
   NodeT *rebalanceStart = nullptr;
 
@@ -453,16 +956,453 @@ BSTNode<Key> *AVLTree<Key>::deleteNode(NodeT *root, NodeT *node) {
   return this->root;
 }
 
-template <KeyComparble Key> void AVLTree<Key>::insert(int key) {
-  this->root = insertNode(this->root, key, nullptr);
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::link(NodeT *left, NodeT *node, NodeT *right) {
+  node->left = left;
+  node->right = right;
+  node->parent = nullptr;
+  if (left)
+    left->parent = node;
+  if (right)
+    right->parent = node;
+  this->updateHeight(node);
+  this->updateSize(node);
+  return node;
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::linkRotateLeft(NodeT *node) {
+  NodeT *y = node->right;
+  return link(link(node->left, node, y->left), y, y->right);
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::linkRotateRight(NodeT *node) {
+  NodeT *y = node->left;
+  return link(y->left, y, link(y->right, node, node->right));
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::joinRight(NodeT *left, NodeT *node,
+                                    NodeT *right) {
+  // left is the taller tree: walk down its right spine until the heights
+  // meet, hang node there and rebalance on the way back up
+  NodeT *l = left->left;
+  NodeT *c = left->right;
+  if (this->getHeight(c) <= this->getHeight(right) + 1) {
+    NodeT *t = link(c, node, right);
+    if (this->getHeight(t) <= this->getHeight(l) + 1)
+      return link(l, left, t);
+    return linkRotateLeft(link(l, left, linkRotateRight(t)));
+  }
+
+  NodeT *t = joinRight(c, node, right);
+  NodeT *joined = link(l, left, t);
+  if (this->getHeight(t) <= this->getHeight(l) + 1)
+    return joined;
+  return linkRotateLeft(joined);
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::joinLeft(NodeT *left, NodeT *node, NodeT *right) {
+  // mirror of joinRight, right is the taller tree
+  NodeT *r = right->right;
+  NodeT *c = right->left;
+  if (this->getHeight(c) <= this->getHeight(left) + 1) {
+    NodeT *t = link(left, node, c);
+    if (this->getHeight(t) <= this->getHeight(r) + 1)
+      return link(t, right, r);
+    return linkRotateRight(link(linkRotateLeft(t), right, r));
+  }
+
+  NodeT *t = joinLeft(left, node, c);
+  NodeT *joined = link(t, right, r);
+  if (this->getHeight(t) <= this->getHeight(r) + 1)
+    return joined;
+  return linkRotateRight(joined);
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::joinNode(NodeT *left, NodeT *node, NodeT *right) {
+  if (this->getHeight(left) > this->getHeight(right) + 1)
+    return joinRight(left, node, right);
+  if (this->getHeight(right) > this->getHeight(left) + 1)
+    return joinLeft(left, node, right);
+  return link(left, node, right);
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::joinNode(NodeT *left, NodeT *right) {
+  if (left == nullptr)
+    return right;
+  NodeT *last = nullptr;
+  NodeT *rest = splitLast(left, last);
+  return joinNode(rest, last, right);
+}
+
+template <KeyComparble Key, typename Node>
+typename AVLTree<Key, Node>::SplitResult
+AVLTree<Key, Node>::splitNode(NodeT *node, int key) {
+  if (node == nullptr)
+    return {nullptr, nullptr, nullptr};
+
+  NodeT *l = node->left;
+  NodeT *r = node->right;
+  if (key == node->key) {
+    node->left = node->right = node->parent = nullptr;
+    return {l, node, r};
+  }
+  if (key < node->key) {
+    SplitResult s = splitNode(l, key);
+    return {s.less, s.found, joinNode(s.greater, node, r)};
+  }
+  SplitResult s = splitNode(r, key);
+  return {joinNode(l, node, s.less), s.found, s.greater};
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::splitLast(NodeT *node, NodeT *&last) {
+  if (node->right == nullptr) {
+    last = node;
+    NodeT *l = node->left;
+    node->left = node->parent = nullptr;
+    return l;
+  }
+  NodeT *rest = splitLast(node->right, last);
+  return joinNode(node->left, node, rest);
+}
+
+template <KeyComparble Key, typename Node>
+bool AVLTree<Key, Node>::shouldFork(NodeT *a, NodeT *b, int depth) {
+  // below ~10^4 nodes a task costs more than it saves
+  return depth < PARALLEL::forkDepth() &&
+         std::min(this->getHeight(a), this->getHeight(b)) >= 14;
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::unionNode(NodeT *a, NodeT *b, int depth) {
+  if (a == nullptr)
+    return b;
+  if (b == nullptr)
+    return a;
+
+  bool fork = shouldFork(a, b, depth); // before split frees anything
+  SplitResult s = splitNode(b, a->key);
+  delete s.found;
+
+  NodeT *al = a->left;
+  NodeT *ar = a->right;
+  NodeT *l = nullptr;
+  NodeT *r = nullptr;
+  if (fork) {
+    PARALLEL::forkJoin([&] { l = unionNode(al, s.less, depth + 1); },
+                       [&] { r = unionNode(ar, s.greater, depth + 1); });
+  } else {
+    l = unionNode(al, s.less, depth + 1);
+    r = unionNode(ar, s.greater, depth + 1);
+  }
+  return joinNode(l, a, r);
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::intersectNode(NodeT *a, NodeT *b, int depth) {
+  if (a == nullptr || b == nullptr) {
+    this->destroySubtree(a);
+    this->destroySubtree(b);
+    return nullptr;
+  }
+
+  bool fork = shouldFork(a, b, depth); // before split frees anything
+  SplitResult s = splitNode(b, a->key);
+
+  NodeT *al = a->left;
+  NodeT *ar = a->right;
+  NodeT *l = nullptr;
+  NodeT *r = nullptr;
+  if (fork) {
+    PARALLEL::forkJoin([&] { l = intersectNode(al, s.less, depth + 1); },
+                       [&] { r = intersectNode(ar, s.greater, depth + 1); });
+  } else {
+    l = intersectNode(al, s.less, depth + 1);
+    r = intersectNode(ar, s.greater, depth + 1);
+  }
+
+  if (s.found) {
+    delete s.found;
+    return joinNode(l, a, r);
+  }
+  delete a;
+  return joinNode(l, r);
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::differenceNode(NodeT *a, NodeT *b, int depth) {
+  if (a == nullptr || b == nullptr) {
+    this->destroySubtree(b);
+    return a;
+  }
+
+  bool fork = shouldFork(a, b, depth); // before split frees anything
+  SplitResult s = splitNode(a, b->key);
+  delete s.found;
+
+  NodeT *bl = b->left;
+  NodeT *br = b->right;
+  NodeT *l = nullptr;
+  NodeT *r = nullptr;
+  if (fork) {
+    PARALLEL::forkJoin([&] { l = differenceNode(s.less, bl, depth + 1); },
+                       [&] { r = differenceNode(s.greater, br, depth + 1); });
+  } else {
+    l = differenceNode(s.less, bl, depth + 1);
+    r = differenceNode(s.greater, br, depth + 1);
+  }
+  delete b;
+  return joinNode(l, r);
+}
+
+template <KeyComparble Key, typename Node>
+void AVLTree<Key, Node>::adopt(NodeT *node) {
+  finger = nullptr; // may point into a tree that was taken apart
+  this->root = node;
+  if (node)
+    node->parent = nullptr;
+  resetEnds();
+}
+
+template <KeyComparble Key, typename Node>
+AVLTree<Key, Node> AVLTree<Key, Node>::join(AVLTree &left, int key,
+                                            AVLTree &right) {
+  AVLTree result;
+  result.adopt(left.joinNode(left.root, new NodeT(key), right.root));
+  left.adopt(nullptr);
+  right.adopt(nullptr);
+  return result;
+}
+
+template <KeyComparble Key, typename Node>
+bool AVLTree<Key, Node>::split(int key, AVLTree &less, AVLTree &greater) {
+  SplitResult s = splitNode(this->root, key);
+  adopt(nullptr);
+
+  this->destroySubtree(less.root);
+  this->destroySubtree(greater.root);
+  less.adopt(s.less);
+  greater.adopt(s.greater);
+
+  bool found = s.found != nullptr;
+  delete s.found;
+  return found;
+}
+
+template <KeyComparble Key, typename Node>
+void AVLTree<Key, Node>::unionWith(AVLTree &other) {
+  if (this == &other)
+    return;
+  adopt(unionNode(this->root, other.root, 0));
+  other.adopt(nullptr);
+}
+
+template <KeyComparble Key, typename Node>
+void AVLTree<Key, Node>::intersectWith(AVLTree &other) {
+  if (this == &other)
+    return;
+  adopt(intersectNode(this->root, other.root, 0));
+  other.adopt(nullptr);
+}
+
+template <KeyComparble Key, typename Node>
+void AVLTree<Key, Node>::differenceWith(AVLTree &other) {
+  if (this == &other) {
+    this->destroySubtree(this->root);
+    adopt(nullptr);
+    return;
+  }
+  adopt(differenceNode(this->root, other.root, 0));
+  other.adopt(nullptr);
+}
+
+template <KeyComparble Key, typename Node>
+void AVLTree<Key, Node>::eraseRange(int lo, int hi) {
+  if (hi < lo)
+    return;
+  // root = [< lo] + [lo, hi] + [> hi]; drop the middle, join the rest
+  SplitResult low = splitNode(this->root, lo);
+  SplitResult high = splitNode(low.greater, hi);
+  delete low.found;
+  delete high.found;
+  this->destroySubtree(high.less);
+  adopt(joinNode(low.less, high.greater));
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::insert(NodeT *hint, int key) {
+  ScopedLatency<> timer(this->counters, &TreeStats::insertLatency);
+  if (this->root == nullptr) {
+    this->root = new NodeT(key);
+    trackInserted(this->root);
+    return this->root;
+  }
+
+  // climb while the parent does not separate key from node; the first
+  // ancestor whose parent does is the root of a subtree that brackets key
+  NodeT *node = hint ? hint : this->root;
+  if (key < node->key) {
+    while (node->parent && !(node->parent->key < key))
+      node = node->parent;
+  } else if (node->key < key) {
+    while (node->parent && !(key < node->parent->key))
+      node = node->parent;
+  }
+
+  for (;;) {
+    if (key < node->key) {
+      if (node->left == nullptr)
+        break;
+      node = node->left;
+    } else if (node->key < key) {
+      if (node->right == nullptr)
+        break;
+      node = node->right;
+    } else {
+      return node; // Duplicate keys not allowed
+    }
+  }
+
+  NodeT *newNode = new NodeT(key);
+  newNode->parent = node;
+  if (key < node->key)
+    node->left = newNode;
+  else
+    node->right = newNode;
+  trackInserted(newNode);
+  retrace(node);
+  return newNode;
+}
+
+template <KeyComparble Key, typename Node>
+template <std::input_iterator It>
+void AVLTree<Key, Node>::insertRuns(It first, It last) {
+  NodeT *hint = finger;
+  for (; first != last; ++first)
+    hint = insert(hint, *first);
+  if (fingerSearch)
+    finger = hint;
+}
+
+template <KeyComparble Key, typename Node>
+void AVLTree<Key, Node>::setFingerSearch(bool enabled) {
+  fingerSearch = enabled;
+  finger = nullptr;
+}
+
+template <KeyComparble Key, typename Node>
+bool AVLTree<Key, Node>::save(const std::string &path) {
+  std::vector<Key> keys;
+  for (NodeT *node = this->minimum(); node; node = this->successorNode(node))
+    keys.push_back(node->key);
+  return saveSnapshot<Key>(path, keys.begin(), keys.end());
+}
+
+template <KeyComparble Key, typename Node>
+bool AVLTree<Key, Node>::load(const std::string &path) {
+  Snapshot<Key> snapshot;
+  if (!snapshot.open(path) || !snapshot.verify())
+    return false;
+
+  std::vector<Key> keys;
+  keys.reserve(snapshot.size());
+  snapshot.forEach([&](const Key &key) { keys.push_back(key); });
+
+  this->destroySubtree(this->root);
+  adopt(nullptr);
+  insertRange(keys.begin(), keys.end());
+  return true;
+}
+
+template <KeyComparble Key, typename Node>
+void AVLTree<Key, Node>::trackInserted(NodeT *node) {
+  if (leftmost == nullptr || node->key < leftmost->key)
+    leftmost = node;
+  if (rightmost == nullptr || rightmost->key < node->key)
+    rightmost = node;
+}
+
+template <KeyComparble Key, typename Node>
+void AVLTree<Key, Node>::trackRemoved(NodeT *node) {
+  // the extremes have at most one child: the next one in line is the
+  // nearest key in that child's subtree, or else the parent
+  if (node == leftmost)
+    leftmost = node->right ? this->minimumNode(node->right) : node->parent;
+  if (node == rightmost)
+    rightmost = node->left ? this->maximumNode(node->left) : node->parent;
+}
+
+template <KeyComparble Key, typename Node>
+void AVLTree<Key, Node>::resetEnds() {
+  NodeT *root = this->root;
+  leftmost = root ? this->minimumNode(root) : nullptr;
+  rightmost = root ? this->maximumNode(root) : nullptr;
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::minimum() {
+  return leftmost;
+}
+
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::maximum() {
+  return rightmost;
+}
+
+template <KeyComparble Key, typename Node>
+std::optional<Key> AVLTree<Key, Node>::peekMin() {
+  return leftmost ? std::optional<Key>(leftmost->key) : std::nullopt;
+}
+
+template <KeyComparble Key, typename Node>
+std::optional<Key> AVLTree<Key, Node>::peekMax() {
+  return rightmost ? std::optional<Key>(rightmost->key) : std::nullopt;
+}
+
+template <KeyComparble Key, typename Node>
+std::optional<Key> AVLTree<Key, Node>::popMin() {
+  if (leftmost == nullptr)
+    return std::nullopt;
+  Key key = leftmost->key;
+  AVLTree::deleteNode(this->root, leftmost);
+  return key;
+}
+
+template <KeyComparble Key, typename Node>
+std::optional<Key> AVLTree<Key, Node>::popMax() {
+  if (rightmost == nullptr)
+    return std::nullopt;
+  Key key = rightmost->key;
+  AVLTree::deleteNode(this->root, rightmost);
+  return key;
+}
+
+template <KeyComparble Key, typename Node>
+void AVLTree<Key, Node>::insert(int key) {
+  if (fingerSearch) {
+    finger = insert(finger, key); // timed there
+    return;
+  }
+  ScopedLatency<> timer(this->counters, &TreeStats::insertLatency);
+  this->root = AVLTree::insertNode(this->root, key, nullptr);
 }
 
-template <KeyComparble Key> BSTNode<Key> *AVLTree<Key>::search(int key) {
-  return this->searchNode(this->root, key);
+template <KeyComparble Key, typename Node>
+Node *AVLTree<Key, Node>::search(int key) {
+  ScopedLatency<> timer(this->counters, &TreeStats::searchLatency);
+  return searchCounted(this->counters, this->root, key);
 }
 
-template <KeyComparble Key> void AVLTree<Key>::remove(int key) {
-  deleteNode(this->root, this->searchNode(this->root, key));
+template <KeyComparble Key, typename Node>
+void AVLTree<Key, Node>::remove(int key) {
+  ScopedLatency<> timer(this->counters, &TreeStats::removeLatency);
+  AVLTree::deleteNode(this->root, this->searchNode(this->root, key));
 }
 
 
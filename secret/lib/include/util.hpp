@@ -1,23 +1,35 @@
 #pragma once
 
+#include "dump.hpp"
 #include "node.hpp"
-#include <string>
 #include <iostream>
+#include <iterator>
+#include <string>
 
 void swap(int *i, int *j);
 
 void printArray(int arr[], int size);
 
-template <KeyComparble Key>
-void printTree(const std::string &prefix, BSTNode<Key> *node, bool isLeft) {
-  if (node == nullptr)
-    return;
-  else {
-    std::cout << prefix;
-    std::cout << (isLeft ? "T-" : "L-");
-    std::cout << node->key << std::endl;
-
-    printTree(prefix + (isLeft ? "|   " : "    "), node->left, true);
-    printTree(prefix + (isLeft ? "|   " : "    "), node->right, false);
+// Number of distinct keys in [first, last) when the range is sorted
+// (non-decreasing), -1 otherwise. Lets the trees pick their O(n) bulk build.
+template <std::forward_iterator It>
+int sortedDistinctCount(It first, It last) {
+  if (first == last)
+    return 0;
+  int count = 1;
+  for (It prev = first++; first != last; prev = first++) {
+    if (*first < *prev)
+      return -1;
+    if (*prev < *first)
+      ++count;
   }
+  return count;
+}
+
+// Prints the tree below node to std::cout, one key per line (see
+// TREE::renderTree, which does the work).
+template <typename NodeT>
+void printTree(const std::string &prefix, const NodeT *node, bool isLeft) {
+  TREE::TreeWriter out(std::cout);
+  TREE::renderTree(out, node, prefix, isLeft);
 }
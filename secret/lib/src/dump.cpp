@@ -0,0 +1,74 @@
+#include "dump.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+
+namespace TREE {
+
+TreeWriter::TreeWriter(int fd, std::size_t capacity)
+    : buffer(capacity > 0 ? capacity : 1), fd(fd) {}
+
+TreeWriter::TreeWriter(std::ostream &stream, std::size_t capacity)
+    : buffer(capacity > 0 ? capacity : 1), stream(&stream) {}
+
+TreeWriter::~TreeWriter() { flush(); }
+
+void TreeWriter::drain() {
+  if (used == 0)
+    return;
+  if (stream != nullptr) {
+    if (!stream->write(buffer.data(), static_cast<std::streamsize>(used)))
+      failed = true;
+  } else {
+    // write(2) may take less than asked for or be interrupted
+    for (std::size_t done = 0; done < used && !failed;) {
+      ssize_t n = ::write(fd, buffer.data() + done, used - done);
+      if (n > 0)
+        done += static_cast<std::size_t>(n);
+      else if (n < 0 && errno == EINTR)
+        continue;
+      else
+        failed = true;
+    }
+  }
+  used = 0; // after a failure the rest of the dump is dropped
+}
+
+void TreeWriter::write(std::string_view text) {
+  while (!text.empty()) {
+    if (used == buffer.size())
+      drain();
+    std::size_t n = std::min(text.size(), buffer.size() - used);
+    text.copy(buffer.data() + used, n);
+    used += n;
+    text.remove_prefix(n);
+  }
+}
+
+void TreeWriter::quoted(std::string_view text) {
+  static constexpr char HEX[] = "0123456789abcdef";
+  put('"');
+  for (char c : text) {
+    auto u = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      put('\\');
+      put(c);
+    } else if (u < 0x20) {
+      write("\\u00");
+      put(HEX[u >> 4]);
+      put(HEX[u & 15]);
+    } else {
+      put(c);
+    }
+  }
+  put('"');
+}
+
+bool TreeWriter::flush() {
+  drain();
+  if (stream != nullptr && !stream->flush())
+    failed = true;
+  return !failed;
+}
+
+} // namespace TREE
@@ -0,0 +1,155 @@
+#include "epoch.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace PARALLEL {
+
+namespace {
+
+// One per thread that ever pinned; records are recycled, never freed.
+// state is 0 while the thread is outside any guard, (epoch << 1) | 1 inside.
+struct alignas(64) Record {
+  std::atomic<std::uint64_t> state{0};
+  std::atomic<bool> owned{true};
+  Record *next{nullptr};
+  int depth{0};
+};
+
+struct Retired {
+  void *object;
+  void (*deleter)(void *);
+  std::uint64_t epoch;
+};
+
+constexpr std::size_t RECLAIM_INTERVAL = 64;
+
+std::atomic<std::uint64_t> globalEpoch{1};
+std::atomic<Record *> records{nullptr};
+
+struct RetireList {
+  std::mutex lock;
+  std::vector<Retired> items;
+  std::size_t sinceReclaim{0};
+
+  ~RetireList() {
+    // a deleter may retire() more objects; keep going until none are left
+    while (!items.empty()) {
+      std::vector<Retired> last;
+      last.swap(items);
+      for (Retired &item : last)
+        item.deleter(item.object);
+    }
+  }
+};
+
+RetireList &retireList() {
+  static RetireList list;
+  return list;
+}
+
+Record *acquireRecord() {
+  for (Record *r = records.load(std::memory_order_acquire); r; r = r->next) {
+    bool expected = false;
+    if (!r->owned.load(std::memory_order_relaxed) &&
+        r->owned.compare_exchange_strong(expected, true))
+      return r;
+  }
+  Record *r = new Record;
+  Record *head = records.load(std::memory_order_relaxed);
+  do {
+    r->next = head;
+  } while (!records.compare_exchange_weak(head, r, std::memory_order_release,
+                                          std::memory_order_relaxed));
+  return r;
+}
+
+struct ThreadRecord {
+  Record *record{acquireRecord()};
+  ~ThreadRecord() { record->owned.store(false, std::memory_order_release); }
+};
+
+Record *threadRecord() {
+  thread_local ThreadRecord holder;
+  return holder.record;
+}
+
+// Called with the retire list locked. Moves the objects no guard can reach
+// any more to ready; the caller runs their deleters once it has unlocked,
+// since a deleter may free a whole structure in a cascade or retire() more
+// objects itself.
+void collectLocked(RetireList &list, std::vector<Retired> &ready) {
+  std::uint64_t epoch = globalEpoch.load(std::memory_order_seq_cst);
+  bool quiescent = true;
+  for (Record *r = records.load(std::memory_order_acquire); r; r = r->next) {
+    std::uint64_t state = r->state.load(std::memory_order_seq_cst);
+    if ((state & 1) && (state >> 1) != epoch) {
+      quiescent = false;
+      break;
+    }
+  }
+  if (quiescent) {
+    globalEpoch.store(epoch + 1, std::memory_order_seq_cst);
+    ++epoch;
+  }
+
+  // objects retired two epochs ago cannot be reachable from any guard
+  std::size_t kept = 0;
+  for (Retired &item : list.items) {
+    if (item.epoch + 2 <= epoch)
+      ready.push_back(item);
+    else
+      list.items[kept++] = item;
+  }
+  list.items.resize(kept);
+  list.sinceReclaim = 0;
+}
+
+void runDeleters(const std::vector<Retired> &ready) {
+  for (const Retired &item : ready)
+    item.deleter(item.object);
+}
+
+} // namespace
+
+EpochGuard::EpochGuard() {
+  Record *r = threadRecord();
+  if (r->depth++ > 0)
+    return;
+  std::uint64_t epoch = globalEpoch.load(std::memory_order_relaxed);
+  r->state.store((epoch << 1) | 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+EpochGuard::~EpochGuard() {
+  Record *r = threadRecord();
+  if (--r->depth > 0)
+    return;
+  r->state.store(0, std::memory_order_release);
+}
+
+void retire(void *object, void (*deleter)(void *)) {
+  RetireList &list = retireList();
+  std::vector<Retired> ready;
+  {
+    std::lock_guard<std::mutex> lock(list.lock);
+    list.items.push_back(
+        {object, deleter, globalEpoch.load(std::memory_order_seq_cst)});
+    if (++list.sinceReclaim >= RECLAIM_INTERVAL)
+      collectLocked(list, ready);
+  }
+  runDeleters(ready);
+}
+
+void reclaim() {
+  RetireList &list = retireList();
+  std::vector<Retired> ready;
+  {
+    std::lock_guard<std::mutex> lock(list.lock);
+    collectLocked(list, ready);
+  }
+  runDeleters(ready);
+}
+
+} // namespace PARALLEL
@@ -0,0 +1,79 @@
+#include "parallel.hpp"
+#include <algorithm>
+
+namespace PARALLEL {
+
+ThreadPool::ThreadPool(unsigned threads) {
+  for (unsigned i = 0; i < threads; ++i)
+    workers.emplace_back([this] { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  ready.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+ThreadPool &ThreadPool::shared() {
+  static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+  return pool;
+}
+
+unsigned ThreadPool::size() const {
+  return static_cast<unsigned>(workers.size());
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+  std::packaged_task<void()> packaged(std::move(task));
+  std::future<void> result = packaged.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(std::move(packaged));
+  }
+  ready.notify_one();
+  return result;
+}
+
+bool ThreadPool::runPending() {
+  std::packaged_task<void()> task;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tasks.empty())
+      return false;
+    task = std::move(tasks.back()); // newest first, it is the smallest
+    tasks.pop_back();
+  }
+  task();
+  return true;
+}
+
+void ThreadPool::workerLoop() {
+  for (;;) {
+    std::packaged_task<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if (stopping && tasks.empty())
+        return;
+      task = std::move(tasks.front()); // oldest first, it is the largest
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+
+int forkDepth() {
+  static const int depth = [] {
+    int levels = 1;
+    while ((1u << levels) < 2 * ThreadPool::shared().size())
+      ++levels;
+    return levels;
+  }();
+  return depth;
+}
+
+} // namespace PARALLEL
@@ -0,0 +1,166 @@
+#include "snapshot.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TREE {
+
+namespace {
+
+constexpr std::uint64_t KEYS_ALIGNMENT = 64; // keep slots on cache lines
+
+std::uint64_t headerChecksum(const SnapshotHeader &header) {
+  return snapshotChecksum(&header, offsetof(SnapshotHeader, headerChecksum));
+}
+
+// write(2) until all of data is out; it may take less than asked for
+bool writeAll(int fd, const void *data, std::size_t bytes) {
+  auto p = static_cast<const unsigned char *>(data);
+  while (bytes > 0) {
+    ssize_t n = ::write(fd, p, bytes);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    bytes -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+// fsync of the directory holding path, which makes a rename into it durable
+bool syncDirectory(const std::string &path) {
+  std::string::size_type slash = path.rfind('/');
+  std::string directory = slash == std::string::npos ? "."
+                          : slash == 0               ? "/"
+                                                     : path.substr(0, slash);
+  int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0)
+    return false;
+  bool ok = ::fsync(fd) == 0;
+  return ::close(fd) == 0 && ok;
+}
+
+} // namespace
+
+std::uint64_t snapshotChecksum(const void *data, std::size_t bytes) {
+  auto p = static_cast<const unsigned char *>(data);
+  std::uint64_t hash = 14695981039346656037ull;
+  for (std::size_t i = 0; i < bytes; ++i) {
+    hash ^= p[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+bool writeSnapshot(const std::string &path, const void *keys,
+                   std::size_t count, std::size_t keySize) {
+  SnapshotHeader header{};
+  std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.keySize = static_cast<std::uint32_t>(keySize);
+  header.count = count;
+  header.keysOffset = (sizeof(SnapshotHeader) + KEYS_ALIGNMENT - 1) /
+                      KEYS_ALIGNMENT * KEYS_ALIGNMENT;
+  header.keysChecksum = snapshotChecksum(keys, count * keySize);
+  header.headerChecksum = headerChecksum(header);
+
+  // write a private file next to the target, make it durable, then rename
+  // it over the target and make the rename durable: a reader, or a crash,
+  // sees the old snapshot or the new one, never a torn or truncated file
+  static std::atomic<unsigned> serial{0};
+  std::string temporary = path + ".tmp." + std::to_string(::getpid()) + "." +
+                          std::to_string(serial.fetch_add(1));
+  int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+  if (fd < 0)
+    return false;
+
+  static const unsigned char padding[KEYS_ALIGNMENT] = {};
+  bool ok = writeAll(fd, &header, sizeof(header)) &&
+            writeAll(fd, padding, header.keysOffset - sizeof(header)) &&
+            writeAll(fd, keys, count * keySize) && ::fsync(fd) == 0;
+  ok = ::close(fd) == 0 && ok;
+  if (ok)
+    ok = std::rename(temporary.c_str(), path.c_str()) == 0;
+  if (!ok) {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return syncDirectory(path);
+}
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : base(other.base), length(other.length) {
+  other.base = nullptr;
+  other.length = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    close();
+    base = other.base;
+    length = other.length;
+    other.base = nullptr;
+    other.length = 0;
+  }
+  return *this;
+}
+
+bool MappedFile::open(const std::string &path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *mapping = ::mmap(nullptr, static_cast<std::size_t>(info.st_size),
+                         PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd); // the mapping keeps the file alive
+  if (mapping == MAP_FAILED)
+    return false;
+
+  // lookups jump around the file, readahead would mostly fetch dead pages
+  ::madvise(mapping, static_cast<std::size_t>(info.st_size), MADV_RANDOM);
+  base = static_cast<const unsigned char *>(mapping);
+  length = static_cast<std::size_t>(info.st_size);
+  return true;
+}
+
+void MappedFile::close() {
+  if (base != nullptr)
+    ::munmap(const_cast<unsigned char *>(base), length);
+  base = nullptr;
+  length = 0;
+}
+
+const SnapshotHeader *checkSnapshot(const MappedFile &file,
+                                    std::size_t keySize) {
+  if (file.size() < sizeof(SnapshotHeader))
+    return nullptr;
+
+  auto header = reinterpret_cast<const SnapshotHeader *>(file.data());
+  if (std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != SNAPSHOT_VERSION ||
+      header->headerChecksum != headerChecksum(*header) ||
+      header->keySize != keySize ||
+      header->keysOffset % KEYS_ALIGNMENT != 0 ||
+      header->keysOffset > file.size())
+    return nullptr;
+
+  std::uint64_t room = (file.size() - header->keysOffset) / keySize;
+  return header->count <= room ? header : nullptr;
+}
+
+} // namespace TREE
@@ -0,0 +1,96 @@
+#include "stats.hpp"
+#include <bit>
+#include <sstream>
+
+namespace TREE {
+
+namespace {
+
+void writeArray(std::ostringstream &out, const std::uint64_t *values,
+                std::size_t count) {
+  out << '[';
+  for (std::size_t i = 0; i < count; ++i)
+    out << (i ? "," : "") << values[i];
+  out << ']';
+}
+
+void writeLatency(std::ostringstream &out, const LatencyHistogram &latency) {
+  // trailing empty buckets carry no information
+  std::size_t used = LatencyHistogram::BUCKETS;
+  while (used > 0 && latency.counts[used - 1] == 0)
+    --used;
+  out << "{\"samples\":" << latency.samples()
+      << ",\"p50_ns\":" << latency.percentile(0.50)
+      << ",\"p99_ns\":" << latency.percentile(0.99)
+      << ",\"p999_ns\":" << latency.percentile(0.999) << ",\"buckets\":";
+  writeArray(out, latency.counts.data(), used);
+  out << '}';
+}
+
+} // namespace
+
+void LatencyHistogram::record(std::uint64_t nanoseconds) {
+  int bucket = nanoseconds == 0 ? 0 : std::bit_width(nanoseconds) - 1;
+  ++counts[bucket < BUCKETS ? bucket : BUCKETS - 1];
+}
+
+void LatencyHistogram::recordShared(std::uint64_t nanoseconds) {
+  int bucket = nanoseconds == 0 ? 0 : std::bit_width(nanoseconds) - 1;
+  std::uint64_t &count = counts[bucket < BUCKETS ? bucket : BUCKETS - 1];
+  std::atomic_ref<std::uint64_t>(count).fetch_add(1, std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::samples() const {
+  std::uint64_t total = 0;
+  for (std::uint64_t count : counts)
+    total += count;
+  return total;
+}
+
+std::uint64_t LatencyHistogram::percentile(double p) const {
+  std::uint64_t total = samples();
+  if (total == 0)
+    return 0;
+  auto rank = static_cast<std::uint64_t>(p * static_cast<double>(total));
+  std::uint64_t seen = 0;
+  for (int b = 0; b < BUCKETS; ++b) {
+    seen += counts[b];
+    if (seen > rank)
+      return std::uint64_t{2} << b;
+  }
+  return std::uint64_t{2} << (BUCKETS - 1);
+}
+
+double TreeStats::averageSearchPath() const {
+  return searches ? static_cast<double>(searchPathTotal) /
+                        static_cast<double>(searches)
+                  : 0.0;
+}
+
+std::string toJson(const TreeStats &stats) {
+  std::ostringstream out;
+  out << "{\"collected\":" << (stats.collected ? "true" : "false")
+      << ",\"nodes\":" << stats.nodes << ",\"bytes\":" << stats.bytes
+      << ",\"rotations\":{\"LL\":" << stats.rotationsLL
+      << ",\"RR\":" << stats.rotationsRR << ",\"LR\":" << stats.rotationsLR
+      << ",\"RL\":" << stats.rotationsRL << ",\"total\":" << stats.rotations
+      << "},\"recolors\":" << stats.recolors << ",\"insert_fixups\":";
+  writeArray(out, stats.insertFixups.data(), stats.insertFixups.size());
+  out << ",\"delete_fixups\":";
+  writeArray(out, stats.deleteFixups.data(), stats.deleteFixups.size());
+  out << ",\"splits\":" << stats.splits << ",\"merges\":" << stats.merges
+      << ",\"search_path\":{\"searches\":" << stats.searches
+      << ",\"average\":" << stats.averageSearchPath()
+      << ",\"max\":" << stats.searchPathMax << "},\"depth_histogram\":";
+  writeArray(out, stats.depthHistogram.data(), stats.depthHistogram.size());
+  out << ",\"latency\":{\"insert\":";
+  writeLatency(out, stats.insertLatency);
+  out << ",\"search\":";
+  writeLatency(out, stats.searchLatency);
+  out << ",\"remove\":";
+  writeLatency(out, stats.removeLatency);
+  out << "}}";
+  return out.str();
+}
+
+} // namespace TREE
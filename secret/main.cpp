@@ -32,15 +32,45 @@
  * ============================================================================
  */
 
+#include "betree.hpp"
 #include "bignum.hpp"
+#include "bplustree.hpp"
+#include "compact.hpp"
+#include "concurrent_rbtree.h"
+#include "concurrent_tree.hpp"
+#include "dump.hpp"
+#include "interval_tree.h"
+#include "monoid.hpp"
+#include "multiset.hpp"
 #include "node.hpp"
+#include "persistent.hpp"
+#include "policy_tree.hpp"
+#include "radix_tree.hpp"
+#include "rbtree.h"
+#include "sharded.hpp"
+#include "snapshot.hpp"
 #include "sort.hpp"
+#include "splay_tree.hpp"
+#include "stats.hpp"
 #include "tree.hpp"
 #include "util.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
+#include <fcntl.h>
+#include <unistd.h>
 
 // Helper function to verify if an array is sorted in ascending order
 bool verifySorted(int arr[], int size, const char *algorithmName) {
@@ -905,6 +935,1461 @@ int main() {
       << std::endl;
   }
 
+  // ==========================================================================
+  // TEST 13: Order Statistics (select / rank / countRange)
+  // ==========================================================================
+  {
+  printTestHeader(13, "Order Statistics - select, rank, countRange");
+  std::cout << "Inserting 1..100 (step 1) into AVL and Red-Black trees, "
+               "then removing every multiple of 10..."
+            << std::endl;
+
+  TREE::OrderStatisticAVLTree<int> avl_os;
+  RBTREE::OrderStatisticRedBlackTree<int> rb_os;
+  for (int v = 1; v <= 100; ++v) {
+    avl_os.insert(v);
+    rb_os.insert(v);
+  }
+  for (int v = 10; v <= 100; v += 10) {
+    avl_os.remove(v);
+    rb_os.remove(v);
+  }
+
+  // 90 keys remain; the k-th smallest skips one multiple of 10 per decade
+  bool ok = true;
+  for (int k = 0; k < 90; ++k) {
+    int expected = k + k / 9 + 1;
+    auto *a = avl_os.select(k);
+    auto *r = rb_os.select(k);
+    if (!a || !r || a->key != expected || r->key != expected) {
+      ok = false;
+      std::cout << "  · select(" << k << ") should be " << expected
+                << std::endl;
+      break;
+    }
+  }
+  ok = ok && avl_os.select(90) == nullptr && rb_os.select(90) == nullptr;
+  ok = ok && avl_os.rank(50) == 45 && rb_os.rank(50) == 45;
+  ok = ok && avl_os.rank(0) == 0 && rb_os.rank(1000) == 90;
+  ok = ok && avl_os.countRange(15, 35) == 19 && rb_os.countRange(15, 35) == 19;
+  ok = ok && avl_os.countRange(35, 15) == 0;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: select/rank/countRange agree on AVL and RB trees"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: order statistics are wrong" << std::endl;
+  }
+  std::cout << "HINT: If failing, check that rotations and deleteNode keep "
+               "subtree sizes current"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 14: Bulk Construction from Sorted Input
+  // ==========================================================================
+  {
+  printTestHeader(14, "Bulk Construction - fromSorted for AVL and RB trees");
+  std::cout << "Building trees from the sorted range 1..1000 (with duplicates)..."
+            << std::endl;
+
+  std::vector<int> sorted;
+  for (int v = 1; v <= 1000; ++v) {
+    sorted.push_back(v);
+    if (v % 100 == 0)
+      sorted.push_back(v); // duplicates are collapsed
+  }
+
+  auto avl_bulk = TREE::OrderStatisticAVLTree<int>::fromSorted(sorted.begin(),
+                                                               sorted.end());
+  auto rb_bulk = RBTREE::OrderStatisticRedBlackTree<int>::fromSorted(
+      sorted.begin(), sorted.end());
+
+  bool ok = avl_bulk.countRange(1, 1000) == 1000 &&
+            rb_bulk.countRange(1, 1000) == 1000;
+
+  // AVL: every node balanced; RB: equal black height on every path
+  auto checkAVL = [&](auto &&self, auto *node) -> int {
+    if (!node)
+      return 0;
+    int lh = self(self, node->left), rh = self(self, node->right);
+    if (lh - rh > 1 || rh - lh > 1 || node->height != std::max(lh, rh) + 1)
+      ok = false;
+    return std::max(lh, rh) + 1;
+  };
+  auto checkRB = [&](auto &&self, auto *node) -> int {
+    if (!node)
+      return 1;
+    bool red = node->color == SizedRBTNode<int>::RED;
+    if (red && ((node->left && node->left->color == SizedRBTNode<int>::RED) ||
+                (node->right && node->right->color == SizedRBTNode<int>::RED)))
+      ok = false;
+    int lb = self(self, node->left), rb = self(self, node->right);
+    if (lb != rb)
+      ok = false;
+    return lb + (red ? 0 : 1);
+  };
+  checkAVL(checkAVL, avl_bulk.getRoot());
+  checkRB(checkRB, rb_bulk.getRoot());
+  ok = ok && rb_bulk.getRoot()->color == SizedRBTNode<int>::BLACK;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: bulk-built trees are balanced and hold every key"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: bulk-built tree violates its invariants"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check the depth that buildSorted colours red"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 15: Join-Based Set Operations
+  // ==========================================================================
+  {
+  printTestHeader(15, "Set Operations - union, intersection, difference");
+  std::cout << "A = multiples of 2 in [0, 3000), B = multiples of 3 in "
+               "[0, 3000)..."
+            << std::endl;
+
+  auto build = [](auto &tree, int step) {
+    for (int v = 0; v < 3000; v += step)
+      tree.insert(v);
+  };
+  auto keysOf = [](auto *root) {
+    std::vector<int> keys;
+    auto walk = [&](auto &&self, auto *node) -> void {
+      if (!node)
+        return;
+      self(self, node->left);
+      keys.push_back(node->key);
+      self(self, node->right);
+    };
+    walk(walk, root);
+    return keys;
+  };
+  auto expected = [](auto keep) {
+    std::vector<int> keys;
+    for (int v = 0; v < 3000; ++v)
+      if (keep(v))
+        keys.push_back(v);
+    return keys;
+  };
+
+  TREE::AVLTree<int> avlA, avlB, avlC, avlD;
+  build(avlA, 2);
+  build(avlB, 3);
+  build(avlC, 2);
+  build(avlD, 3);
+  avlA.unionWith(avlB);
+  avlC.intersectWith(avlD);
+
+  RBTREE::RedBlackTree<int> rbA, rbB;
+  build(rbA, 2);
+  build(rbB, 3);
+  rbA.differenceWith(rbB);
+  rbA.eraseRange(1000, 1999);
+
+  bool ok =
+      keysOf(avlA.getRoot()) ==
+          expected([](int v) { return v % 2 == 0 || v % 3 == 0; }) &&
+      keysOf(avlC.getRoot()) == expected([](int v) { return v % 6 == 0; }) &&
+      keysOf(rbA.getRoot()) == expected([](int v) {
+        return v % 2 == 0 && v % 3 != 0 && (v < 1000 || v > 1999);
+      }) &&
+      avlB.getRoot() == nullptr && rbB.getRoot() == nullptr;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: join/split set operations produce the right keys"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: set operation result is wrong" << std::endl;
+  }
+  std::cout << "HINT: If failing, check how splitNode rebuilds its halves "
+               "with joinNode"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 16: Persistent AVL Tree Snapshots
+  // ==========================================================================
+  {
+  printTestHeader(16, "Persistent AVL Tree - snapshots are isolated");
+  std::cout << "Taking a snapshot after inserting 1..50, then removing the "
+               "even keys..."
+            << std::endl;
+
+  TREE::VersionedAVLTree<int> versioned;
+  for (int v = 1; v <= 50; ++v)
+    versioned.insert(v);
+  auto before = versioned.snapshot();
+  for (int v = 2; v <= 50; v += 2)
+    versioned.remove(v);
+  auto after = versioned.snapshot();
+
+  std::vector<int> beforeKeys, afterKeys;
+  before.forEach([&](int key) { beforeKeys.push_back(key); });
+  after.forEach([&](int key) { afterKeys.push_back(key); });
+
+  bool ok = before.size() == 50 && after.size() == 25 &&
+            beforeKeys.size() == 50 && afterKeys.size() == 25 &&
+            before.search(2) != nullptr && after.search(2) == nullptr &&
+            after.search(49) != nullptr;
+  int height = before.getRoot() ? before.getRoot()->height : 0;
+  ok = ok && height <= 7; // 1.44 * log2(51)
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: old snapshot still sees all 50 keys, new one 25"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: snapshots are not isolated from later writes"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check that insertNode/removeNode copy the "
+               "path instead of mutating shared nodes"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 17: Concurrent Red-Black Tree Readers
+  // ==========================================================================
+  {
+  printTestHeader(17, "Concurrent Red-Black Tree - readers during writes");
+  std::cout << "Two readers look up the even keys 0..998 while a writer "
+               "churns the odd keys..."
+            << std::endl;
+
+  RBTREE::ConcurrentRedBlackTree<int> concurrent;
+  for (int v = 0; v < 1000; v += 2)
+    concurrent.insert(v);
+
+  std::atomic<bool> stop{false};
+  std::atomic<int> misses{0};
+  auto reader = [&](int offset) {
+    for (int round = 0; !stop.load() || round < 2; ++round)
+      for (int v = offset; v < 1000; v += 4)
+        if (!concurrent.contains(v) || concurrent.lowerBound(v) != v)
+          misses++;
+  };
+  std::thread first(reader, 0), second(reader, 2);
+  for (int round = 0; round < 20; ++round) {
+    for (int v = 1; v < 1000; v += 2)
+      concurrent.insert(v);
+    for (int v = 1; v < 1000; v += 2)
+      concurrent.remove(v);
+  }
+  stop = true;
+  first.join();
+  second.join();
+
+  bool ok = misses.load() == 0 && concurrent.contains(998) &&
+            !concurrent.contains(999) &&
+            concurrent.lowerBound(999) == std::nullopt;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: every even key was visible throughout the writes"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: " << misses.load()
+              << " lookups missed a key that was never removed" << std::endl;
+  }
+  std::cout << "HINT: If failing, check that readers retry when the sequence "
+               "number changed under them"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 18: Concurrent AVL Tree Writers
+  // ==========================================================================
+  {
+  printTestHeader(18, "Concurrent AVL Tree - four writers at once");
+  std::cout << "Four threads insert 0..3999 interleaved, then remove the "
+               "odd keys..."
+            << std::endl;
+
+  TREE::ConcurrentAVLTree<int> concurrent;
+  std::atomic<int> failures{0};
+  auto writer = [&](int offset) {
+    for (int v = offset; v < 4000; v += 4)
+      if (!concurrent.insert(v))
+        failures++;
+    for (int v = offset; v < 4000; v += 4)
+      if (v % 2 == 1 && !concurrent.remove(v))
+        failures++;
+  };
+  std::vector<std::thread> writers;
+  for (int offset = 0; offset < 4; ++offset)
+    writers.emplace_back(writer, offset);
+  for (std::thread &t : writers)
+    t.join();
+
+  bool ok = failures.load() == 0;
+  for (int v = 0; v < 4000 && ok; ++v)
+    ok = concurrent.contains(v) == (v % 2 == 0);
+  // 2000 keys plus routing nodes; an AVL tree of 4000 nodes has height <= 17
+  ok = ok && !concurrent.insert(0) && concurrent.height() <= 17;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: exactly the even keys remain and the tree is "
+                 "balanced"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: concurrent updates lost or duplicated keys"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check version validation in attemptUpdate "
+               "and the locking order in fixHeightAndRebalance"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 19: B+ Tree
+  // ==========================================================================
+  {
+  printTestHeader(19, "B+ Tree - same answers as the AVL tree");
+  std::cout << "Inserting 0..9999 (step 3, shuffled) into a B+ tree and an "
+               "AVL tree, then removing every other key..."
+            << std::endl;
+
+  TREE::BPlusTree<int> bplus;
+  TREE::AVLTree<int> avl;
+  for (int i = 0; i < 10000; ++i) {
+    int v = (i * 7919) % 10000 / 3 * 3;
+    bplus.insert(v);
+    avl.insert(v);
+  }
+  for (int v = 0; v < 10000; v += 6) {
+    bplus.remove(v);
+    avl.remove(v);
+  }
+
+  bool ok = true;
+  for (int v = -1; v <= 10000 && ok; ++v) {
+    bool inBplus = bplus.search(v) != nullptr;
+    ok = inBplus == (avl.search(v) != nullptr);
+    if (ok && inBplus) {
+      const int *next = bplus.successor(v);
+      auto *expected = avl.successor(v);
+      ok = (next == nullptr) == (expected == nullptr) &&
+           (next == nullptr || *next == expected->key);
+    }
+  }
+  std::vector<int> scanned;
+  bplus.scan(100, 120, [&](int key) { scanned.push_back(key); });
+  ok = ok && *bplus.minimum() == avl.minimum()->key &&
+       *bplus.maximum() == avl.maximum()->key && bplus.size() == 1667 &&
+       scanned == std::vector<int>{105, 111, 117} && bplus.height() <= 3;
+
+  // an empty tree has no levels, also once its last key is gone
+  TREE::BPlusTree<int> emptied;
+  ok = ok && emptied.height() == 0;
+  emptied.insert(1);
+  ok = ok && emptied.height() == 1;
+  emptied.remove(1);
+  ok = ok && emptied.height() == 0 && emptied.minimum() == nullptr;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: search, successor, min/max and scans agree"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: B+ tree disagrees with the AVL tree" << std::endl;
+  }
+  std::cout << "HINT: If failing, check separator updates in fixUnderflow and "
+               "the leaf links in splitLeaf/mergeChildren"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 20: Frozen Eytzinger Index
+  // ==========================================================================
+  {
+  printTestHeader(20, "Eytzinger Index - freeze() keeps the tree's answers");
+  std::cout << "Freezing AVL and Red-Black trees holding the multiples of 5 "
+               "in 0..995..."
+            << std::endl;
+
+  TREE::AVLTree<int> avl;
+  RBTREE::RedBlackTree<int> rb;
+  for (int v = 0; v < 1000; v += 5) {
+    avl.insert(v);
+    rb.insert(v);
+  }
+  auto frozenAvl = avl.freeze();
+  auto frozenRb = rb.freeze();
+
+  std::vector<int> queries;
+  for (int v = -3; v < 1003; ++v)
+    queries.push_back(v);
+  std::vector<const int *> bounds(queries.size());
+  frozenRb.lowerBoundBatch(queries, bounds);
+
+  bool ok = frozenAvl.size() == 200 && frozenRb.size() == 200;
+  for (std::size_t i = 0; i < queries.size() && ok; ++i) {
+    int v = queries[i];
+    int expected = v <= 0 ? 0 : (v + 4) / 5 * 5;
+    const int *bound = frozenAvl.lowerBound(v);
+    ok = frozenAvl.contains(v) == (v >= 0 && v < 1000 && v % 5 == 0) &&
+         (expected < 1000 ? bound && *bound == expected && bounds[i] &&
+                                *bounds[i] == expected
+                          : bound == nullptr && bounds[i] == nullptr);
+  }
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: contains, lowerBound and the batched lookups "
+                 "match the trees"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: frozen index answers differ from the tree"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check the in-order fill of the Eytzinger "
+               "slots and the trailing-ones shift in descend()"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 21: Compact Index-Linked Trees
+  // ==========================================================================
+  {
+  printTestHeader(21, "Compact Trees - 32-bit links, packed balance and colour");
+  std::cout << "Inserting 0..1999, removing the odd keys from compact AVL "
+               "and Red-Black trees..."
+            << std::endl;
+
+  TREE::CompactAVLTree<int> avl;
+  RBTREE::CompactRedBlackTree<int> rb;
+  for (int v = 0; v < 2000; ++v) {
+    avl.insert((v * 7) % 2000);
+    rb.insert((v * 7) % 2000);
+  }
+  for (int v = 1; v < 2000; v += 2) {
+    avl.remove(v);
+    rb.remove(v);
+  }
+  std::size_t before = avl.memoryUsage();
+  for (int v = 1; v < 2000; v += 2)
+    avl.insert(v); // refills released slots
+
+  bool ok = avl.size() == 2000 && rb.size() == 1000 &&
+            avl.memoryUsage() == before && avl.height() <= 15 &&
+            *avl.minimum() == 0 && *avl.maximum() == 1999 &&
+            *rb.minimum() == 0 && *rb.maximum() == 1998 &&
+            sizeof(CompactAVLNode<int>) == 12 &&
+            sizeof(CompactRBTNode<int>) == 16;
+  for (int v = 0; v < 2000 && ok; ++v)
+    ok = avl.search(v) != nullptr && (rb.search(v) != nullptr) == (v % 2 == 0);
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: both trees stay ordered and balanced at 12/16 "
+                 "bytes per node"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: compact trees lost keys, balance or slots"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check the balance bits kept in right and "
+               "the colour bit kept in parent"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 22: Policy-Based Trees
+  // ==========================================================================
+  {
+  printTestHeader(22, "Policy Trees - compile-time AVL / Red-Black balancing");
+  std::cout << "Running the same inserts and removes on the static and "
+               "virtual trees..."
+            << std::endl;
+
+  TREE::StaticAVLTree<int> staticAvl;
+  RBTREE::StaticRedBlackTree<int> staticRb;
+  TREE::StaticBinarySearchTree<int> staticBst;
+  TREE::AVLTree<int> avl;
+  for (int v = 0; v < 3000; ++v) {
+    int key = (v * 37) % 3000;
+    staticAvl.insert(key);
+    staticRb.insert(key);
+    staticBst.insert(key);
+    avl.insert(key);
+  }
+  for (int v = 0; v < 3000; v += 3) {
+    staticAvl.remove(v);
+    staticRb.remove(v);
+    staticBst.remove(v);
+    avl.remove(v);
+  }
+
+  bool ok = staticAvl.size() == 2000 && staticRb.size() == 2000 &&
+            staticBst.size() == 2000 &&
+            staticAvl.height() == avl.getHeight(avl.getRoot()) &&
+            staticRb.height() <= 22 && !staticAvl.insert(1) &&
+            staticRb.minimum()->key == 1 && staticAvl.maximum()->key == 2999;
+  for (int v = 0; v < 3000 && ok; ++v) {
+    bool expected = avl.search(v) != nullptr;
+    ok = (staticAvl.search(v) != nullptr) == expected &&
+         (staticRb.search(v) != nullptr) == expected &&
+         (staticBst.search(v) != nullptr) == expected;
+  }
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: all three policies agree with AVLTree" << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: a balancing policy lost keys or balance"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check the replace/afterRemove hooks of the "
+               "balancing policies"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 23: Hinted and Finger Insertion
+  // ==========================================================================
+  {
+  printTestHeader(23, "AVL Tree - hinted, finger and sorted-run insertion");
+  std::cout << "Inserting a nearly sorted stream in finger mode, then runs "
+               "and hinted keys..."
+            << std::endl;
+
+  TREE::OrderStatisticAVLTree<int> tree;
+  tree.setFingerSearch(true);
+  for (int i = 0; i < 5000; ++i)
+    tree.insert(i * 2 + (i % 10 == 0 ? -3 : 0)); // late arrivals now and then
+  tree.remove(4002);
+
+  std::vector<int> runs = {1, 3, 5, 7, 9, 6001, 6003, 6005, 11, 13};
+  tree.insertRuns(runs.begin(), runs.end());
+
+  SizedBSTNode<int> *hint = tree.search(5002);
+  SizedBSTNode<int> *placed = tree.insert(hint, 5003);
+  SizedBSTNode<int> *existing = tree.insert(placed, 5002);
+
+  bool ok = placed && placed->key == 5003 && existing == hint &&
+            tree.countRange(-10, 20000) == 5000 - 1 + 10 + 1 &&
+            tree.getHeight(tree.getRoot()) <= 18 && !tree.search(4002);
+  for (int i = 1; i < 5000 && ok; ++i)
+    ok = i == 2001 || tree.search(i * 2 + (i % 10 == 0 ? -3 : 0)) != nullptr;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: every key placed once, tree stays balanced"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: hinted insertion misplaced or duplicated keys"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check the climb from the hint and the "
+               "early exit in retrace()"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 24: Binary Snapshots
+  // ==========================================================================
+  {
+  printTestHeader(24, "Snapshots - save, mmap-served lookups and load");
+  std::cout << "Saving a Red-Black tree of 10000 keys, serving and reloading "
+               "it..."
+            << std::endl;
+
+  std::string path =
+      (std::filesystem::temp_directory_path() /
+       ("secret_tree_test." + std::to_string(::getpid()) + ".snap"))
+          .string();
+  RBTREE::RedBlackTree<int> rb;
+  for (int v = 0; v < 10000; ++v)
+    rb.insert(v * 3);
+  bool ok = rb.save(path);
+
+  TREE::Snapshot<int> mapped;
+  ok = ok && mapped.open(path) && mapped.verify() && mapped.size() == 10000;
+  for (int v = -1; v < 30001 && ok; v += 7) {
+    const int *bound = mapped.lowerBound(v);
+    int expected = v <= 0 ? 0 : (v + 2) / 3 * 3;
+    ok = mapped.contains(v) == (v >= 0 && v % 3 == 0 && v < 30000) &&
+         (expected < 30000 ? bound && *bound == expected : bound == nullptr);
+  }
+
+  TREE::OrderStatisticAVLTree<int> avl = {1, 2};
+  RBTREE::OrderStatisticRedBlackTree<int> reloaded;
+  ok = ok && avl.load(path) && reloaded.load(path) &&
+       avl.countRange(0, 30000) == 10000 && reloaded.rank(30000) == 10000 &&
+       avl.search(29997) && !avl.search(1) && reloaded.search(0);
+
+  {
+    // flip one key byte: the header still opens, the checksum must not pass
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(100);
+    file.put('\x7f');
+  }
+  TREE::Snapshot<int> corrupt;
+  ok = ok && corrupt.open(path) && !corrupt.verify() && !avl.load(path) &&
+       avl.search(29997);
+  std::filesystem::remove(path);
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: snapshot answers match, reload is exact, "
+                 "corruption is caught"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: snapshot lost keys or accepted a corrupt file"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check keysOffset, the Eytzinger slot order "
+               "and the checksums in snapshot.cpp"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 25: Tree Statistics
+  // ==========================================================================
+  {
+  printTestHeader(25, "Tree Stats - shape, counters and JSON export");
+  std::cout << "Collecting stats from every tree, 1000 keys each "
+            << (TREE::STATS_ENABLED ? "(TREE_STATS on)" : "(TREE_STATS off)")
+            << "..." << std::endl;
+
+  TREE::AVLTree<int> avl;
+  RBTREE::RedBlackTree<int> rb;
+  for (int v = 0; v < 1000; ++v) {
+    avl.insert(v);
+    rb.insert(v);
+  }
+  for (int v = 0; v < 1000; v += 4) {
+    avl.search(v);
+    rb.remove(v);
+  }
+
+  TREE::TreeStats avlStats = avl.stats();
+  TREE::TreeStats rbStats = rb.stats();
+  std::uint64_t depthTotal = 0;
+  for (std::uint64_t nodes : avlStats.depthHistogram)
+    depthTotal += nodes;
+
+  bool ok = avlStats.nodes == 1000 && depthTotal == 1000 &&
+            avlStats.depthHistogram.size() == 10 && rbStats.nodes == 750 &&
+            avlStats.bytes >= 1000 * sizeof(BSTNode<int>);
+  if (TREE::STATS_ENABLED) {
+    // ascending keys only ever need single left rotations
+    ok = ok && avlStats.rotationsRR > 0 && avlStats.rotationsLL == 0 &&
+         avlStats.searches == 250 && avlStats.searchPathMax <= 10 &&
+         avlStats.insertLatency.samples() == 1000 && rbStats.recolors > 0 &&
+         rbStats.deleteFixups[1] > 0 && rbStats.removeLatency.samples() == 250;
+  } else {
+    ok = ok && avlStats.rotations == 0 && !avlStats.collected;
+  }
+
+  // the other trees report through the same TreeStats
+  TREE::StaticAVLTree<int> policy;
+  RBTREE::StaticRedBlackTree<int> policyRB;
+  TREE::CompactAVLTree<int> compact;
+  RBTREE::CompactRedBlackTree<int> compactRB;
+  TREE::SplayTree<int> splay;
+  TREE::Multiset<int> multiset;
+  TREE::ConcurrentAVLTree<int> concurrent;
+  TREE::BPlusTree<int> bplus;
+  TREE::BEpsilonTree<int> betree;
+  TREE::AdaptiveRadixTree<int> art;
+  for (int v = 0; v < 1000; ++v) {
+    policy.insert(v);
+    policyRB.insert(v);
+    compact.insert(v);
+    compactRB.insert(v);
+    splay.insert(v);
+    multiset.insert(v);
+    concurrent.insert(v);
+    bplus.insert(v);
+    betree.insert(v);
+    art.insert(v);
+  }
+  for (int v = 0; v < 1000; v += 4) {
+    policy.search(v);
+    policyRB.search(v);
+    compact.search(v);
+    compactRB.search(v);
+    splay.search(v);
+    multiset.contains(v);
+    concurrent.contains(v);
+    bplus.search(v);
+    betree.search(v);
+    art.search(v);
+  }
+  std::vector<TREE::TreeStats> binary = {
+      policy.stats(), policyRB.stats(), compact.stats(), compactRB.stats(),
+      splay.stats(),  multiset.stats(), concurrent.stats()};
+  std::vector<TREE::TreeStats> others = binary;
+  others.push_back(bplus.stats());
+  others.push_back(betree.stats());
+  others.push_back(art.stats());
+  for (const TREE::TreeStats &stats : binary)
+    ok = ok && stats.nodes == 1000;
+  for (const TREE::TreeStats &stats : others) {
+    ok = ok && stats.nodes > 0 && stats.bytes > 0 &&
+         !stats.depthHistogram.empty();
+    if (TREE::STATS_ENABLED)
+      ok = ok && stats.searches == 250 && stats.searchPathMax > 0 &&
+           stats.insertLatency.samples() == 1000;
+  }
+  if (TREE::STATS_ENABLED)
+    ok = ok && binary[0].rotationsRR > 0 && binary[1].insertFixups[2] > 0 &&
+         binary[2].rotationsRR > 0 && binary[3].recolors > 0 &&
+         binary[6].rotations > 0 && others[7].splits > 0;
+
+  std::string json = TREE::toJson(avlStats);
+  ok = ok && json.front() == '{' && json.back() == '}' &&
+       json.find("\"depth_histogram\":[1,2,4,8,16,32,64,128,256,489]") !=
+           std::string::npos;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: stats describe the trees, JSON export is "
+                 "complete"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: stats disagree with the trees: " << json
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check collectShape()/countNode() and the "
+               "countStat hooks in balance()/fixInsert()/fixDelete()"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 26: Interval Tree
+  // ==========================================================================
+  {
+  printTestHeader(26, "Interval Tree - overlap and stabbing queries");
+  std::cout << "Storing 1000 intervals [i, i + 9] and querying them..."
+            << std::endl;
+
+  RBTREE::IntervalTree<int> intervals;
+  for (int i = 0; i < 1000; ++i)
+    intervals.insert(i, i + 9);
+  intervals.insert(500, 2000); // shares its low end with [500, 509]
+
+  int overlaps = 0;
+  bool sorted = true;
+  int lastLow = -1;
+  intervals.overlapping(100, 104, [&](int low, int high) {
+    ++overlaps;
+    sorted = sorted && lastLow <= low && low <= 104 && high >= 100;
+    lastLow = low;
+  });
+  int stabbed = 0;
+  intervals.stabbing(1500, [&](int, int) { ++stabbed; });
+  int afterRemove = 0;
+  intervals.remove(500, 2000);
+  intervals.stabbing(1500, [&](int, int) { ++afterRemove; });
+  intervals.insert(3000, 3001);
+  intervals.insert(3000, 3001); // a second copy gets its own node
+  bool copies = intervals.remove(3000, 3001) &&
+                intervals.contains(3000, 3001) &&
+                intervals.remove(3000, 3001) && !intervals.contains(3000, 3001);
+
+  bool ok = overlaps == 14 && sorted && stabbed == 1 && afterRemove == 0 &&
+            copies && intervals.size() == 1000 && intervals.contains(500, 509) &&
+            !intervals.contains(500, 2000) &&
+            intervals.overlapsAny(1008, 1200) &&
+            !intervals.overlapsAny(1009, 1200) && !intervals.remove(7, 7);
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: " << overlaps
+              << " overlaps reported in order, stabbing and removal agree"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: interval queries returned " << overlaps
+              << " overlaps, " << stabbed << " stabbed" << std::endl;
+  }
+  std::cout << "HINT: If failing, check IntervalNode::updateSummary() and "
+               "the updateSize() calls in rotations and unlinkNode()"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 27: Range Aggregates
+  // ==========================================================================
+  {
+  printTestHeader(27, "Monoid Aggregates - range sums, min and max");
+  std::cout << "Summing key ranges of AVL and Red-Black trees holding "
+               "1..10000..."
+            << std::endl;
+
+  TREE::AggregateAVLTree<int, TREE::SumMonoid<int>> sums;
+  RBTREE::AggregateRedBlackTree<int, TREE::MaxMonoid<int>> maxima;
+  for (int v = 1; v <= 10000; ++v) {
+    sums.insert(v);
+    maxima.insert(v);
+  }
+  for (int v = 2; v <= 10000; v += 2) {
+    sums.remove(v); // odd keys remain
+    maxima.remove(v);
+  }
+
+  long long all = sums.aggregate(1, 10000);
+  long long middle = sums.aggregate(101, 200); // 101 + 103 + ... + 199
+  bool ok = all == 25000000LL && middle == 7500 &&
+            sums.aggregate(2, 2) == 0 && sums.aggregate(50, 10) == 0 &&
+            maxima.aggregate(0, 5000) == 4999 &&
+            maxima.aggregate(20000, 30000) ==
+                std::numeric_limits<int>::lowest();
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: sum " << all << ", [101, 200] sums to " << middle
+              << ", range maxima agree" << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: range aggregates are off (sum " << all
+              << ", [101, 200] " << middle << ")" << std::endl;
+  }
+  std::cout << "HINT: If failing, check updateSummary() calls in updateSize() "
+               "and aggregateRange() in monoid.hpp"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 28: Splay Tree
+  // ==========================================================================
+  {
+  printTestHeader(28, "Splay Tree - hot keys move to the root");
+  std::cout << "Inserting 0..9999 in order, then reading a few hot keys..."
+            << std::endl;
+
+  TREE::SplayTree<int> splay;
+  for (int v = 0; v < 10000; ++v)
+    splay.insert(v);
+  bool ok = splay.getRoot()->key == 9999; // every access ends at the root
+  ok = ok && splay.search(1234) && splay.getRoot()->key == 1234;
+  ok = ok && !splay.search(-5) && splay.getRoot()->key == 0;
+  for (int v = 0; v < 10000; v += 2)
+    splay.remove(v);
+  ok = ok && !splay.search(1234) && splay.search(1235) &&
+       splay.minimum()->key == 1 && splay.maximum()->key == 9999;
+
+  TREE::SplayTree<int, SizedBSTNode<int>> semi{50, 20, 80, 10, 30, 70, 90};
+  semi.setSemiSplay(true);
+  for (int round = 0; round < 3; ++round)
+    ok = ok && semi.search(10) && semi.search(90);
+  ok = ok && semi.rank(80) == 5 && semi.getRoot()->key == 90;
+
+  // top-down splaying keeps the sizes of sized nodes, and batched reads
+  // splay like single ones
+  TREE::SplayTree<int, SizedBSTNode<int>> sized;
+  for (int v = 0; v < 1000; ++v)
+    sized.insert(v * 7919 % 1000);
+  for (int v = 0; v < 1000; v += 2)
+    sized.remove(v);
+  for (int k = 0; k < 500; k += 37)
+    ok = ok && sized.select(k)->key == 2 * k + 1 && sized.rank(2 * k + 1) == k;
+  int wanted[] = {4, 5, 999};
+  SizedBSTNode<int> *found[3];
+  sized.searchBatch(wanted, found);
+  ok = ok && !found[0] && found[1] && found[2] &&
+       sized.getRoot()->key == 999 && sized.countRange(0, 999) == 500;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: accessed keys surface at the root, semi-splay "
+                 "keeps order"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: splay tree lost a key or did not splay"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check splay()/splayHalfway(), the size "
+               "repairs and the join in SplayTree::remove()"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 29: Multiset
+  // ==========================================================================
+  {
+  printTestHeader(29, "Multiset - duplicate counts held in the node");
+  std::cout << "Inserting 10000 values drawn from 10 distinct keys..."
+            << std::endl;
+
+  TREE::Multiset<int> bag;
+  for (int i = 0; i < 10000; ++i)
+    bag.insert(i % 10);
+  bag.insert(42, 5);
+
+  bool ok = bag.size() == 10005 && bag.distinct() == 11 &&
+            bag.count(3) == 1000 && bag.count(42) == 5 && bag.count(7) == 1000;
+  ok = ok && bag.eraseOne(3) && bag.count(3) == 999 && !bag.eraseOne(100);
+  ok = ok && bag.eraseAll(42) == 5 && !bag.contains(42) &&
+       bag.eraseAll(42) == 0 && bag.distinct() == 10;
+
+  int expectedKey = 0;
+  bool inOrder = true;
+  bag.forEach([&](int key, int copies) {
+    inOrder = inOrder && key == expectedKey++ &&
+              copies == (key == 3 ? 999 : 1000);
+  });
+  ok = ok && inOrder && expectedKey == 10 && bag.size() == 9999;
+
+  // ascending keys hang off the rightmost leaf; the AVL retrace must still
+  // keep the tree within its height bound
+  TREE::Multiset<int> ascending;
+  for (int i = 0; i < 1023; ++i)
+    ascending.insert(i, 2);
+  ok = ok && ascending.distinct() == 1023 && ascending.count(511) == 2 &&
+       ascending.stats().depthHistogram.size() <= 14;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: " << bag.size() << " values in "
+              << bag.distinct() << " nodes, counts and erasures agree"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: multiset counts are off, size " << bag.size()
+              << ", distinct " << bag.distinct() << std::endl;
+  }
+  std::cout << "HINT: If failing, check Multiset::insert() and when "
+               "eraseOne() drops the node"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 30: Batched Lookups
+  // ==========================================================================
+  {
+  printTestHeader(30, "searchBatch - interleaved descents match search()");
+  std::cout << "Looking up 1000 hits and misses in one batch..." << std::endl;
+
+  TREE::AVLTree<int> avl;
+  RBTREE::RedBlackTree<int> rb;
+  for (int v = 0; v < 4000; v += 2) {
+    avl.insert(v);
+    rb.insert(v);
+  }
+  std::vector<int> keys;
+  for (int v = 0; v < 1000; ++v)
+    keys.push_back((v * 7919) % 4000); // every other one odd, so a miss
+
+  std::vector<BSTNode<int> *> avlFound(keys.size());
+  std::vector<RBTNode<int> *> rbFound(keys.size());
+  avl.searchBatch(keys, avlFound);
+  rb.searchBatch(keys, rbFound);
+
+  int hits = 0;
+  bool ok = true;
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    ok = ok && avlFound[i] == avl.search(keys[i]) &&
+         rbFound[i] == rb.search(keys[i]);
+    hits += avlFound[i] != nullptr;
+  }
+  ok = ok && hits == 500;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: " << hits
+              << " hits, every batched answer matches search()" << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: searchBatch disagrees with search(), " << hits
+              << " hits" << std::endl;
+  }
+  std::cout << "HINT: If failing, check how searchBatch() in batch.hpp "
+               "refills and retires its slots"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 31: Double-Ended Priority Queue
+  // ==========================================================================
+  {
+  printTestHeader(31, "popMin/popMax - cached extremes as a priority queue");
+  std::cout << "Draining both ends of 1000 keys, with removals in between..."
+            << std::endl;
+
+  TREE::AVLTree<int> avl;
+  RBTREE::RedBlackTree<int> rb;
+  for (int v = 0; v < 1000; ++v) {
+    avl.insert((v * 7919) % 1000);
+    rb.insert((v * 7919) % 1000);
+  }
+  avl.remove(0);
+  rb.remove(999);
+
+  bool ok = avl.peekMin() == 1 && avl.peekMax() == 999 &&
+            rb.peekMin() == 0 && rb.peekMax() == 998;
+  int lo = 1, hi = 999;
+  for (int i = 0; i < 499; ++i)
+    ok = ok && avl.popMin() == lo++ && avl.popMax() == hi--;
+  ok = ok && avl.minimum()->key == 500 && avl.maximum()->key == 500;
+  ok = ok && avl.popMax() == 500 && !avl.popMin() && !avl.peekMax() &&
+       avl.minimum() == nullptr;
+
+  for (int v = 0; v < 999; ++v)
+    ok = ok && rb.popMin() == v;
+  ok = ok && !rb.popMax() && rb.maximum() == nullptr;
+  rb.insert(42);
+  ok = ok && rb.peekMin() == 42 && rb.peekMax() == 42;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: both trees popped every key in order from either "
+                 "end"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: a pop or peek returned the wrong key" << std::endl;
+  }
+  std::cout << "HINT: If failing, check trackRemoved() and where resetEnds() "
+               "is called"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 32: Sharded Set
+  // ==========================================================================
+  {
+  printTestHeader(32, "ShardedSet - four producers, adaptive split points");
+  std::cout << "Four threads inserting 0..39999 into four shards whose "
+               "initial ranges put every key in one shard..."
+            << std::endl;
+
+  TREE::ShardedSet<RBTREE::RedBlackTree<int>> sharded(4);
+  std::vector<std::thread> producers;
+  for (int t = 0; t < 4; ++t) {
+    producers.emplace_back([&sharded, t] {
+      for (int v = t; v < 40000; v += 4)
+        sharded.insert(v);
+    });
+  }
+  for (auto &producer : producers)
+    producer.join();
+
+  // rebalancing moved the split points into 0..39999, so all shards fill
+  bool ok = sharded.size() == 40000;
+  for (int i = 0; i < sharded.shardCount(); ++i)
+    ok = ok && sharded.shardSize(i) > 0;
+  for (int v = 0; v < 40000; v += 2)
+    ok = ok && sharded.remove(v);
+  sharded.rebalance();
+  for (int i = 0; i < sharded.shardCount(); ++i)
+    ok = ok && sharded.shardSize(i) == 5000;
+
+  int expected = 1;
+  sharded.forEach([&](int key) {
+    ok = ok && key == expected;
+    expected += 2;
+  });
+  std::vector<int> range;
+  sharded.forEachInRange(19995, 20005, [&](int key) { range.push_back(key); });
+  ok = ok && expected == 40001 && !sharded.contains(20000) &&
+       sharded.lowerBound(20000) == 20001 && !sharded.lowerBound(40000) &&
+       range == std::vector<int>{19995, 19997, 19999, 20001, 20003, 20005};
+
+  // the visitor runs unlocked, so it may call back into the set
+  int reentered = 0;
+  sharded.forEachInRange(19995, 20005, [&](int key) {
+    reentered += sharded.contains(key) && sharded.insert(key + 1);
+  });
+  for (int v = 19996; v <= 20006; v += 2)
+    ok = ok && sharded.remove(v);
+  ok = ok && reentered == 6 && sharded.size() == 20000;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: 20000 keys left, 5000 per shard, merged "
+                 "iteration in order"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: sharded set lost keys or split unevenly"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check the range re-check in withShard() "
+               "and the quantile splits in repartition()"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 33: Bε-Tree
+  // ==========================================================================
+  {
+  printTestHeader(33, "Bε-Tree - buffered writes, same answers as std::set");
+  std::cout << "Streaming 20000 inserts and removes through 1 KB buffers, "
+               "querying before and after a full flush..."
+            << std::endl;
+
+  TREE::BEpsilonTree<int, 1024> buffered;
+  std::set<int> reference;
+  for (int i = 0; i < 20000; ++i) {
+    int v = (i * 7919) % 5000;
+    if (i % 3 == 2) {
+      buffered.remove(v);
+      reference.erase(v);
+    } else {
+      buffered.insert(v);
+      reference.insert(v);
+    }
+  }
+
+  // most of the recent messages are still sitting in buffers here
+  bool ok = true;
+  for (int v = -1; v <= 5000 && ok; ++v)
+    ok = buffered.search(v).has_value() == (reference.count(v) > 0);
+  std::vector<int> scanned;
+  buffered.scan(100, 200, [&](int key) { scanned.push_back(key); });
+  ok = ok && scanned == std::vector<int>(reference.lower_bound(100),
+                                         reference.upper_bound(200));
+  ok = ok && buffered.minimum() == *reference.begin() &&
+       buffered.maximum() == *reference.rbegin();
+
+  // size() is a running count, it must not need the buffers emptied
+  ok = ok && buffered.size() == static_cast<int>(reference.size());
+  buffered.flush();
+  ok = ok && buffered.size() == static_cast<int>(reference.size()) &&
+       buffered.minimum() == *reference.begin() &&
+       buffered.maximum() == *reference.rbegin();
+  scanned.clear();
+  buffered.scan(std::numeric_limits<int>::min(),
+                std::numeric_limits<int>::max(),
+                [&](int key) { scanned.push_back(key); });
+  ok = ok && scanned == std::vector<int>(reference.begin(), reference.end());
+
+  // emptied leaves and inner nodes merge, so the tree shrinks back
+  TREE::BEpsilonTree<int, 1024> shrinking;
+  ok = ok && shrinking.height() == 0 && shrinking.size() == 0;
+  for (int v = 0; v < 50000; ++v)
+    shrinking.insert(v);
+  shrinking.flush();
+  ok = ok && shrinking.size() == 50000 && shrinking.height() > 2;
+  for (int v = 0; v < 50000; ++v)
+    if (v % 10000 != 0)
+      shrinking.remove(v);
+  shrinking.remove(-1); // absent keys leave the count alone
+  ok = ok && shrinking.size() == 5 && shrinking.minimum() == 0 &&
+       shrinking.maximum() == 40000;
+  shrinking.flush();
+  ok = ok && shrinking.size() == 5 && shrinking.height() == 2 &&
+       shrinking.search(30000) == 30000 && !shrinking.search(30001);
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: " << reference.size()
+              << " keys, lookups and scans agree with and without buffers"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: Bε-tree disagrees with std::set" << std::endl;
+  }
+  std::cout << "HINT: If failing, check the message merge in walk() and "
+               "the pivot cuts in flush()"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 34: Copy, Move and Clear
+  // ==========================================================================
+  {
+  printTestHeader(34, "Tree copies are deep, moves steal, clear() frees all");
+  std::cout << "Copying, moving and clearing AVL, Red-Black, B+, Bε and "
+               "policy trees of 1000 keys..."
+            << std::endl;
+
+  TREE::AVLTree<int> avl;
+  RBTREE::RedBlackTree<int> rb;
+  for (int v = 0; v < 1000; ++v) {
+    avl.insert((v * 7919) % 1000);
+    rb.insert((v * 7919) % 1000);
+  }
+
+  // node-for-node clones: same shape, no rebalancing on the way
+  TREE::AVLTree<int> avlCopy(avl);
+  RBTREE::RedBlackTree<int> rbCopy = rb;
+  bool sameShape = avlCopy.getHeight(avlCopy.getRoot()) ==
+                   avl.getHeight(avl.getRoot());
+  avlCopy.remove(500);
+  rbCopy.popMax();
+  bool ok = sameShape && avl.search(500) != nullptr &&
+            avlCopy.search(500) == nullptr &&
+            rb.peekMax() == 999 && rbCopy.peekMax() == 998 &&
+            avlCopy.getRoot() != avl.getRoot() &&
+            rbCopy.getRoot()->color == RBTNode<int>::BLACK;
+
+  // a move hands the nodes over and leaves the source empty but usable
+  TREE::AVLTree<int> avlMoved(std::move(avlCopy));
+  rb = std::move(rbCopy);
+  ok = ok && avlCopy.getRoot() == nullptr && !avlCopy.peekMin() &&
+       avlMoved.peekMin() == 0 && avlMoved.search(500) == nullptr &&
+       rbCopy.getRoot() == nullptr && rb.peekMax() == 998;
+  avlCopy.insert(7);
+  ok = ok && avlCopy.peekMin() == 7 && avlCopy.peekMax() == 7;
+
+  avl.clear();
+  rb.clear();
+  ok = ok && avl.getRoot() == nullptr && rb.getRoot() == nullptr &&
+       !avl.peekMax() && !rb.peekMin();
+
+  // the node-array trees: the B+ copy rebuilds the leaf chain, the Bε copy
+  // takes its pending messages along
+  TREE::BPlusTree<int> bplus;
+  TREE::BEpsilonTree<int, 1024> bepsilon;
+  TREE::StaticAVLTree<int> policy;
+  for (int v = 0; v < 1000; ++v) {
+    bplus.insert(v);
+    bepsilon.insert(v);
+    policy.insert(v);
+  }
+  TREE::BPlusTree<int> bplusCopy = bplus;
+  TREE::BEpsilonTree<int, 1024> bepsilonCopy = bepsilon;
+  TREE::StaticAVLTree<int> policyCopy = policy;
+  bplusCopy.remove(0);
+  bepsilonCopy.remove(0);
+  policyCopy.remove(0);
+  int chained = 0;
+  bplusCopy.scan(0, 1000, [&](int) { ++chained; });
+  ok = ok && bplus.search(0) && !bplusCopy.search(0) && chained == 999 &&
+       *bplusCopy.maximum() == 999 && bepsilon.search(0) &&
+       !bepsilonCopy.search(0) && bepsilonCopy.size() == 999 &&
+       policy.search(0) && !policyCopy.search(0) &&
+       policyCopy.height() == policy.height();
+
+  TREE::BPlusTree<int> bplusMoved = std::move(bplusCopy);
+  TREE::BEpsilonTree<int, 1024> bepsilonMoved = std::move(bepsilonCopy);
+  TREE::StaticAVLTree<int> policyMoved = std::move(policyCopy);
+  ok = ok && bplusCopy.size() == 0 && !bplusCopy.minimum() &&
+       bplusMoved.size() == 999 && bepsilonCopy.size() == 0 &&
+       bepsilonMoved.search(999) && policyCopy.size() == 0 &&
+       policyMoved.size() == 999;
+  bplusCopy.insert(7);
+  bepsilonCopy.insert(7);
+  policyCopy.insert(7);
+  bplus.clear();
+  bepsilon.clear();
+  policy.clear();
+  ok = ok && *bplusCopy.minimum() == 7 && bepsilonCopy.minimum() == 7 &&
+       policyCopy.minimum()->key == 7 && bplus.size() == 0 &&
+       !bplus.search(1) && bepsilon.size() == 0 && !bepsilon.maximum() &&
+       policy.size() == 0;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: copies are independent, moved-from trees are "
+                 "empty, cleared trees are reusable"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: copy, move or clear left a tree in the wrong "
+                 "state"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check cloneSubtree() and which cached "
+               "pointers the move operations hand over"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 35: Streaming Tree Dumps
+  // ==========================================================================
+  {
+  printTestHeader(35, "Tree dumps stream through one buffer, DOT and JSON");
+  std::cout << "Rendering a small Red-Black tree as text, DOT and JSON, and a "
+               "100000-node chain to a file descriptor..."
+            << std::endl;
+
+  RBTREE::RedBlackTree<int> rb;
+  for (int v = 1; v <= 3; ++v)
+    rb.insert(v);
+
+  std::ostringstream text, dot, json;
+  {
+    TREE::TreeWriter out(text, 16); // tiny buffer, forces many drains
+    TREE::renderTree(out, rb.getRoot());
+  }
+  {
+    TREE::TreeWriter out(dot);
+    TREE::writeDot(out, rb.getRoot());
+  }
+  {
+    TREE::TreeWriter out(json);
+    TREE::writeJson(out, rb.getRoot());
+  }
+  bool ok =
+      text.str() == "L-2\n    T-1\n    L-3\n" &&
+      json.str() ==
+          "{\"key\":2,\"color\":\"black\","
+          "\"left\":{\"key\":1,\"color\":\"red\",\"left\":null,\"right\":null},"
+          "\"right\":{\"key\":3,\"color\":\"red\",\"left\":null,\"right\":null}"
+          "}\n" &&
+      dot.str().find("n0 -> n1;\n  n2;\n  n0 -> n2;") != std::string::npos &&
+      dot.str().find("n1 [label=\"1\", style=filled, fontcolor=white, "
+                     "fillcolor=red]") != std::string::npos;
+
+  // a right-leaning chain is as deep as it is long; the recursive printer
+  // used to run out of stack on it
+  const int chain = 100000;
+  std::vector<BSTNode<int>> nodes;
+  nodes.reserve(chain);
+  for (int v = 0; v < chain; ++v) {
+    nodes.emplace_back(v);
+    if (v > 0)
+      nodes[v - 1].right = &nodes[v];
+  }
+  std::string path =
+      (std::filesystem::temp_directory_path() /
+       ("secret_tree_test." + std::to_string(::getpid()) + ".txt"))
+          .string();
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool written = false;
+  if (fd >= 0) {
+    TREE::TreeWriter out(fd);
+    TREE::renderTree(out, &nodes[0]);
+    written = out.flush();
+    ::close(fd);
+  }
+  // line v holds 4 * v columns of indentation, "L-", v and a newline
+  std::uintmax_t expected = 0;
+  for (int v = 0; v < chain; ++v)
+    expected += 4ull * v + 3 + std::to_string(v).size();
+  std::ifstream in(path);
+  std::string last, line;
+  while (std::getline(in, line))
+    last = line;
+  ok = ok && written && std::filesystem::file_size(path) == expected &&
+       last == std::string(4ull * (chain - 1), ' ') + "L-99999";
+  std::filesystem::remove(path);
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: text, DOT and JSON dumps are exact and a deep "
+                 "chain streams to a file"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: a dump came out wrong or the chain did not reach "
+                 "the file"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check the prefix bookkeeping in "
+               "renderTree() and TreeWriter::drain()"
+            << std::endl;
+  }
+
+  // ==========================================================================
+  // TEST 36: Adaptive Radix Tree
+  // ==========================================================================
+  {
+  printTestHeader(36, "Adaptive radix tree matches std::set order and lookups");
+  std::cout << "Inserting and removing string and 64-bit keys in an "
+               "AdaptiveRadixTree and a std::set..."
+            << std::endl;
+
+  // prefixes of other keys, an embedded NUL, bytes above 0x7f and paths
+  // longer than the bytes a node keeps of its prefix
+  TREE::AdaptiveRadixTree<std::string> art;
+  std::set<std::string> expected;
+  std::vector<std::string> words = {"", "a", "ab", "abc", "abd", "b",
+                                    std::string("a\0b", 3), "\xff", "\x7f"};
+  for (int v = 0; v < 3000; ++v)
+    words.push_back("https://example.com/some/long/shared/path/" +
+                    std::to_string(v * 7919 % 3000));
+  for (const std::string &word : words) {
+    art.insert(word);
+    expected.insert(word);
+  }
+  for (int v = 0; v < 3000; v += 3) {
+    std::string gone =
+        "https://example.com/some/long/shared/path/" + std::to_string(v);
+    art.remove(gone);
+    expected.erase(gone);
+  }
+  art.remove("ab");
+  expected.erase("ab");
+
+  std::vector<std::string> inOrder;
+  art.forEach([&](const std::string &key) { inOrder.push_back(key); });
+  const std::string *next = art.successor("a");
+  const std::string *above = art.lowerBound("ab");
+  int inRange = 0;
+  art.scan("https://example.com/some/long/shared/path/1",
+           "https://example.com/some/long/shared/path/2",
+           [&](const std::string &) { ++inRange; });
+  bool ok = art.size() == static_cast<int>(expected.size()) &&
+            std::equal(inOrder.begin(), inOrder.end(), expected.begin(),
+                       expected.end()) &&
+            art.search("") != nullptr && art.search("ab") == nullptr &&
+            art.search("abc") != nullptr && next &&
+            *next == std::string("a\0b", 3) && above && *above == "abc" &&
+            *art.maximum() == "\xff" &&
+            inRange == static_cast<int>(std::distance(
+                           expected.lower_bound(
+                               "https://example.com/some/long/shared/path/1"),
+                           expected.upper_bound(
+                               "https://example.com/some/long/shared/path/2")));
+
+  // copies are deep, moves hand the nodes over
+  TREE::AdaptiveRadixTree<std::string> copy(art);
+  copy.remove("abc");
+  TREE::AdaptiveRadixTree<std::string> moved(std::move(copy));
+  ok = ok && art.search("abc") != nullptr && moved.search("abc") == nullptr &&
+       moved.size() == art.size() - 1 && copy.size() == 0 &&
+       copy.minimum() == nullptr && *moved.maximum() == "\xff";
+
+  // signed integers: negatives first, node layouts grow and shrink back
+  TREE::AdaptiveRadixTree<long long> numbers;
+  for (long long v = -1000; v < 1000; ++v)
+    numbers.insert(v * 1000003);
+  for (long long v = -1000; v < 1000; ++v)
+    if (v % 10 != 0)
+      numbers.remove(v * 1000003);
+  std::vector<long long> kept;
+  numbers.forEach([&](long long key) { kept.push_back(key); });
+  ok = ok && numbers.size() == 200 && kept.size() == 200 &&
+       kept.front() == -1000 * 1000003LL && kept.back() == 990 * 1000003LL &&
+       std::is_sorted(kept.begin(), kept.end()) &&
+       numbers.search(-10 * 1000003LL) != nullptr &&
+       numbers.search(-11 * 1000003LL) == nullptr;
+
+  totalTests++;
+  if (ok) {
+    std::cout << "YES! PASS: iteration order, lookups and range scans agree "
+                 "with std::set"
+              << std::endl;
+    passedTests++;
+  } else {
+    std::cout << "NO! FAIL: the radix tree lost a key or returned keys out "
+                 "of order"
+              << std::endl;
+  }
+  std::cout << "HINT: If failing, check the prefix split in insert() and "
+               "the frames seek() leaves for advance()"
+            << std::endl;
+  }
+
   // ==========================================================================
   // FINAL RESULTS
   // ==========================================================================